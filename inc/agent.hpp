@@ -3,12 +3,13 @@
 
 #include "chainz.hpp"
 #include "token.hpp"
+#include <atomic>
 
 namespace alioth {
 template<typename T> class agent;
 
 class basic_thing {
-    protected:  int ref_count;
+    protected:  std::atomic<int> ref_count;
         virtual ~basic_thing() {}
     public: 
         basic_thing():ref_count(0){}
@@ -43,8 +44,7 @@ class agent {
         }
         void fre(basic_thing* tp)const {
             if( tp ) {
-                tp->ref_count -= 1;
-                if( tp->ref_count <= 0 ) delete tp;
+                if( --tp->ref_count <= 0 ) delete tp;
             }
         }
     public:
@@ -17,8 +17,17 @@ enum Status {
     SUCCESS,
     FAILED,
     TIMEOUT,
+    CANCELED,
 };
 
+/**
+ * @enum Framing : 分帧方式
+ * @desc :
+ *  TEXT : 每个包是一行Json文本
+ *  BINARY : 每个包是一个二进制帧，帧头是一个字节0xA1和四个字节的大端序载荷长度，载荷是以MessagePack编码的包
+ *  发送端的分帧方式由启动编译器的IDE通过--framing选项约定，接收端根据每个包的首字节自动识别 */
+enum Framing {TEXT, BINARY};
+
 /**
  * @enum Title : 动作的标题，是主要信息，不同动作的同一个标题可能有不同含义 */
 enum Title {
@@ -39,9 +48,13 @@ enum Title {
      * @desc :
      *  @request(ide): 请求语义检查和诊断信息
      *      @param targets --- [string]: 目标模块列表
+     *      @param stream --- bool: 可选，是否在每个阶段和每个模块结束时流式返回新产生的诊断信息
      *  @respond(compiler): 返回语义检查结果
-     *      @param status : 响应状态
+     *      @param status : 响应状态，请求被取消或被目标相同的新请求取代时为CANCELED
      *      @param diagnostics --- [json formated diagnostics] : 诊断信息
+     *      @param partial --- bool: 流式返回的中间响应为true，此时diagnostics只包含新产生的诊断信息
+     *      @param phase --- string: 中间响应所属的阶段
+     *  最终响应总是不带partial，并且包含本次请求的全部诊断信息
      */
     DIAGNOSTICS,
     
@@ -66,6 +79,32 @@ enum Title {
      */
     WORKSPACE,
 
+    /**
+     * @title UPDATE: 更新文本
+     * @desc :
+     *  @request(ide): 将编辑操作依次应用于编译器持有的文档缓冲，此后读取该文档不再请求文本内容
+     *      @param uri --- string: 文本URI
+     *      @param edits --- [{offset,length,text}|{line,column,length,text}|{text}]: 编辑操作
+     *          offset为字节偏移，line和column为从1开始计数的行号和字节列号，length为被替换的字节数
+     *          既没有offset也没有line的编辑操作整体替换文本内容
+     *      @param close --- boolean: [可选]为true时，应用编辑操作之后丢弃文档缓冲，此时edits可以省略
+     *          IDE关闭或保存文档后应当释放缓冲，此后读取该文档重新请求文本内容
+     *  @respond(compiler): 返回更新结果
+     *      @param status : 响应状态
+     *          若编译器尚未持有文档缓冲而第一个编辑操作并非整体替换，或编辑范围越界，则返回FAILED
+     *          失败时编译器丢弃该文档的缓冲，IDE应当以整体替换重新同步
+     */
+    UPDATE,
+
+    /**
+     * @title CANCEL: 取消
+     * @desc :
+     *  @request(ide): 请求取消一个尚未完成的请求，此请求本身没有响应
+     *      @param target --- integer: 被取消的请求的序列号
+     *  被取消的请求在下一个阶段或模块的边界处停止，并以CANCELED状态响应
+     */
+    CANCEL,
+
     /**
      * @title EXIT: 退出
      * @desc :
@@ -98,6 +137,8 @@ struct Parameter : public basic_thing {
     struct Request {
         something(Diagnostics);
         something(Workspace);
+        something(Update);
+        something(Cancel);
     };
     struct Respond {
         something(Content);
@@ -107,10 +148,27 @@ struct Parameter : public basic_thing {
 
 struct Parameter::Request::Diagnostics : public Parameter {
     chainz<string> targets;
+    bool stream = false;
+};
+struct Parameter::Request::Cancel : public Parameter {
+    long target;
 };
 struct Parameter::Request::Workspace : public Parameter {
     string uri;
 };
+struct Parameter::Request::Update : public Parameter {
+    struct edit {
+        long offset = -1;
+        long line = 0;
+        long column = 0;
+        long length = 0;
+        string text;
+    };
+
+    string uri;
+    chainz<edit> edits;
+    bool close = false;
+};
 struct Parameter::Respond::Content : public Parameter {
     string data;
 };
@@ -141,6 +199,8 @@ struct Extension::Request : public Extension {
 
     CONVERTER(Parameter::Request::$Diagnostics, diagnostics, params)
     CONVERTER(Parameter::Request::$Workspace, workspace, params)
+    CONVERTER(Parameter::Request::$Update, update, params)
+    CONVERTER(Parameter::Request::$Cancel, cancel, params)
 };
 
 struct Extension::Respond : public Extension {
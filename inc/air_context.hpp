@@ -4,10 +4,12 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/raw_ostream.h>
 #include "diagnostic.hpp"
 #include "syntax.hpp"
 #include "value.hpp"
 #include "agent.hpp"
+#include <set>
 
 namespace alioth {
 
@@ -41,6 +43,36 @@ namespace metattr {
     constexpr metattrs retcm = retrf|retri|retst;
 };
 
+/**
+ * @enum layout_t : 类属性的布局策略
+ * @desc :
+ *  每个类只重排自己声明的属性，基类的属性总是以相同的顺序构成派生类布局的前缀 */
+enum class layout_t {
+
+    /** 按照声明顺序排列 */
+    declared,
+
+    /** 按照对齐要求从大到小排列，对齐要求相同的属性保持声明顺序，以减少填充 */
+    sorted,
+
+    /** 按照声明顺序紧密排列，不插入填充，属性可能不再对齐 */
+    packed,
+};
+
+/**
+ * @enum emit_t : 产出格式 */
+enum class emit_t {
+
+    /** 目标文件 */
+    object,
+
+    /** LLVM位码 */
+    bitcode,
+
+    /** 文本形式的LLVM中间代码 */
+    ir,
+};
+
 /**
  * @class AirContext : AIR上下文
  * @desc :
@@ -87,10 +119,39 @@ class AirContext : public llvm::LLVMContext {
          * @member element_values : 具名元素表 */
         std::map<$element,llvm::Value*> element_values;
 
+        /**
+         * @member element_addrs : 具名元素的寻址方式
+         * @desc :
+         *  none表示具名元素表中存储的是元素的SSA值，direct表示存储的是元素在入口块中分配的地址
+         *  取值规则与运算值的地址类型相同 */
+        std::map<$element,addr_t> element_addrs;
+
+        /**
+         * @member mutated_names : 可变名称
+         * @desc : 当前方法体中可能被修改或被取地址的名称，这些名称绑定的元素必须分配栈空间 */
+        std::set<std::string> mutated_names;
+
+        /**
+         * @member inferred_protos : 推断的元素原型
+         * @desc : 未被修改的unknown元素只可能持有初始值，其原型被推断为初始值的原型，元素不必装箱 */
+        std::map<$element,$eprototype> inferred_protos;
+
         /**
          * @member method_attrs : 方法属性 */
         std::map<$metdef,metattrs> method_attrs;
 
+        /**
+         * @member layout : 类属性的布局策略 */
+        layout_t layout = layout_t::declared;
+
+        /**
+         * @member lowered_types : 类类型的降级结果
+         * @desc :
+         *  以归约后的类型标识和类型所指的类定义为键缓存类实例类型和类实体类型
+         *  在不同位置书写的同一个类型归约到同一个键，类的二进制符号只计算一次
+         *  其余类型的降级不必缓存，基础类型、指针类型和函数类型由LLVMContext唯一化 */
+        std::map<std::pair<typeid_t,const void*>,llvm::StructType*> lowered_types;
+
         /**
          * @member scoped_elements : 作用域包裹的元素 */
         std::map<$scope,map<string, $element>> scoped_elements;
@@ -117,8 +178,9 @@ class AirContext : public llvm::LLVMContext {
          * @operator () : 处理模块
          * @desc :
          *  将语义模块翻译为目标文件，输出至目标输出流
+         *  输出流可以是文件描述符输出流，也可以是内存中的缓冲区
          */
-        bool operator()( $module mod, ostream& os, bool ir = false );
+        bool operator()( $module mod, llvm::raw_pwrite_stream& os, emit_t emit = emit_t::object );
 
         /**
          * @operator () : 处理模块
@@ -131,7 +193,25 @@ class AirContext : public llvm::LLVMContext {
          * @operator () : 处理alioth模块
          * @desc :
          *  尝试将alioth模块翻译至机器码,输出至目标输出流 */
-        bool operator()( ostream& os, bool ir = false );
+        bool operator()( llvm::raw_pwrite_stream& os, emit_t emit = emit_t::object );
+
+        /**
+         * @operator () : 链接时优化
+         * @desc :
+         *  将所有语义模块翻译后链接为一个模块，执行优化管线，输出至目标输出流
+         *  目标模块构成完整的程序时，alioth模块也被链接进来，除入口函数外的所有符号都被内部化
+         *  否则alioth模块不被链接，其中的类型标识仍需单独产生，目标模块定义的符号仍然对外可见
+         * @param mods : 已经分析过语义的模块
+         * @param os : 目标输出流
+         * @param emit : 产出格式
+         * @param program : 目标模块是否构成完整的程序
+         */
+        bool operator()( const modules& mods, llvm::raw_pwrite_stream& os, emit_t emit, bool program );
+
+        /**
+         * @method setLayout : 设置类属性的布局策略
+         * @desc : 必须在翻译任何模块之前设置 */
+        void setLayout( layout_t strategy );
 
     private:
 
@@ -176,11 +256,47 @@ class AirContext : public llvm::LLVMContext {
         $value translateDeleteExpression( llvm::IRBuilder<>& builder, $delexpr expr );
         $value translateDoExpression( llvm::IRBuilder<>& builder, $doexpr expr );
 
+        /**
+         * @method createEntryAlloca : 在入口块中分配栈空间
+         * @desc :
+         *  所有栈空间都分配在函数入口块的起始处，使它们可以被mem2reg提升为寄存器
+         * @param builder : 当前的指令构建器，用于定位当前函数
+         * @param type : 元素类型
+         * @param name : 元素名称
+         */
+        llvm::AllocaInst* createEntryAlloca( llvm::IRBuilder<>& builder, llvm::Type* type, const std::string& name );
+
+        /**
+         * @method loadValue : 读取标量值
+         * @desc : 直接寻址的运算值被读取为SSA值，立即数原样返回 */
+        llvm::Value* loadValue( llvm::IRBuilder<>& builder, $value val );
+
+        /**
+         * @method castValue : 转换标量值
+         * @desc : 在整数之间、浮点数之间转换标量值，类型相同时原样返回，无法转换时返回空 */
+        llvm::Value* castValue( llvm::IRBuilder<>& builder, $value val, $eprototype proto );
+
+        /**
+         * @method boxValue : 装箱
+         * @desc :
+         *  将运算值存入unknown结构，类型标识为基础类型的全局字符串
+         *  不超过指针宽度的基础类型直接存储在载荷中，不在堆上分配空间
+         * @param val : 运算值
+         * @param dst : unknown结构的地址
+         * @return bool : 是否成功
+         */
+        bool boxValue( llvm::IRBuilder<>& builder, $value val, llvm::Value* dst );
+
         /** 产生一个start函数作为入口,它将整理命令行参数，调用入口方法 */
         bool generateStartFunction( $metdef met );
 
         /** 产生输出入 */
-        bool generateOutput( std::shared_ptr<llvm::Module> mod, ostream& os, bool ir );
+        bool generateOutput( std::shared_ptr<llvm::Module> mod, llvm::raw_pwrite_stream& os, emit_t emit );
+
+        /**
+         * @method optimizeModule : 优化模块
+         * @desc : 内部化preserve以外的符号，移除不再被引用的全局对象，再执行O2级别的优化管线 */
+        void optimizeModule( llvm::Module& mod, const std::set<std::string>& preserve );
 
         /**
          * @method $t : 获取类实例的类型 */
@@ -207,7 +323,8 @@ class AirContext : public llvm::LLVMContext {
         llvm::Type* $t( $eprototype );
 
         /**
-         * @member $t : 解算数据类型 */
+         * @member $t : 解算数据类型
+         * @desc : 先归约数据类型表达式，类类型查询降级结果缓存 */
         llvm::Type* $t( $typeexpr );
 
         /**
@@ -235,10 +352,14 @@ class AirContext : public llvm::LLVMContext {
         $implementation $impl( $statement stmt );
 
         /**
-         * @method createGlobalStr : 创建全局字符串
-         * @desc : 在alioth模块创建全局变量
-         */
-        llvm::GlobalVariable* createGlobalStr( const string& str );
+         * @method createTypeId : 创建类型标识
+         * @desc : 在alioth模块中创建外部可见的具名字符串，其地址作为基础类型的类型标识，重复创建时返回已有的字符串 */
+        llvm::GlobalVariable* createTypeId( const string& name );
+
+        /**
+         * @method $id : 获取类型标识
+         * @desc : 在当前模块中引用alioth模块定义的类型标识 */
+        llvm::Constant* $id( const string& name );
 };
 
 }
@@ -74,6 +74,11 @@ class Socket : public basic_thing {
              * @desc : 每个需要得到响应的请求都挂起一个事务逻辑 */
             map<int,$Transaction> transactions;
 
+            /**
+             * @member frame : 帧缓冲
+             * @desc : 哨兵线程读取二进制帧载荷的缓冲，在帧之间复用，只在遇到更大的帧时扩容 */
+            string frame;
+
             /**
              * @member guard : 哨兵线程
              * @desc : 哨兵线程持续等待输入内容，并将输入内容整理到缓冲 */
@@ -94,6 +99,11 @@ class Socket : public basic_thing {
              * @member os : 输出流 */
             uostream os;
 
+            /**
+             * @member fd : 文件描述符
+             * @desc : 输出流建立在文件描述符之上时，二进制帧的帧头和载荷以一次writev写出 */
+            int fd = -1;
+
             OutputStream( uostream&& o):os(std::move(o)){}
         };using $OutputStream = agent<OutputStream>;
 
@@ -120,6 +130,20 @@ class Socket : public basic_thing {
          * @desc : 用于产生请求序列号的全局序列号 */
         static long global_seq;
 
+        /**
+         * @static-member framing : 分帧方式
+         * @desc : 所有输出流发送包时使用的分帧方式 */
+        static protocol::Framing framing;
+
+        /**
+         * @static-member frame_magic : 二进制帧的首字节 */
+        static const char frame_magic;
+
+        /**
+         * @static-member frame_limit : 二进制帧的载荷上限
+         * @desc : 超过上限的帧被跳过而不分配缓冲，流保持在下一个包的边界上 */
+        static const size_t frame_limit;
+
     private:
 
         /**
@@ -136,6 +160,8 @@ class Socket : public basic_thing {
         Socket( const Socket& ) = delete;
         Socket( Socket&& );
 
+        static void SetFraming( protocol::Framing f );
+
         bool ActivateInputStream( const Uri& uri );
         bool ActivateOutputStream( const Uri& uri );
 
@@ -143,8 +169,10 @@ class Socket : public basic_thing {
         long requestContents( const Uri& uri );
 
         void respondDiagnostics( long seq, const json& diagnostics );
+        void respondPartialDiagnostics( long seq, const json& diagnostics, const string& phase );
         void respondSuccess( long seq, protocol::Title title );
         void respondFailure( long seq, protocol::Title title );
+        void respondCancellation( long seq, protocol::Title title );
 
         void reportException( const string& msg );
 
@@ -156,6 +184,7 @@ class Socket : public basic_thing {
         static $OutputStream GetOutputStream( const Uri& uri );
 
         static void GuardInputStream( $InputStream s );
+        static json ReceiveFrame( $InputStream s );
 
         static protocol::$Package ExtractPackage( const json& data );
         static protocol::$Package ExtractRequestPackage( const json& data, protocol::$Package package );
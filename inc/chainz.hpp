@@ -14,6 +14,7 @@
  * chainz使用指针池结构存储数据
  * 用以弥补链式寻址开销大的缺陷
  * 代价则是内存碎片化极为严重
+ * 指针池按倍数扩容,插入和删除只移动指针,逐个追加元素的总开销是线性的
  * 
  * 到目前为止,chainz被添加了很多功能
  * 
@@ -152,13 +153,26 @@ class chainz {
         
         R*      m_pool;     //元素指针列表
         int     m_count;    //元素总量统计
+        int     m_capacity; //指针池容量
+
+        /**
+         * @state: 为即将插入的一个元素预留指针池空间,空间不足时按倍数扩容
+         */
+        void reserve() {
+            if( m_count < m_capacity ) return;
+            m_capacity = m_capacity ? m_capacity * 2 : 4;
+            R* nr = new R[m_capacity];
+            if( m_count ) memcpy( nr, m_pool, m_count*sizeof(R) );
+            delete[] m_pool;
+            m_pool = nr;
+        }
     
     public:
         /**
          * @state: 构造函数
          */
         chainz():
-        m_pool(nullptr),m_count(0) {
+        m_pool(nullptr),m_count(0),m_capacity(0) {
 
         }
 
@@ -171,7 +185,7 @@ class chainz {
          * @state: 拷贝构造函数,从另一个实例按照原顺序拷贝每一个元素
          */
         chainz( const chainz& another ):
-        m_pool(nullptr),m_count(0) {
+        m_pool(nullptr),m_count(0),m_capacity(0) {
             for( int i = 0; i < another.m_count; i++ )
                 push( another[i] );
         }
@@ -181,9 +195,10 @@ class chainz {
          * @state: 移动构造函数,从右值实例中抓取系统资源
          */
         chainz( chainz&& temp ):
-        m_pool(temp.m_pool),m_count(temp.m_count) {
+        m_pool(temp.m_pool),m_count(temp.m_count),m_capacity(temp.m_capacity) {
             temp.m_pool = nullptr;
             temp.m_count = 0;
+            temp.m_capacity = 0;
         }
 
         /**
@@ -225,7 +240,9 @@ class chainz {
             clear();
             m_pool = tempz.m_pool;
             m_count = tempz.m_count;
+            m_capacity = tempz.m_capacity;
             tempz.m_count = 0;
+            tempz.m_capacity = 0;
             tempz.m_pool = nullptr;
             return *this;
         }
@@ -254,69 +271,28 @@ class chainz {
         }
         bool insert( IN T&& data, IN int index ) {
 
-            //若表为空,则情况单独处理
-            if( m_count == 0 ) {
-                if( index == 0 or index == -1 ) {
-                    m_pool = new R[1];
-                    m_pool[0] = new T(std::move(data));
-                } else {
-                    return false;
-                }
-            
-            //若表不为空
-            } else {
-                //若索引小于0,则先修正索引到正向
-                if( index < 0 )
-                    index = m_count + 1 + index;
-                //若正向索引超出范围,则返回失败
-                if( index > m_count or index < 0 )
-                    return false;
-                
-                //创建新表,将原表中的元素指针映射到新表中,同时插入新的元素的指针
-                R* nr = new R[m_count+1];
-                memcpy( nr, m_pool, index*sizeof(R) );
-                nr[index] = new T(std::move(data));
-                memcpy( nr+index+1, m_pool+index, (m_count-index)*sizeof(R));
-
-                //删除原表,替换表指针
-                delete[] m_pool;
-                m_pool = nr;
-            }
+            //若索引小于0,则先修正索引到正向
+            if( index < 0 )
+                index = m_count + 1 + index;
+            //若正向索引超出范围,则返回失败
+            if( index > m_count or index < 0 )
+                return false;
 
-            //收尾工作
-            m_count += 1;
-            return true;
+            return insert( new T(std::move(data)), index );
         }
         bool insert( IN T* pdata, IN int index ) {
 
-            //若表为空,则情况单独处理
-            if( m_count == 0 ) {
-                if( index == 0 or index == -1 ) {
-                    m_pool = new R[1];
-                    m_pool[0] = pdata;
-                } else {
-                    return false;
-                }
-            
-            //若表不为空
-            } else {
-                //若索引小于0,则先修正索引到正向
-                if( index < 0 )
-                    index = m_count + 1 + index;
-                //若正向索引超出范围,则抛出异常
-                if( index > m_count or index < 0 )
-                    return false;
-                
-                //创建新表,将原表中的元素指针映射到新表中,同时插入新的元素的指针
-                R* nr = new R[m_count+1];
-                memcpy( nr, m_pool, index*sizeof(R) );
-                nr[index] = pdata;
-                memcpy( nr+index+1, m_pool+index, (m_count-index)*sizeof(R));
+            //若索引小于0,则先修正索引到正向
+            if( index < 0 )
+                index = m_count + 1 + index;
+            //若正向索引超出范围,则返回失败
+            if( index > m_count or index < 0 )
+                return false;
 
-                //删除原表,替换表指针
-                delete[] m_pool;
-                m_pool = nr;
-            }
+            //预留空间,将插入点之后的元素指针后移,同时插入新的元素的指针
+            reserve();
+            memmove( m_pool+index+1, m_pool+index, (m_count-index)*sizeof(R) );
+            m_pool[index] = pdata;
 
             //收尾工作
             m_count += 1;
@@ -342,14 +318,11 @@ class chainz {
                 delete[] m_pool;
                 m_pool = nullptr;
                 m_count = 0;
+                m_capacity = 0;
             
-            //否则,应当重新映射指针表到新的表格中
+            //否则,将之后的元素指针前移
             } else {
-                R* nr = new R[m_count-1];
-                memcpy( nr, m_pool, index*sizeof(R) );
-                memcpy( nr+index, m_pool+index+1, (m_count-index-1)*sizeof(R) );
-                delete[] m_pool;
-                m_pool = nr;
+                memmove( m_pool+index, m_pool+index+1, (m_count-index-1)*sizeof(R) );
                 m_count -= 1;
             }
             return t;
@@ -391,14 +364,11 @@ class chainz {
                 delete[] m_pool;
                 m_pool = nullptr;
                 m_count = 0;
+                m_capacity = 0;
             
-            //否则,应当重新映射指针表到新的表格中
+            //否则,将之后的元素指针前移
             } else {
-                R* nr = new R[m_count-1];
-                memcpy( nr, m_pool, index*sizeof(R) );
-                memcpy( nr+index, m_pool+index+1, (m_count-index-1)*sizeof(R) );
-                delete[] m_pool;
-                m_pool = nr;
+                memmove( m_pool+index, m_pool+index+1, (m_count-index-1)*sizeof(R) );
                 m_count -= 1;
             }
 
@@ -427,13 +397,12 @@ class chainz {
          * @state: 清空容器,删除所有内容
          */
         void clear() {
-            if( m_count != 0 ) {
-                for( int i = 0; i < m_count; i++ )
-                    if( m_pool[i] ) delete m_pool[i];
-                delete[] m_pool;
-                m_pool = nullptr;
-                m_count = 0;
-            }
+            for( int i = 0; i < m_count; i++ )
+                if( m_pool[i] ) delete m_pool[i];
+            delete[] m_pool;
+            m_pool = nullptr;
+            m_count = 0;
+            m_capacity = 0;
             return;
         }
 
@@ -603,7 +572,7 @@ class chainz {
             int in = 0;
             res.m_count = an.m_count + m_count;
             if( res.m_count == 0 ) return std::move(res);
-            res.m_pool = new R[res.m_count];
+            res.m_pool = new R[res.m_capacity = res.m_count];
             for( const auto& i : *this ) res.m_pool[in++] = new T(i);
             for( const auto& i : an ) res.m_pool[in++] = new T(i);
             return std::move(res);
@@ -613,12 +582,13 @@ class chainz {
             int in = 0;
             res.m_count = an.m_count + m_count;
             if( res.m_count == 0 ) return std::move(res);
-            res.m_pool = new R[res.m_count];
+            res.m_pool = new R[res.m_capacity = res.m_count];
             for( const auto& i : *this ) res.m_pool[in++] = new T(i);
             memcpy(res.m_pool+in,an.m_pool,an.m_count*sizeof(R));
-            delete an.m_pool;
+            delete[] an.m_pool;
             an.m_pool = nullptr;
             an.m_count = 0;
+            an.m_capacity = 0;
             return std::move(res);
         }
         chainz& operator+=( const chainz& an ) {
@@ -628,9 +598,10 @@ class chainz {
             R* np = new R[nc];
             memcpy(np,m_pool,m_count*sizeof(R));
             for( const auto& i : an ) np[in++] = new T(i);
-            delete m_pool;
+            delete[] m_pool;
             m_pool = np;
             m_count = nc;
+            m_capacity = nc;
             return *this;
         }
         chainz& operator+=( chainz&& an ) {
@@ -639,12 +610,14 @@ class chainz {
             R* np = new R[nc];
             memcpy(np,m_pool,m_count*sizeof(R));
             memcpy(np+m_count,an.m_pool,an.m_count*sizeof(R));
-            delete an.m_pool;
+            delete[] an.m_pool;
             an.m_pool = nullptr;
             an.m_count = 0;
-            delete m_pool;
+            an.m_capacity = 0;
+            delete[] m_pool;
             m_pool = np;
             m_count = nc;
+            m_capacity = nc;
             return *this;
         }
 };
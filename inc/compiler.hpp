@@ -8,6 +8,13 @@
 #include "syntax.hpp"
 #include "semantic.hpp"
 #include "context.hpp"
+#include "depgraph.hpp"
+#include "objcache.hpp"
+#include "air_context.hpp"
+#include "profiler.hpp"
+#include <set>
+#include <mutex>
+#include <condition_variable>
 
 namespace alioth {
 
@@ -27,7 +34,8 @@ class AbstractCompiler {
          */
         enum DiagnosticMethod {
             STRING, // 将诊断信息组织成为字符串
-            JSON    // 将诊断信息组织成为JSON结构体
+            JSON,   // 将诊断信息组织成为JSON结构体
+            JSONL   // 将每条诊断信息组织成为一行JSON结构体
         };
 
         /**
@@ -76,6 +84,20 @@ class AbstractCompiler {
          * @desc : 记录编译器在运行期间产生的诊断信息 */
         Diagnostics diagnostics;
 
+        /**
+         * @member diagnosticStream : 诊断输出流
+         * @desc : 第一次输出诊断信息时打开的诊断流向 */
+        uostream diagnosticStream;
+
+        /**
+         * @member diagnosticBuffer : 诊断输出缓冲
+         * @desc : 逐条格式化诊断信息时反复使用的缓冲 */
+        string diagnosticBuffer;
+
+        /**
+         * @member written : 已经输出的诊断信息数量 */
+        int written = 0;
+
     private:
         /**
          * @ctor : 构造函数
@@ -123,6 +145,15 @@ class AbstractCompiler {
          * @param m : 命令行参数中的诊断信息流向
          */
         bool configureDiagnosticDestination( const string& d );
+
+        /**
+         * @method flushDiagnostics : 输出诊断信息
+         * @desc :
+         *  将此前尚未输出的诊断信息逐条格式化并写入诊断流向，每条诊断信息写入一次
+         *  编译器在阶段和模块的边界处调用此方法，诊断信息不必等到编译结束才能看到
+         *  以JSON方法输出时，数组在第一条诊断信息之前开始，在析构时结束
+         */
+        void flushDiagnostics();
 };
 
 /**
@@ -149,6 +180,15 @@ class BasicCompiler : public AbstractCompiler {
         int help();
         int init( const string& package );
 
+        /**
+         * @method catalog : 编译诊断目录
+         * @desc :
+         *  将根空间中的diagnostic.json编译为同一目录下的diagnostic.cat
+         *  编译器启动时若诊断目录与diagnostic.json一致，则直接映射目录而不必解析Json
+         * @return int : 结束码
+         */
+        int catalog();
+
 };
 
 /**
@@ -167,9 +207,19 @@ class AliothCompiler : public AbstractCompiler {
 
         /**
          * @member target_modules : 目标模块
-         * @desc : 存储所有目标所涉及的模块的签名 */
+         * @desc : 存储所有目标所涉及的完备模块的签名，按照依赖关系的拓扑序排列 */
         signatures target_modules;
 
+        /**
+         * @member dependencies : 依赖关系图
+         * @desc : 每次检测涉及模块时重新构建，作为后续各阶段的调度依据 */
+        DependencyGraph dependencies;
+
+        /**
+         * @member defective_modules : 缺陷模块
+         * @desc : 存在不可达依赖或重复依赖的模块 */
+        set<$signature> defective_modules;
+
         /**
          * @member context : 编译器上下文
          * @desc : 用于集中管理编译资源的上下文环境 */
@@ -180,16 +230,123 @@ class AliothCompiler : public AbstractCompiler {
          * @desc : 用于集中管理语义信息 */
         SemanticContext semantic;
 
+        /**
+         * @member cache_dir : 共享缓存目录
+         * @desc : 由选项`--cache-dir`指定，为空时不使用共享缓存 */
+        string cache_dir;
+
+        /**
+         * @member cache_capacity : 共享缓存容量
+         * @desc : 由选项`--cache-size`以MiB为单位指定，默认为1GiB */
+        uint64_t cache_capacity = 1ull << 30;
+
+        /**
+         * @member layout : 类属性的布局策略
+         * @desc : 由选项`--layout`指定，参与目标文件指纹的计算 */
+        layout_t layout = layout_t::declared;
+
+        /**
+         * @member time_report : 是否报告用时
+         * @desc : 由选项`--time-report`开启，编译结束时报告各阶段和各模块的用时与计数 */
+        bool time_report = false;
+
+        /**
+         * @member time_report_json : 是否以Json报告用时
+         * @desc : 由选项`--time-report-method`指定，默认以表格报告 */
+        bool time_report_json = false;
+
+        /**
+         * @member time_report_to : 用时报告流向
+         * @desc : 由选项`--time-report-to`指定，默认写入标准错误，不与诊断信息混杂 */
+        DiagnosticDestination time_report_to = {fd :2};
+
+        /**
+         * @member trace : 是否输出跟踪
+         * @desc : 由选项`--trace`开启，编译结束时将各阶段、各模块和各文档的跟踪事件以Chrome跟踪格式写入trace_to */
+        bool trace = false;
+
+        /**
+         * @member trace_to : 跟踪流向 */
+        DiagnosticDestination trace_to = {fd :2};
+
+        /**
+         * @member profiler : 性能剖析器
+         * @desc : 开启了用时报告或跟踪时才记录度量结果 */
+        Profiler profiler;
+
+        /**
+         * @member lto : 是否执行链接时优化
+         * @desc : 由选项`--lto`开启，所有目标模块链接为一个模块，优化后产生唯一的目标文件 */
+        bool lto = false;
+
+        /**
+         * @member emit : 产出格式
+         * @desc : 由选项`--emit`指定目标文件或LLVM位码，参与目标文件指纹的计算 */
+        emit_t emit = emit_t::object;
+
         /**
          * @member full_interactive : 是否开启全交互模式
          * @desc : 全交互模式会使得Alioth编译器进入挂机状态，根据指令行动 */
         bool full_interactive = false;
 
+        /**
+         * @member drafts : 草稿表
+         * @desc : 全交互模式下每个文档的语法缓存，以文档的URI为键，仅由分析线程访问 */
+        map<string,SyntaxCache> drafts;
+
         /**
          * @member msock : 交互套接字
          * @desc : 用于交互模式的交互套接字 */
         Socket msock;
 
+        /**
+         * @member serving : 正在处理的请求
+         * @desc : 全交互模式下正在处理的诊断请求，非交互模式下为空，由分析线程在持有jobs_lock时设置和清除 */
+        protocol::$Package serving;
+
+        /**
+         * @member serving_revision : 正在处理的请求开始时的修订号 */
+        long serving_revision = 0;
+
+        /**
+         * @member streamed : 已经流式返回的诊断信息数量 */
+        int streamed = 0;
+
+        /**
+         * @member canceled : 正在处理的请求是否已被取消
+         * @desc : 只由分析线程在持有jobs_lock时写入 */
+        bool canceled = false;
+
+        /**
+         * @member jobs : 待执行的请求
+         * @desc :
+         *  全交互模式下由分派线程接收，交由分析线程依次执行的请求
+         *  诊断请求和工作空间请求都会改写上下文和语法树，只能在唯一的分析线程中执行 */
+        protocol::Packages jobs;
+
+        /**
+         * @member followers : 跟随的请求
+         * @desc :
+         *  以队列中或正在执行的诊断请求的序列号为键，记录目标相同而共享其分析结果的后来请求
+         *  多个编辑器窗口请求相同的目标时只执行一次分析，后来的请求不必排在前一个请求之后 */
+        map<long,protocol::Packages> followers;
+
+        /**
+         * @member cancellations : 被取消的请求
+         * @desc : CANCEL请求所指定的目标序列号，只记录队列中、正在执行或跟随中的请求，目标请求结束时被移除 */
+        set<long> cancellations;
+
+        /**
+         * @member revision : 修订号
+         * @desc : 分派线程每接收一个UPDATE或WORKSPACE请求就增加修订号，用于判断正在执行的分析是否仍然反映当前状态 */
+        long revision = 0;
+
+        /**
+         * @member jobs_lock, jobs_cv : 请求队列的互斥锁和条件变量
+         * @desc : 保护jobs、followers、cancellations、revision和正在处理的请求，分派线程放入请求时唤醒分析线程 */
+        mutex jobs_lock;
+        condition_variable jobs_cv;
+
     public:
         /**
          * @ctor : 构造函数
@@ -208,10 +365,21 @@ class AliothCompiler : public AbstractCompiler {
          * @method execute_full_interactive : 执行全交互模式
          * @desc :
          *  进入全交互模式，等待请求，完成指定任务
+         *  当前线程作为分派线程接收请求：UPDATE和CANCEL请求立即处理，不必排在正在执行的诊断之后
+         *  诊断请求和工作空间请求交由分析线程依次执行，目标相同的诊断请求共享一次分析
          * @return int :　结束码
          */
         int execute_full_interactive();
 
+        /**
+         * @method serve : 执行分析请求
+         * @desc :
+         *  分析线程的主循环，依次执行分派线程放入jobs的请求，接收到EXIT请求时返回
+         *  请求之间不会并发执行，诊断结果发送给请求及其所有跟随者
+         *  请求结束或者抛出异常后移除其取消记录和跟随者
+         */
+        void serve();
+
         /**
          * @method enableFullInteractiveMode: 启动全交互模式
          * @desc :
@@ -222,6 +390,60 @@ class AliothCompiler : public AbstractCompiler {
          */
         bool enableFullInteractiveMode( int input, int output );
 
+        /**
+         * @method checkpoint : 检查点
+         * @desc :
+         *  在阶段和模块的边界处调用，非交互模式下输出此前尚未输出的诊断信息
+         *  若正在处理的请求要求流式返回，则返回此前尚未返回的诊断信息
+         *  若请求被CANCEL请求取消，或者已经接收到目标相同的新诊断请求，则请求被取消
+         * @param phase : 刚刚结束的阶段
+         * @return bool : 请求是否已被取消，调用者应当停止后续工作
+         */
+        bool checkpoint( const string& phase );
+
+        /**
+         * @method superseded : 检查请求是否失效
+         * @desc :
+         *  请求及其所有跟随者都已被CANCEL请求取消，或者队列中已有目标相同的新诊断请求
+         *  请求失效时设置canceled
+         * @param package : 诊断请求
+         * @return bool : 请求是否失效
+         */
+        bool superseded( protocol::$Package package );
+
+        /**
+         * @method subscribers : 获取订阅者
+         * @desc : 获取诊断请求及其跟随者，调用者应当持有jobs_lock
+         * @param package : 诊断请求
+         * @return protocol::Packages : 共享此次分析结果的所有请求
+         */
+        protocol::Packages subscribers( protocol::$Package package );
+
+        /**
+         * @method companion : 寻找可以共享的请求
+         * @desc :
+         *  为新的诊断请求寻找目标相同的请求，调用者应当持有jobs_lock
+         *  队列末尾连续的诊断请求尚未开始，总是可以共享
+         *  正在执行的请求只在其开始之后没有接收到编辑且尚未被取消时可以共享
+         * @param package : 新的诊断请求
+         * @return protocol::$Package : 可以共享的请求，没有时为空
+         */
+        protocol::$Package companion( protocol::$Package package );
+
+        /**
+         * @method pending : 检查请求是否尚未结束
+         * @desc : 请求在队列中、正在执行或跟随其他请求，调用者应当持有jobs_lock
+         * @param seq : 请求的序列号
+         * @return bool : 请求是否尚未结束
+         */
+        bool pending( long seq );
+
+        /**
+         * @method SameTargets : 比较两个诊断请求的目标列表
+         * @return bool : 目标列表是否相同
+         */
+        static bool SameTargets( protocol::$Package a, protocol::$Package b );
+
         /**
          * @method detectInvolvedModules : 检测涉及模块
          * @desc :
@@ -250,13 +472,52 @@ class AliothCompiler : public AbstractCompiler {
          * @method generateTargetFile : 产生目标文件
          * @desc :
          *  为已经分析过语义的模块产生目标文件
+         *  每个目标文件旁保存一份指纹文件，指纹未变化且目标文件存在时，跳过模块的翻译和产生
+         *  指定了共享缓存目录时，先尝试从共享缓存中取出目标文件，并在结束时报告缓存的使用情况
+         *  开启了链接时优化时，只产生一个以目标名称命名的目标文件，其指纹由所有目标模块的指纹累积而成
+         *  产生可执行文件时，这个目标文件已经包含了alioth模块，否则alioth模块的目标文件仍然单独产生
          */
         bool generateTargetFile();
 
+        /**
+         * @method calculateObjectFingerprint : 计算目标文件指纹
+         * @desc :
+         *  目标文件的内容由编译器版本、目标平台、布局策略、产出格式、模块源码的记号序列、模块接口和所有直接或间接依赖的接口决定
+         *  其他模块请求的模板类用例也产生在此模块的目标文件中，用例的符号和模板实参所属的模块的接口同样参与计算
+         *  指纹与目标文件一同保存，指纹未变化时不必重新翻译模块
+         *  可移植的指纹不包含工作空间的绝对位置，用作共享缓存的键，使不同位置的检出可以共享目标文件
+         * @param mod : 已经分析过语义的模块
+         * @param arch : 目标架构
+         * @param platform : 目标平台
+         * @param portable : 是否计算可移植的指纹
+         * @return string : 十六进制表示的指纹
+         */
+        string calculateObjectFingerprint( $module mod, const string& arch, const string& platform, bool portable = false );
+
+        /**
+         * @method reportTime : 报告用时
+         * @desc :
+         *  开启了用时报告时，在编译结束后将剖析器的结果以表格或Json写入用时报告流向
+         *  开启了跟踪时，将跟踪事件写入跟踪流向 */
+        void reportTime();
+
+        /**
+         * @method emitDocument : 产生文档
+         * @desc :
+         *  位于本地文件系统的文档直接通过文件描述符写入，不经过标准库输出流的缓冲
+         *  其它文档先产生到内存中，再一次性写入输出流
+         * @param desc : 文档描述符
+         * @param emit : 产生文档内容的过程
+         * @return bool : 是否成功
+         */
+        bool emitDocument( const srcdesc& desc, const function<bool(llvm::raw_pwrite_stream&)>& emit );
+
         /**
          * @method generateAssembleFile : 产生汇编文件
          * @desc :
          *  为已经分析过语义的模块产生汇编文件
+         *  开启了链接时优化时，只产生一个以目标名称命名的、经过链接和优化的汇编文件
+         *  目标不构成完整的程序时，alioth模块的汇编文件仍然单独产生
          */
         bool generateAssembleFile();
 
@@ -269,6 +530,16 @@ class AliothCompiler : public AbstractCompiler {
          */
         bool performSyntaticAnalysis( $signature sig );
 
+        /**
+         * @method performSyntaticAnalysis : 执行语法分析
+         * @desc :
+         *  为一组模块执行语法分析，挂载片段
+         *  所有需要分析的文档先被批量打开，交互模式下它们的内容以流水线方式请求
+         * @param sigs : 模块签名
+         * @return bool : 是否成功
+         */
+        bool performSyntaticAnalysis( const signatures& sigs );
+
         /**
          * @method confirmModuleCompleteness : 检测模块完备性
          * @desc :
@@ -281,14 +552,21 @@ class AliothCompiler : public AbstractCompiler {
         /**
          * @method confirmModuleCompleteness : 检测模块完备性
          * @desc :
-         *  此方法主要用于检测给定模块的依赖是否正确，包括依赖是否重复，依赖是否可达，依赖是否循环等。
-         *  检查结果正确的模块将被放入target_modoules容器中。
+         *  此方法将给定模块及其依赖闭包加入依赖关系图，同时检测依赖是否重复，依赖是否可达。
+         *  循环依赖在所有目标模块都被加入依赖关系图之后，由arrangeTargetModules检测。
          * @param mod : 待检查的模块
-         * @param padding : 挂起的依赖，用于检查是否存在循环依赖
-         * @param _from : 此模块来自哪个依赖
-         * @return bool : 返回模块是否完备
+         * @return bool : 返回展开过程中是否没有发现问题
+         */
+        bool confirmModuleCompleteness( $signature mod );
+
+        /**
+         * @method arrangeTargetModules : 编排目标模块
+         * @desc :
+         *  在依赖关系图上检测循环依赖，并将所有完备的模块按照拓扑序放入target_modules容器中。
+         *  模块完备的条件是，模块的依赖可达且不重复，模块不在环路上，并且模块的所有依赖都完备。
+         * @return bool : 是否所有涉及的模块都完备
          */
-        bool confirmModuleCompleteness( $signature mod, chainz<tuple<$signature,$depdesc>> padding = {}, $depdesc _from = nullptr );
+        bool arrangeTargetModules();
 
         /**
          * @method calculateDependencySpace : 解算依赖空间
@@ -160,9 +160,10 @@ class CompilerContext {
          *  为节省开销，此时不建立语法树
          * @param doc : 文档描述符
          * @param forceload : 是否强制加载行为，即使从描述符看不出文档的变化。
+         * @param prefetched : 预先打开的输入流，为空时由此方法打开文档
          */
         fulldesc loadDocument( srcdesc doc, bool forceload = false );
-        fulldesc loadDocument( fulldesc doc, bool forceload = false );
+        fulldesc loadDocument( fulldesc doc, bool forceload = false, uistream prefetched = nullptr );
 
         /**
          * @method unloadDocument : 卸载文档
@@ -195,6 +196,14 @@ class CompilerContext {
          */
         bool registerFragmentFailure( srcdesc doc, const Diagnostics& info );
 
+        /**
+         * @method resetFragments : 重置片段
+         * @desc :
+         *  丢弃模块所有文档的语法树，下次语法分析时重新构造
+         * @param sig : 模块签名
+         */
+        void resetFragments( $signature sig );
+
         /** 
          * @method getFragment : 获取片段
          * @desc :
@@ -0,0 +1,98 @@
+#ifndef __depgraph__
+#define __depgraph__
+
+#include "syntax.hpp"
+#include <map>
+
+namespace alioth {
+
+/**
+ * @class DependencyGraph : 依赖关系图
+ * @desc :
+ *  以模块签名为节点，以依赖描述符为边的有向图
+ *  每次编译请求构建一次，语法分析、语义分析和代码生成都以它作为调度的依据
+ *  边由依赖者指向被依赖者，拓扑序中被依赖者总是排在依赖者之前
+ */
+class DependencyGraph {
+
+    public:
+        /**
+         * @struct edge : 边
+         * @desc : 描述一道已经解算的依赖关系 */
+        struct edge {
+
+            /**
+             * @member from : 依赖者 */
+            $signature from;
+
+            /**
+             * @member dep : 依赖描述符 */
+            $depdesc dep;
+
+            /**
+             * @member to : 被依赖者 */
+            $signature to;
+        };
+        using edges = chainz<edge>;
+
+    private:
+        /**
+         * @member nodes : 节点
+         * @desc : 按照插入顺序记录的节点，决定了遍历顺序 */
+        signatures nodes;
+
+        /**
+         * @member adjacency : 邻接表
+         * @desc : 每个节点的出边，按照依赖的书写顺序排列 */
+        map<$signature,edges> adjacency;
+
+    public:
+
+        /**
+         * @method insert : 插入节点
+         * @return bool : 若节点此前不存在则返回true */
+        bool insert( $signature sig );
+
+        /**
+         * @method connect : 插入边
+         * @desc : 端点若不存在会被自动插入 */
+        void connect( $signature from, $depdesc dep, $signature to );
+
+        /**
+         * @method contains : 是否包含节点 */
+        bool contains( $signature sig )const;
+
+        /**
+         * @method dependencies : 获取节点的出边 */
+        const edges& dependencies( $signature sig )const;
+
+        /**
+         * @method components : 计算强连通分量
+         * @desc :
+         *  使用Tarjan算法计算强连通分量，按照插入顺序选取根节点，按照书写顺序遍历依赖
+         *  分量的产出顺序即拓扑序：被依赖的分量总是先于依赖它的分量产出
+         * @return chainz<signatures> : 强连通分量序列
+         */
+        chainz<signatures> components()const;
+
+        /**
+         * @method cycle : 提取环路
+         * @desc : 在强连通分量内部寻找一条从首个节点出发并回到首个节点的环路
+         * @param component : 强连通分量
+         * @return edges : 构成环路的边，若分量中不存在环路则为空
+         */
+        edges cycle( const signatures& component )const;
+
+        /**
+         * @method topological : 获取拓扑序
+         * @desc : 环路上的节点按照Tarjan算法的产出顺序排列 */
+        signatures topological()const;
+
+        /**
+         * @method clear : 清空 */
+        void clear();
+};
+
+}
+
+#endif
@@ -2,17 +2,48 @@
 #define __diagnostic__
 
 #include <string>
+#include <string_view>
 #include "token.hpp"
 #include "chainz.hpp"
 #include "jsonz.hpp"
 #include <tuple>
 #include <map>
+#include <cstdint>
+#include <type_traits>
 
 namespace alioth {
 using namespace std;
 
 struct Diagnostic;
 
+/**
+ * @struct istring : 驻留字符串
+ * @desc :
+ *  内容相同的字符串在进程中只保存一份，驻留字符串只持有指向它的指针，复制和比较都不触碰字符串内容
+ *  诊断信息的前缀和错误码大量重复，以驻留字符串保存后，生成、复制和合并诊断信息都不再为它们分配内存
+ *  驻留的字符串直到进程结束才被释放，只应当用于取值有限的内容
+ *  每个线程缓冲自己驻留过的字符串，再次驻留同样的内容时不必加锁
+ */
+struct istring {
+
+    private:
+        static const string empty;
+        const string* str = nullptr;
+
+    public:
+        istring() = default;
+        istring( const string& s );
+
+        /** 可以转换为字符串的内容，如字面值、Uri和记号，转换后驻留 */
+        template<typename T, typename = enable_if_t<is_convertible_v<const T&,string>>>
+        istring( const T& s ):istring(string(s)) {}
+
+        operator const string& ()const { return str ? *str : empty; }
+        size_t size()const { return str ? str->size() : 0; }
+        bool operator == ( const istring& another )const { return str == another.str; }
+        bool operator != ( const istring& another )const { return str != another.str; }
+};
+
 /**
  * @struct Diagnostics : 诊断信息组
  * @desc :
@@ -23,8 +54,8 @@ class Diagnostics : public chainz<Diagnostic> {
     private:
         /**
          * @member prefix : 前缀信息
-         * @desc : 在生成诊断信息时，用于填写前缀字段的预制信息 */
-        string mprefix;
+         * @desc : 在生成诊断信息时，用于填写前缀字段的预制信息，切换前缀时不复制字符串 */
+        istring mprefix;
 
     public:
         /**
@@ -36,12 +67,13 @@ class Diagnostics : public chainz<Diagnostic> {
          * @return Diagnostics& : 返回自身引用
          */
         template<typename ...Args>
-        Diagnostics& operator () ( string code, Args&&... args ) {
+        Diagnostics& operator () ( istring code, Args&&... args ) {
             construct(-1, mprefix, code, std::forward<Args>(args)...);
             return *this;
         }
 
-        Diagnostics& operator [] ( const string& prefix ) {
+        /** 已经驻留的前缀直接使用，例如语法树节点的getDocPrefix() */
+        Diagnostics& operator [] ( istring prefix ) {
             mprefix = prefix;
             return *this;
         }
@@ -50,7 +82,7 @@ class Diagnostics : public chainz<Diagnostic> {
             return (*(chainz*)this)[index];
         }
 
-        string prefix() {return mprefix;}
+        istring prefix() {return mprefix;}
 };
 
 /**
@@ -64,12 +96,12 @@ struct Diagnostic {
      * @member prefix : 前缀信息
      * @desc :
      *  前缀信息一般用于指示诊断信息涉及的文档的前缀，也可以利用它传递其他信息 */
-    string prefix;
+    istring prefix;
 
     /**
      * @member code : 错误码
      * @desc : 编译器使用错误码选择如何组织诊断参数 */
-    string code;
+    istring code;
 
     /**
      * @member args : 诊断参数
@@ -90,7 +122,7 @@ struct Diagnostic {
      * @param _args : 诊断参数
      */
     template<typename ...Args>
-    Diagnostic( string _prefix, string _code, Args&&... _args ):prefix(_prefix),code(_code) {
+    Diagnostic( istring _prefix, istring _code, Args&&... _args ):prefix(_prefix),code(_code) {
         (args.construct(-1,forward<Args>(_args)), ...);
     }
 
@@ -107,7 +139,7 @@ struct Diagnostic {
      * @return Diagnostic& : 返回自身引用
      */
     template<typename ...Args>
-    Diagnostic& operator () ( string _prefix, string _code, Args&&... _args ) {
+    Diagnostic& operator () ( istring _prefix, istring _code, Args&&... _args ) {
         info.construct(-1, _prefix, _code, std::forward<Args>(_args)... );
         return *this;
     }
@@ -154,6 +186,68 @@ struct DiagnosticTemplate {
     string msg;
 };
 
+/**
+ * @struct DiagnosticTemplateRef : 诊断模板引用
+ * @desc :
+ *  查找诊断模板的结果，信息格式引用模板表或映射的诊断目录中以'\0'结尾的文本，打印时不必复制模板
+ *  未找到模板时信息格式为空引用
+ */
+struct DiagnosticTemplateRef {
+    int severity = 0;
+    tuple<int,int> beg;
+    tuple<int,int> end;
+    string_view msg;
+
+    explicit operator bool()const { return msg.data() != nullptr; }
+};
+
+/**
+ * @struct DiagnosticCatalog : 诊断目录
+ * @desc :
+ *  由diagnostic.json预编译而来的二进制诊断目录，编译器启动时读取目录，不必解析Json
+ *  目录依次由头部、语种表、模板表和字符串池构成，所有引用都是相对于目录起始的字节偏移
+ *  每个语种的模板按照诊断代码排序，目录在诊断引擎的生命期内保持映射，查找模板时直接二分查找映射的模板表
+ */
+struct DiagnosticCatalog {
+
+    static const char magic[4];         //目录文件的魔数
+    static const uint32_t version;      //目录格式的版本
+
+    /**
+     * @struct header : 目录头部
+     * @desc : mtime和size是生成目录所用的diagnostic.json的修改时间和尺寸，与配置文件不符的目录被视为过期 */
+    struct header {
+        char magic[4];
+        uint32_t version;
+        int64_t mtime;
+        uint64_t size;
+        uint32_t format;
+        uint32_t language;
+        uint32_t languages;
+    };
+
+    /**
+     * @struct language : 语种记录
+     * @desc : templates是模板表的偏移，count是模板数量 */
+    struct language {
+        uint32_t name;
+        uint32_t severities[4];
+        uint32_t templates;
+        uint32_t count;
+    };
+
+    /**
+     * @struct entry : 模板记录
+     * @desc : code和msg是字符串池中以'\0'结尾的字符串的偏移 */
+    struct entry {
+        uint32_t code;
+        int32_t severity;
+        int32_t beg[2];
+        int32_t end[2];
+        uint32_t msg;
+    };
+};
+
 /**
  * @struct DiagnosticLanguage : 诊断语种
  * @desc :
@@ -168,8 +262,23 @@ struct DiagnosticLanguage {
 
     /**
      * @member templates : 诊断模板表
-     * @desc : 当前语种的诊断信息模板表 */
+     * @desc : 由配置文件构造的诊断信息模板表，配置之后不再改变 */
     map<string,DiagnosticTemplate> templates;
+
+    /**
+     * @member catalog, entries, count : 目录模板表
+     * @desc : 从诊断目录加载的语种直接引用映射的目录，模板表按诊断代码排序 */
+    const char* catalog = nullptr;
+    const DiagnosticCatalog::entry* entries = nullptr;
+    uint32_t count = 0;
+
+    /**
+     * @method lookup : 查找诊断模板
+     * @desc : 先在templates中查找，再二分查找目录模板表，查找过程只读，打印时可以被多个线程同时查找
+     * @param code : 诊断代码
+     * @return DiagnosticTemplateRef : 诊断模板引用，未找到时为空引用
+     */
+    DiagnosticTemplateRef lookup( const string& code )const;
 };
 
 /**
@@ -185,14 +294,30 @@ class DiagnosticEngine {
         const DiagnosticLanguage* language;
         map<string,DiagnosticLanguage> languages;
 
+        /**
+         * @member catalog, catalog_size : 映射到内存中的诊断目录
+         * @desc : 从目录加载的语种引用其中的文本，映射在诊断引擎析构时解除 */
+        const char* catalog = nullptr;
+        size_t catalog_size = 0;
+
+        /**
+         * @static-method Builtin : 内置语种
+         * @desc :
+         *  名为default的语种，只包含配置诊断引擎时可能用到的基础诊断模板，在整个进程中只构造一次
+         *  配置文件或诊断目录中的语种不依赖内置语种，加载目录时不必构造内置模板
+         */
+        static const DiagnosticLanguage& Builtin();
+
     public:
 
         /**
          * @ctor : 构造器
          * @desc :
-         *  构造器会为诊断引擎配备基础诊断模板
+         *  构造器选择内置语种，在配置或加载目录之前也可以打印基础诊断信息
          */
         DiagnosticEngine();
+        DiagnosticEngine( const DiagnosticEngine& ) = delete;
+        ~DiagnosticEngine();
 
         /**
          * @method configure : 配置
@@ -203,6 +328,28 @@ class DiagnosticEngine {
          */
         bool configure( const json& config );
 
+        /**
+         * @method loadCatalog : 加载诊断目录
+         * @desc :
+         *  映射预编译的诊断目录，设置格式，登记其中的语种并选择默认语种，语种的模板表直接引用映射的目录
+         *  目录不存在、损坏或与配置文件的修改时间和尺寸不符时不做任何修改，调用者应当回退到解析配置文件
+         * @param path : 目录文件路径
+         * @param mtime : 配置文件的修改时间
+         * @param size : 配置文件的尺寸
+         * @return bool : 是否加载成功
+         */
+        bool loadCatalog( const string& path, int64_t mtime, uint64_t size );
+
+        /**
+         * @method saveCatalog : 保存诊断目录
+         * @desc : 将当前的格式和全部语种编译为诊断目录
+         * @param path : 目录文件路径
+         * @param mtime : 配置文件的修改时间
+         * @param size : 配置文件的尺寸
+         * @return bool : 是否保存成功
+         */
+        bool saveCatalog( const string& path, int64_t mtime, uint64_t size )const;
+
         /**
          * @method configureFormat : 配置格式
          * @desc :
@@ -232,6 +379,7 @@ class DiagnosticEngine {
          * @method selectLanguage : 选择语言
          * @desc :
          *  选择一种语言作为当前语言，打印之前的必备步骤
+         *  没有配置名为default的语种时，default指内置语种
          */
         bool selectLanguage( const string& lang );
 
@@ -252,6 +400,15 @@ class DiagnosticEngine {
          */
         chainz<string> printToString( const Diagnostics& s )const;
 
+        /**
+         * @method printToString : 打印到缓冲
+         * @desc :
+         *  将诊断信息打印并追加到out的末尾，用于反复使用同一个缓冲逐条输出诊断信息
+         * @param d : 诊断信息
+         * @param out : 输出缓冲
+         */
+        void printToString( const Diagnostic& d, string& out )const;
+
         /**
          * @method printToJson : 打印到Json
          * @desc :
@@ -276,10 +433,20 @@ class DiagnosticEngine {
          * @desc :
          *  将诊断信息所携带的诊断变量插入诊断信息模板，组成字符串
          * @param d : 诊断信息
+         * @param res : 用于追加未格式化的诊断信息
          * @param colored : 是否着色
-         * @return string : 未格式化的诊断信息
          */
-        string organizeDiagnosticInformation( const Diagnostic& d, bool colored = true ) const;
+        void organizeDiagnosticInformation( const Diagnostic& d, string& res, bool colored = true ) const;
+
+        /**
+         * @method formatDiagnostic : 格式化诊断信息
+         * @desc :
+         *  按照格式字符串将诊断信息追加到res的末尾，辅助信息换行并按层级缩进
+         * @param d : 诊断信息
+         * @param res : 输出缓冲
+         * @param depth : 诊断信息所在的层级，顶层为0
+         */
+        void formatDiagnostic( const Diagnostic& d, string& res, int depth )const;
 
 };
 
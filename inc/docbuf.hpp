@@ -0,0 +1,96 @@
+#ifndef __docbuf__
+#define __docbuf__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace alioth {
+using namespace std;
+
+/**
+ * @class DocumentBuffer : 文档缓冲
+ * @desc :
+ *  交互模式下编译器一侧持有的文档内容，由IDE发来的编辑操作逐步修改
+ *  内容被切分为若干长度相近的片段，每个片段记录自身包含的换行符数量
+ *  一次编辑只改动编辑位置所在的片段，定位行列时按片段跳过，不必扫描整个文档
+ */
+class DocumentBuffer {
+
+    public:
+        static const size_t piece_size;     //片段的期望长度，片段长度超过两倍时被拆分
+
+    private:
+        /**
+         * @struct piece : 片段 */
+        struct piece {
+
+            /**
+             * @member text : 片段内容 */
+            string text;
+
+            /**
+             * @member lines : 片段内容中换行符的数量 */
+            size_t lines = 0;
+        };
+
+        /**
+         * @member pieces : 片段序列
+         * @desc : 至少包含一个片段，空文档对应一个空片段 */
+        vector<piece> pieces;
+
+        /**
+         * @member length : 文档内容的总字节数 */
+        size_t length;
+
+    public:
+
+        /**
+         * @ctor : 构造函数
+         * @param content : 文档的初始内容
+         */
+        DocumentBuffer( const string& content = "" );
+
+        /**
+         * @method assign : 整体替换文档内容 */
+        void assign( const string& content );
+
+        /**
+         * @method replace : 替换文本
+         * @desc : 将从offset开始的count个字节替换为text，范围越界时文档不被修改
+         * @param offset : 起始字节偏移
+         * @param count : 被替换的字节数
+         * @param text : 替换文本
+         * @return bool : 范围是否有效
+         */
+        bool replace( size_t offset, size_t count, const string& text );
+
+        /**
+         * @method locate : 定位行列
+         * @desc : 将从1开始计数的行号和字节列号转换为字节偏移
+         * @param line : 行号
+         * @param column : 列号
+         * @param offset : 用于接收字节偏移
+         * @return bool : 行列是否位于文档之内
+         */
+        bool locate( size_t line, size_t column, size_t& offset )const;
+
+        /**
+         * @method size : 获取文档内容的总字节数 */
+        size_t size()const;
+
+        /**
+         * @method content : 获取完整的文档内容 */
+        string content()const;
+
+    private:
+
+        /**
+         * @method balance : 平衡片段
+         * @desc : 拆分过长的片段，将过短的片段与后继合并，只处理index附近的片段 */
+        void balance( size_t index );
+};
+
+}
+
+#endif
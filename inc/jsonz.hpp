@@ -133,6 +133,24 @@ class json {
          */
         static json FromJsonStream( std::istream& is );
         std::string toJsonString()const;
+
+        /**
+         * @method toJsonString : 输出Json文本
+         * @desc : 将Json文本追加到out的末尾，可以反复使用同一个缓冲，不产生中间字符串 */
+        void toJsonString( std::string& out )const;
+
+        /**
+         * @method FromMsgPack : 从MessagePack数据解码Json
+         * @desc :
+         *  解码[begin,end)中的一个值，begin被推进到这个值之后
+         *  数据不完整、格式错误、使用了Json无法表示的类型或数组和对象嵌套超过depth层时抛出异常
+         */
+        static json FromMsgPack( const char*& begin, const char* end, int depth = 64 );
+
+        /**
+         * @method toMsgPack : 以MessagePack格式编码
+         * @desc : 编码结果追加到out之后，整数和长度总是选用最短的表示 */
+        void toMsgPack( std::string& out )const;
     
     public:
         chainz<json>::iterator begin();
@@ -4,6 +4,7 @@
 #include "alioth.hpp"
 #include "token.hpp"
 #include <iostream>
+#include <vector>
 
 namespace alioth {
 using namespace std;
@@ -80,6 +81,25 @@ class LexicalContext {
          * @member heading : 限制
          * @desc : 此成员描述词法分析流程是否受到范围限制，若受到范围限制,则词法分析仅分析模块签名 */
         bool heading;
+
+        /**
+         * @member consumed : 已扫描的字节数
+         * @desc : 从扫描开始的位置算起，已经被词法符号吸收的字节数 */
+        long consumed;
+
+        /**
+         * @member stops : 停止点
+         * @desc : 增量分析时，与旧词法序列中的记号对齐的偏移量，升序排列，扫描在其中一个记号边界处停止 */
+        std::vector<long> stops;
+
+        /**
+         * @member next : 下一个停止点 */
+        size_t next;
+
+        /**
+         * @member halted : 是否停止
+         * @desc : 扫描是否因为到达停止点而结束 */
+        bool halted;
     
     public:
 
@@ -99,7 +119,31 @@ class LexicalContext {
          */
         tokens perform();
 
+        /**
+         * @method Relex : 增量分析
+         * @desc :
+         *  文档被编辑后，只重新分析受损的区域
+         *  旧文本和新文本的公共前缀之前的记号被保留，扫描从最后一个可能受影响的记号开始
+         *  扫描进入公共后缀后，在与某个旧记号的开头对齐的边界停止，此后的旧记号被保留，行列被平移
+         *  记号边界处的状态总是初始状态，所以结果与完整地分析新文本一致
+         * @param text : 旧文本，返回时被替换为新文本
+         * @param toks : 旧文本完整的词法序列，返回时被替换为新文本的词法序列，若为空则完整地分析新文本
+         * @param after : 新文本
+         * @return int : 重新扫描产生的记号个数
+         */
+        static int Relex( string& text, tokens& toks, string after );
+
     private:
+        /**
+         * @method scan : 扫描
+         * @desc :
+         *  从输入流的当前位置开始扫描，产物追加到分析产物序列
+         *  扫描到输入结束或停止点时结束
+         * @param line : 开始位置的行
+         * @param column : 开始位置的列
+         */
+        void scan( int line, int column );
+
         /**
          * @method goon : 继续
          * @desc :
@@ -0,0 +1,112 @@
+#ifndef __objcache__
+#define __objcache__
+
+#include <string>
+#include <cstdint>
+
+namespace alioth {
+using namespace std;
+
+/**
+ * @class ObjectCache : 目标文件缓存
+ * @desc :
+ *  位于本地文件系统中的共享目录，以内容指纹为键保存后端产生的目标文件，供多个工作空间复用
+ *  写入总是先写入临时文件再原子地重命名，多个编译器进程可以同时使用同一个缓存目录
+ *  缓存总量超过容量时，按照最近使用时间淘汰最久未使用的条目
+ */
+class ObjectCache {
+
+    public:
+        /**
+         * @struct statistics : 统计信息
+         * @desc : 记录本次编译过程中缓存的使用情况 */
+        struct statistics {
+
+            /**
+             * @member hits : 命中次数 */
+            int hits = 0;
+
+            /**
+             * @member misses : 未命中次数 */
+            int misses = 0;
+
+            /**
+             * @member stores : 存入次数 */
+            int stores = 0;
+
+            /**
+             * @member evictions : 淘汰次数 */
+            int evictions = 0;
+        };
+
+    private:
+        /**
+         * @member dir : 缓存目录 */
+        string dir;
+
+        /**
+         * @member capacity : 容量
+         * @desc : 缓存目录中所有条目的总字节数上限 */
+        uint64_t capacity;
+
+        /**
+         * @member stats : 统计信息 */
+        statistics stats;
+
+    public:
+
+        /**
+         * @ctor : 构造函数
+         * @param path : 缓存目录的路径
+         * @param capacity : 容量，单位为字节
+         */
+        ObjectCache( const string& path, uint64_t capacity );
+
+        /**
+         * @method open : 打开缓存目录
+         * @desc : 缓存目录不存在时会被创建
+         * @return bool : 缓存目录是否可读写 */
+        bool open();
+
+        /**
+         * @method fetch : 取出条目
+         * @desc : 命中时刷新条目的最近使用时间
+         * @param key : 键
+         * @param content : 用于接收条目内容
+         * @return bool : 是否命中
+         */
+        bool fetch( const string& key, string& content );
+
+        /**
+         * @method store : 存入条目
+         * @desc : 存入不淘汰条目，由调用者在一批存入完成后修剪缓存
+         * @param key : 键
+         * @param content : 条目内容
+         * @return bool : 是否存入成功
+         */
+        bool store( const string& key, const string& content );
+
+        /**
+         * @method getStatistics : 获取统计信息 */
+        const statistics& getStatistics()const;
+
+        /**
+         * @method getPath : 获取缓存目录的路径 */
+        const string& getPath()const;
+
+        /**
+         * @method trim : 修剪缓存
+         * @desc : 按照最近使用时间从旧到新淘汰条目，直到总量不超过容量，同时清理遗留的临时文件
+         *  修剪需要列举整个缓存目录，应当在一次构建的所有存入完成后调用一次 */
+        void trim();
+
+    private:
+
+        /**
+         * @method locate : 计算条目的路径 */
+        string locate( const string& key )const;
+};
+
+}
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef __profiler__
+#define __profiler__
+
+#include "jsonz.hpp"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <array>
+#include <memory>
+#include <ostream>
+#include <mutex>
+
+namespace alioth {
+using namespace std;
+
+/**
+ * @class Profiler : 性能剖析器
+ * @desc :
+ *  以阶段和模块为单位累积用时和计数，供`--time-report`以表格或Json报告编译过程的开销
+ *  用时由作用域对象度量，作用域析构时将用时和作用域内累积的计数合并到当前线程的累积表，不必加锁
+ *  各线程的累积表在报告时才合并，报告应当在度量结束之后进行
+ *  计数总是累积到当前线程上最内层的作用域，并发执行的任务各自持有作用域，累积计数时不必加锁
+ *  剖析器未开启时作用域不做任何事，计数也被丢弃
+ *  开启跟踪后，每个作用域还在当前线程的轨道上留下一个跟踪事件，最终以Chrome跟踪格式输出
+ */
+class Profiler {
+
+    public:
+        using clock = chrono::steady_clock;
+
+        /**
+         * @enum counter : 计数器 */
+        enum counter {
+            BYTES,      // 读取的源代码字节数
+            TOKENS,     // 词法分析产生的记号数
+            NODES,      // 构造的语法结构数
+            LOOKUPS,    // 名称搜索次数
+            INSTANCES,  // 模板类实例化次数
+            COUNTERS
+        };
+
+        /**
+         * @struct entry : 条目
+         * @desc : 一个阶段或阶段中一个模块的累积结果 */
+        struct entry {
+
+            /**
+             * @member module : 模块名，阶段自身的条目为空 */
+            string module;
+
+            /**
+             * @member time : 累积用时
+             * @desc : 阶段自身的用时是墙上时间，模块的用时是各线程用时之和 */
+            clock::duration time = {};
+
+            /**
+             * @member calls : 度量次数 */
+            long calls = 0;
+
+            /**
+             * @member counters : 计数 */
+            array<long,COUNTERS> counters = {};
+        };
+
+        /**
+         * @struct phase : 阶段
+         * @desc : 阶段和模块都按照首次开始度量的顺序排列，同一编译过程的报告总是可以逐行比较 */
+        struct phase {
+
+            /**
+             * @member name : 阶段名 */
+            string name;
+
+            /**
+             * @member total : 阶段自身的条目 */
+            entry total;
+
+            /**
+             * @member modules : 阶段中各模块的条目
+             * @desc : 追加条目不会使已有条目的地址失效，作用域构造时定位的条目在析构时可以直接使用 */
+            deque<entry> modules;
+
+            /**
+             * @member index : 以模块名索引条目 */
+            map<string,entry*,less<>> index;
+        };
+
+        /**
+         * @struct event : 跟踪事件 */
+        struct event {
+
+            /**
+             * @member phase, module : 作用域的阶段名和模块名 */
+            string phase;
+            string module;
+
+            /**
+             * @member start : 开始时刻 */
+            clock::time_point start;
+
+            /**
+             * @member time : 持续时间 */
+            clock::duration time;
+        };
+
+        /**
+         * @struct track : 轨道
+         * @desc :
+         *  一个线程记录的跟踪事件，只有所属的线程写入，记录事件时不必加锁
+         *  事件数目达到容量后轨道成为环形缓冲，新的事件覆盖最早的事件，长时间的编译也只占用有限的内存 */
+        struct track {
+
+            /**
+             * @member tid : 线程号 */
+            long tid;
+
+            /**
+             * @member events : 事件 */
+            vector<event> events;
+
+            /**
+             * @member next : 环形缓冲中下一个被覆盖的位置 */
+            size_t next = 0;
+
+            /**
+             * @member dropped : 被覆盖的事件数目 */
+            long dropped = 0;
+        };
+
+        /**
+         * @struct table : 累积表
+         * @desc :
+         *  一个线程累积的结果，只有所属的线程写入，作用域构造和析构时不必加锁
+         *  线程第一次度量某个阶段和模块时，在加锁的情况下于剖析器中定位条目，阶段和模块依然按照首次开始度量的顺序排列 */
+        struct table {
+
+            /**
+             * @struct slot : 槽
+             * @desc : target是剖析器中的条目，local是本线程尚未合并的累积结果 */
+            struct slot {
+                entry* target;
+                entry local;
+            };
+
+            /**
+             * @member slots : 槽，追加槽不会使已有槽的地址失效 */
+            deque<slot> slots;
+
+            /**
+             * @member index : 以阶段名和模块名索引槽 */
+            map<string,map<string,slot*,less<>>,less<>> index;
+        };
+
+        /**
+         * @member TrackCapacity : 每个轨道最多保留的事件数目 */
+        static constexpr size_t TrackCapacity = 1 << 15;
+
+        /**
+         * @class scope : 作用域
+         * @desc : 构造时开始计时并成为当前线程上最内层的作用域，析构时将结果合并到剖析器 */
+        class scope {
+            private:
+                Profiler* owner;
+                scope* saved;
+                table::slot* slot = nullptr;
+                string phase;
+                string module;
+                clock::time_point start;
+                array<long,COUNTERS> counters = {};
+                friend class Profiler;
+            public:
+                scope( Profiler* owner, const string& phase, const string& module );
+
+                /**
+                 * @ctor : 嵌套作用域
+                 * @desc : 度量当前线程上最内层的作用域中的一个阶段，沿用其剖析器和模块名，没有作用域时不做任何事
+                 *  供不持有剖析器的组件度量自己的阶段 */
+                scope( const string& phase );
+                scope( const scope& ) = delete;
+                ~scope();
+        };
+
+    private:
+        /**
+         * @member enabled : 是否开启 */
+        bool enabled = false;
+
+        /**
+         * @member tracing : 是否记录跟踪事件 */
+        bool tracing = false;
+
+        /**
+         * @member origin : 开启剖析器的时刻 */
+        clock::time_point origin;
+
+        /**
+         * @member phases : 各阶段的累积结果
+         * @desc : 报告时合并各线程的累积表 */
+        mutable deque<phase> phases;
+
+        /**
+         * @member lock : 保护phases以及tables和tracks的登记 */
+        mutable mutex lock;
+
+        /**
+         * @member tables : 各线程的累积表
+         * @desc : 累积表由剖析器持有，工作线程结束后其累积的结果依然保留，报告时合并 */
+        vector<unique_ptr<table>> tables;
+
+        /**
+         * @member tracks : 各线程的轨道
+         * @desc : 轨道由剖析器持有，工作线程结束后其记录的事件依然保留 */
+        vector<unique_ptr<track>> tracks;
+
+        /**
+         * @member current : 当前线程上最内层的作用域 */
+        static thread_local scope* current;
+
+        /**
+         * @member tracked : 当前线程的轨道 */
+        static thread_local track* tracked;
+
+        /**
+         * @member counted : 当前线程的累积表 */
+        static thread_local table* counted;
+
+    public:
+
+        /**
+         * @method enable : 开启剖析器
+         * @desc : 从此刻起度量的结果才会被记录，报告中的总用时也从此刻算起 */
+        void enable();
+
+        /**
+         * @method isEnabled : 剖析器是否开启 */
+        bool isEnabled()const;
+
+        /**
+         * @method enableTracing : 开启跟踪
+         * @desc : 同时开启剖析器 */
+        void enableTracing();
+
+        /**
+         * @method isTracing : 是否开启了跟踪 */
+        bool isTracing()const;
+
+        /**
+         * @method measure : 度量
+         * @desc : 构造一个作用域，在作用域析构前的用时和计数记在指定的阶段和模块名下
+         * @param phase : 阶段名
+         * @param module : 模块名，为空时度量阶段自身
+         * @return scope : 作用域
+         */
+        scope measure( const string& phase, const string& module = "" );
+
+        /**
+         * @method toTable : 组织为表格
+         * @desc : 每个阶段一行，其后是阶段中各模块的行，阶段的计数包含其中所有模块的计数
+         * @return string : 多行文本，以换行符结尾
+         */
+        string toTable()const;
+
+        /**
+         * @method toJson : 组织为Json
+         * @return json : 包含总用时和各阶段条目的对象，用时以毫秒为单位
+         */
+        json toJson()const;
+
+        /**
+         * @method writeTrace : 输出跟踪
+         * @desc :
+         *  以Chrome跟踪格式输出所有轨道中的事件，可以由chrome://tracing或Perfetto打开
+         *  每个事件是一个完整事件，时间以开启剖析器的时刻为零点，单位为微秒
+         * @param os : 输出流
+         */
+        void writeTrace( ostream& os )const;
+
+        /**
+         * @static-method Count : 计数
+         * @desc : 将计数累积到当前线程上最内层的作用域，没有作用域时计数被丢弃
+         * @param c : 计数器
+         * @param n : 增量
+         */
+        static void Count( counter c, long n = 1 );
+
+        /**
+         * @static-method CounterName : 获取计数器的名称 */
+        static const char* CounterName( counter c );
+
+    private:
+
+        /**
+         * @method locate : 定位条目
+         * @desc : 获取阶段和模块的条目，不存在时按顺序追加，调用者持有锁
+         *  作用域构造时即定位条目，阶段按照开始的顺序而不是结束的顺序排列 */
+        entry& locate( const string& phase, const string& module );
+
+        /**
+         * @method account : 定位槽
+         * @desc : 在当前线程的累积表中获取阶段和模块的槽，线程第一次度量时登记累积表，槽不存在时加锁定位条目 */
+        table::slot& account( const string& phase, const string& module );
+
+        /**
+         * @method collect : 合并累积表
+         * @desc : 将各线程的累积结果合并到条目并清零，调用者持有锁 */
+        void collect()const;
+
+        /**
+         * @method trace : 记录跟踪事件
+         * @desc : 将事件写入当前线程的轨道，线程第一次记录事件时登记轨道 */
+        void trace( event&& e );
+};
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __scheduler__
+#define __scheduler__
+
+#include <functional>
+#include <vector>
+#include <set>
+
+namespace alioth {
+using namespace std;
+
+/**
+ * @class Scheduler : 任务调度器
+ * @desc :
+ *  调度器以有向无环图的形式组织任务，任务的所有前驱完成后，任务才会被投放到工作线程执行
+ *  任务只能依赖先于自己提交的任务，因此提交顺序本身就是一个合法的拓扑序
+ *  工作线程数目不大于1时，任务在调用线程上依提交顺序执行
+ */
+class Scheduler {
+
+    public:
+        /**
+         * @type task : 任务
+         * @desc : 任务返回是否执行成功 */
+        using task = function<bool()>;
+
+    private:
+        struct job {
+
+            /**
+             * @member run : 任务实体 */
+            task run;
+
+            /**
+             * @member next : 后继任务 */
+            vector<int> next;
+
+            /**
+             * @member padding : 尚未完成的前驱任务数目 */
+            int padding = 0;
+        };
+
+        /**
+         * @member jobs : 任务表
+         * @desc : 任务的下标即任务编号 */
+        vector<job> jobs;
+
+    public:
+
+        /**
+         * @method submit : 提交任务
+         * @desc :
+         *  提交一个任务，并声明它所依赖的前驱任务
+         * @param t : 任务实体
+         * @param deps : 前驱任务编号，未知的编号将被忽略
+         * @return int : 任务编号
+         */
+        int submit( task t, const set<int>& deps = {} );
+
+        /**
+         * @method perform : 执行任务
+         * @desc :
+         *  执行所有已提交的任务，执行完毕后任务表被清空
+         *  任务抛出的第一个异常会在所有工作线程结束后被重新抛出
+         * @param workers : 工作线程数目
+         * @return bool : 所有任务是否都执行成功
+         */
+        bool perform( int workers );
+
+        /**
+         * @static-method Concurrency : 获取并发度
+         * @desc : 将用户指定的线程数目规整为可用的线程数目，0表示使用硬件并发度 */
+        static int Concurrency( int jobs );
+};
+
+}
+
+#endif
@@ -3,6 +3,14 @@
 
 #include "syntax.hpp"
 #include "context.hpp"
+#include "depgraph.hpp"
+#include "profiler.hpp"
+#include <mutex>
+#include <deque>
+#include <set>
+#include <unordered_map>
+#include <string_view>
+#include <vector>
 
 namespace alioth {
 
@@ -34,6 +42,16 @@ struct module : public node {
          * @member entry : 入口方法 */
         $metdef entry;
 
+        /**
+         * @member frags : 片段
+         * @desc : 模块持有其片段，保证语法树的作用域链在模块存活期间有效 */
+        fragments frags;
+
+        /**
+         * @member referenced : 被引用的模块
+         * @desc : 语义检查会把其他模块的语法结构写入此模块的语法树，被引用的模块须至少与此模块存活得一样久 */
+        set<$module> referenced;
+
     public:
         module( SemanticContext& context );
         virtual ~module() = default;
@@ -136,6 +154,81 @@ struct ConvertPath : public basic_thing {
  */
 class SemanticContext {
 
+    protected:
+        /**
+         * @class diagnostics_channel : 诊断信息通道
+         * @desc :
+         *  并行检查时，每个任务将诊断信息写入自己的诊断信息容器，待所有任务结束后按固定顺序合并
+         *  通道将诊断信息导向当前线程绑定的容器，未绑定时导向语义上下文的诊断信息容器
+         */
+        class diagnostics_channel {
+            private:
+                Diagnostics& repo;
+                static thread_local Diagnostics* bound;
+            public:
+                class binding {
+                    private:
+                        Diagnostics* saved;
+                    public:
+                        binding( Diagnostics& target ):saved(bound) { bound = &target; }
+                        ~binding() { bound = saved; }
+                };
+            public:
+                diagnostics_channel( Diagnostics& _repo ):repo(_repo){}
+                Diagnostics& current()const { return bound?*bound:repo; }
+
+                template<typename ...Args>
+                Diagnostics& operator () ( string code, Args&&... args ) {
+                    return current()(code, std::forward<Args>(args)...);
+                }
+                Diagnostics& operator [] ( const string& prefix ) { return current()[prefix]; }
+                Diagnostic& operator [] ( int index ) { return current()[index]; }
+                diagnostics_channel& operator += ( const Diagnostics& ds ) { current() += ds; return *this; }
+        };
+
+        /**
+         * @struct record : 检查记录
+         * @desc :
+         *  记录一个模块的定义检查或一个实现的检查结论，以及检查过程中搜索过的模块
+         *  在被检查的语法结构被释放，或者它所搜索过的模块接口发生改变之前，检查结论可以被复用
+         *  语义检查会改写语法树，结论不能复用的语法树无法被再次检查，只能重新构造
+         */
+        struct record {
+
+            /**
+             * @member valid : 结论是否有效 */
+            bool valid = false;
+
+            /**
+             * @member success : 检查是否成功 */
+            bool success = false;
+
+            /**
+             * @member ds : 检查产生的诊断信息 */
+            Diagnostics ds;
+
+            /**
+             * @member refs : 引用
+             * @desc : 检查过程中搜索过的模块，以及检查结束时这些模块的接口版本 */
+            map<$module,int> refs;
+
+            /**
+             * @member usages : 用例
+             * @desc : 检查过程中实例化过其模板类的模块，模块的语法树被替换后用例随之消失 */
+            set<$module> usages;
+
+            /**
+             * @class binding : 绑定
+             * @desc : 在当前线程上将搜索过程导向此记录 */
+            class binding {
+                private:
+                    record* saved;
+                public:
+                    binding( record& target ):saved(recording) { recording = &target; }
+                    ~binding() { recording = saved; }
+            };
+        };
+
     private:
 
         /**
@@ -143,8 +236,18 @@ class SemanticContext {
         CompilerContext& cctx;
 
         /**
-         * @member diagnostics : 诊断信息容器 */
-        Diagnostics& diagnostics;
+         * @member diagnostics : 诊断信息通道 */
+        diagnostics_channel diagnostics;
+
+        /**
+         * @member concurrency : 并发度
+         * @desc : 语义检查使用的工作线程数目，0表示使用硬件并发度 */
+        int concurrency = 1;
+
+        /**
+         * @member profiler : 性能剖析器
+         * @desc : 每个模块的定义检查和每个实现的检查分别记在模块名下，为空时不度量 */
+        Profiler* profiler = nullptr;
 
         /**
          * @member forest : 语法树森林
@@ -152,22 +255,70 @@ class SemanticContext {
         map<$signature,$module> forest;
 
         /**
-         * @member symbol_cache : 二进制符号缓冲 */
-        map<$node, string> symbol_cache;
+         * @member symbol_cache : 二进制符号缓冲
+         * @desc : 以语法结构的地址为键，记录符号编号；同时持有语法结构的代理，避免地址在清空缓冲前被复用 */
+        unordered_map<node*, tuple<$node,int>> symbol_cache;
+
+        /**
+         * @member symbol_pool : 符号池
+         * @desc : 二进制符号驻留于此，符号编号即下标，deque保证已驻留符号的地址不变 */
+        deque<string> symbol_pool;
+
+        /**
+         * @member symbol_ids : 符号编号表 */
+        unordered_map<string_view,int> symbol_ids;
 
         /**
          * @member dep_cache : 依赖关系缓冲 */
         map<$depdesc, $module> dep_cache;
 
+        /**
+         * @member cache_lock : 缓冲锁
+         * @desc : 保护符号缓冲、符号池和dep_cache，仅在查找和填写时持有 */
+        mutex cache_lock;
+
+        /**
+         * @member usage_lock : 模板用例锁
+         * @desc : 模板用例的检索、产生和检查过程是一个整体，检查用例时可能再次产生用例，故使用递归锁 */
+        recursive_mutex usage_lock;
+
         /**
          * @member searching_layers : 搜索层
-         * @desc : 用于检查循环搜索的缓冲 */
-        chainz<$scope> searching_layers;
+         * @desc : 用于检查循环搜索的缓冲，每个线程独立持有 */
+        static thread_local chainz<$scope> searching_layers;
 
         /**
          * @member alias_searching_layers : 别名搜索
-         * @desc : 和searching_ayers 联合组成循环搜索检查数据基础 */
-        chainz<$aliasdef> alias_searching_layers;
+         * @desc : 和searching_ayers 联合组成循环搜索检查数据基础，每个线程独立持有 */
+        static thread_local chainz<$aliasdef> alias_searching_layers;
+
+        /**
+         * @member recording : 当前线程正在填写的检查记录 */
+        static thread_local record* recording;
+
+        /**
+         * @member definition_records : 模块定义的检查记录
+         * @desc : 以模块为键，模块的语法树被替换后记录随之失效 */
+        map<$module,record> definition_records;
+
+        /**
+         * @member implementation_records : 实现的检查记录 */
+        map<$implementation,record> implementation_records;
+
+        /**
+         * @member interfaces : 接口指纹
+         * @desc : 模块所有定义的二进制符号和类型信息，模块被释放后仍然保留，用于和重新关联后的模块比较 */
+        map<$signature,string> interfaces;
+
+        /**
+         * @member revisions : 接口版本
+         * @desc : 模块的接口指纹每改变一次，版本增加一次 */
+        map<$signature,int> revisions;
+
+        /**
+         * @member stale : 陈旧模块
+         * @desc : 检查结论不能复用，需要重新构造语法树的模块 */
+        set<$signature> stale;
 
     public:
 
@@ -197,7 +348,7 @@ class SemanticContext {
         /**
          * @method releaseModules : 批量释放模块
          * @desc :
-         *  批量释放模块信息
+         *  批量释放模块信息，同时遗忘模块的接口版本
          */
         void releaseModules( signatures );
 
@@ -219,21 +370,72 @@ class SemanticContext {
          * @method clearCache : 清空缓冲信息 */
         void clearCache();
 
+        /**
+         * @method getSymbol : 获取符号
+         * @desc : 根据符号编号获取驻留的二进制符号，编号在清空缓冲之前有效 */
+        const string& getSymbol( int id );
+
+        /**
+         * @method internSymbol : 驻留符号
+         * @desc : 将符号驻留在符号池中，相同的符号总是得到相同的编号 */
+        int internSymbol( const string& symbol );
+
+        /**
+         * @method setConcurrency : 设置并发度
+         * @desc :
+         *  设置语义检查使用的工作线程数目
+         *  模块的定义按照依赖关系调度，相互独立的模块并行检查；所有定义检查完成后，各个实现并行检查
+         * @param jobs : 工作线程数目，0表示使用硬件并发度
+         */
+        void setConcurrency( int jobs );
+
+        /**
+         * @method setProfiler : 设置性能剖析器 */
+        void setProfiler( Profiler* p );
+
         /**
          * @method validateDefinitionSemantics : 检验定义语义
          * @desc :
          *  检查定义的语义正确性，过程中可能会修正一些语法结构
+         *  已经检查过的模块，若其所搜索过的模块接口都没有改变，则复用上次的检查结论，否则被登记为陈旧模块
+         *  存在陈旧模块时，诊断信息不被合并，应当重新构造陈旧模块的语法树，重新关联之后再次检查
+         * @param graph : 依赖关系图，决定模块定义检查的先后顺序
          */
-        bool validateDefinitionSemantics();
+        bool validateDefinitionSemantics( const DependencyGraph& graph );
 
         /**
          * @method validateImpelementationSemantics : 检验实现语义
          * @desc :
          *  检验实现语义的正确性，过程中可能会产生新的语法结构
+         *  已经检查过的实现，若其所搜索过的模块接口都没有改变，则复用上次的检查结论
          */
         bool validateImplementationSemantics();
 
+        /**
+         * @method getInterface : 获取接口指纹
+         * @desc : 模块的定义检查完成后有效，未检查过的模块返回空串 */
+        const string& getInterface( $signature sig );
+
+        /**
+         * @method collectStaleModules : 收集陈旧模块
+         * @desc : 取出上次定义检查登记的陈旧模块，登记随之清空 */
+        signatures collectStaleModules();
+
     private:
+        /**
+         * @method reusable : 检查结论是否可以复用 */
+        bool reusable( const record& rec );
+
+        /**
+         * @method seal : 封存检查结论
+         * @desc : 记录所搜索过的模块当前的接口版本 */
+        void seal( record& rec, bool success );
+
+        /**
+         * @method renewInterface : 更新接口指纹
+         * @desc : 重新计算模块的接口指纹，若指纹改变则增加接口版本 */
+        void renewInterface( $module mod );
+
         bool validateModuleDefinition( $module );
         bool validateClassDefinition( $classdef );
         bool validateEnumDefinition( $enumdef );
@@ -252,6 +454,12 @@ class SemanticContext {
          * @desc : 无论成功与否，被传入的语法结构应当已经被语义检查过程处理过 */
         static string GetBinarySymbol( $node );
 
+        /**
+         * @static-method GetSymbolId : 获取二进制符号编号
+         * @desc : 二进制符号被驻留在语法结构所属的语义上下文中，可以使用getSymbol取回
+         * @return int : 符号编号，若语法结构不属于任何模块则返回-1 */
+        static int GetSymbolId( $node );
+
         /**
          * @static-method Reach : 尝试抵达名称表达式
          * @param name : 要查询的名称
@@ -355,6 +563,11 @@ class SemanticContext {
          */
         static bool IsIdentical( $typeexpr a, $typeexpr b, bool u = false );
 
+        /**
+         * @method IsOverriding : 判断方法是否重写了另一个方法
+         * @desc : 两个非元方法名称相同，约束相同，参数原型逐一一致时，派生类中的方法重写了基类中的方法 */
+        static bool IsOverriding( $metdef derived, $metdef base );
+
         /**
          * @method GetInheritTable : 获取继承表
          * @desc :
@@ -408,6 +621,51 @@ class SemanticContext {
         static elements MinimalCall( callable* call, bool order = true );
 
     protected:
+        /**
+         * @static-method WriteInterface : 写入接口指纹
+         * @desc : 写入定义的符号、可见性、类型和内部定义；泛型模板类的内容不被归约，由用例记录负责其变化 */
+        static void WriteInterface( $definition def, string& buf );
+
+        /**
+         * @static-method WriteBinarySymbol : 书写二进制符号
+         * @desc : 将二进制符号追加到缓冲区末尾，子结构的符号直接写入同一缓冲区并顺便被缓冲 */
+        static void WriteBinarySymbol( $node, string& buf );
+
+        /**
+         * @class definition_table : 定义表
+         * @desc :
+         *  用于在一次遍历中检查同一作用域内的重复定义
+         *  同名定义按照名称分桶，方法和未被删除的运算符在桶内再以二进制符号编号分组
+         *  诊断信息的内容和顺序与逐对比较所有先前定义的结果一致
+         */
+        class definition_table {
+            private:
+                struct entry {
+                    int index;
+                    $definition def;
+                };
+                struct bucket {
+                    vector<entry> keyless;
+                    map<int,vector<entry>> kinds;
+                    map<tuple<int,int>,vector<entry>> keyed;
+                };
+                SemanticContext& context;
+                bool operators;
+                int count = 0;
+                unordered_map<string,bucket> buckets;
+            public:
+                /**
+                 * @param context : 语义上下文
+                 * @param operators : 是否按照符号区分未被删除的运算符，类作用域需要，模块作用域不需要 */
+                definition_table( SemanticContext& context, bool operators );
+
+                /**
+                 * @method insert : 插入定义
+                 * @desc : 插入定义并报告它与先前定义的冲突
+                 * @return bool : 若没有冲突则返回true */
+                bool insert( $definition def );
+        };
+
         class searching_layer {
             private:
                 chainz<$scope>* layers;
@@ -9,7 +9,10 @@
 #include "chainz.hpp"
 #include "jsonz.hpp"
 #include "asock.hpp"
+#include "docbuf.hpp"
 #include <memory>
+#include <vector>
+#include <shared_mutex>
 
 namespace alioth {
 class fdistream;
@@ -221,6 +224,7 @@ class SpaceEngine {
         static const string dirdvs;             //路径分隔符，字符串
         static const string default_work_path;  //默认工作路径
         static const string default_root_path;  //默认根路径
+        static const int content_window;        //交互模式下同时在途的内容请求数量上限
 
     private:
         /**
@@ -255,6 +259,24 @@ class SpaceEngine {
         struct Document : public DataSource {
         };
 
+        /**
+         * @struct Buffer : 文档缓冲
+         * @desc :
+         *  交互模式下由UPDATE请求建立的文档缓冲，存在缓冲的文档直接从缓冲读取
+         *  枚举内容时以缓冲的长度和修改时间替代IDE报告的值，使编辑操作能被同步过程察觉
+         */
+        struct Buffer {
+
+            /**
+             * @member text : 文档内容 */
+            DocumentBuffer text;
+
+            /**
+             * @member mtime : 修改时间
+             * @desc : 每次更新都严格递增，同一秒内的多次编辑也能被区分 */
+            time_t mtime = 0;
+        };
+
     private:
 
         /**
@@ -282,6 +304,18 @@ class SpaceEngine {
          * @desc : 用于交互模式的交互套接字 */
         $Socket msock;
 
+        /**
+         * @member mbuffers : 文档缓冲
+         * @desc : 以文档URI为键的文档缓冲 */
+        map<string,Buffer> mbuffers;
+
+        /**
+         * @static-member buffers_lock : 缓冲锁
+         * @desc :
+         *  全交互模式下UPDATE请求由分派线程立即处理，诊断请求在分析线程中读取文档
+         *  读取缓冲时持有共享锁，修改缓冲时持有独占锁 */
+        static std::shared_mutex buffers_lock;
+
         /**
          * @member arch : 架构 */
         string arch;
@@ -397,6 +431,38 @@ class SpaceEngine {
          */
         uistream openDocumentForRead( const srcdesc& desc );
 
+        /**
+         * @method openDocumentsForRead : 批量打开文档以读取
+         * @desc :
+         *  交互模式下，内容请求以流水线方式发出，在等待响应之前继续发出后续请求，
+         *  同时在途的请求数量不超过content_window，批量读取N个文档的开销接近一次往返而非N次
+         *  非交互模式下与逐个打开文档相同
+         * @param descs : 文档的描述符
+         * @return vector<uistream> : 与描述符一一对应的输入流指针，打开失败的文档对应空指针
+         */
+        vector<uistream> openDocumentsForRead( const chainz<srcdesc>& descs );
+
+        /**
+         * @method updateDocument : 更新文档缓冲
+         * @desc :
+         *  将编辑操作依次应用于文档缓冲，文档尚无缓冲时，第一个编辑操作必须整体替换文档内容
+         *  任何一个编辑操作失败时，文档缓冲被丢弃，此后读取文档重新向IDE请求文本内容
+         * @param uri : 文档的URI
+         * @param edits : 编辑操作
+         * @return bool : 所有编辑操作是否都被应用
+         */
+        bool updateDocument( Uri uri, const chainz<protocol::Parameter::Request::Update::edit>& edits );
+
+        /**
+         * @method releaseDocument : 释放文档缓冲
+         * @desc :
+         *  丢弃文档缓冲，此后读取文档重新向IDE请求文本内容，列举目录时报告文件本身的大小和修改时间
+         *  缓冲的修改时间总是晚于第一次更新的时刻，与此前保存的文件不同，下一次同步模块时文档被重新分析
+         * @param uri : 文档的URI
+         * @return bool : 文档是否持有缓冲
+         */
+        bool releaseDocument( Uri uri );
+
         /**
          * @method openDocumentForWrite : 打开文档以写入
          * @desc :
@@ -461,6 +527,19 @@ class SpaceEngine {
          */
         bool enableInteractiveMode( int input, int output );
 
+    private:
+
+        /**
+         * @method overlayBuffers : 覆盖缓冲信息
+         * @desc :
+         *  以文档缓冲的长度和修改时间替代枚举结果中对应文档的值
+         *  直接位于空间中、只存在于缓冲中的新文档被追加到枚举结果中
+         * @param space : 被枚举的空间
+         * @param descs : 枚举结果 */
+        void overlayBuffers( const srcdesc& space, chainz<fulldesc>& descs );
+
+    public:
+
         /**
          * @method OpenStramForRead : 打开流以读取数据
          * @desc :
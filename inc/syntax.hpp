@@ -2,6 +2,9 @@
 #define __syntax__
 
 #include <set>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include "type.hpp"
 #include "token.hpp"
 #include "agent.hpp"
@@ -222,6 +225,15 @@ struct node : public thing {
          */
         virtual Uri getDocUri();
 
+        /**
+         * @method getDocPrefix : 获取文档前缀
+         * @desc :
+         *  获取此语法树节点所在的文档的URI的驻留字符串，用作诊断信息的前缀
+         *  片段挂载时前缀已经驻留，产生诊断信息时不必再构造和转换URI
+         * @return istring : 获取的结果
+         */
+        virtual istring getDocPrefix();
+
         /**
          * @method getFragment : 获取片段
          * @desc :
@@ -482,6 +494,7 @@ struct depdesc : public node {
         json toJson()const;
         static $depdesc fromJson( const json& object, srcdesc space );
         Uri getDocUri() override;
+        istring getDocPrefix() override;
 };
 
 /**
@@ -503,6 +516,11 @@ struct fragment : public node {
          * @desc : 将片段挂载进入编译器上下文时，由上下文负责填写 */
         CompilerContext* context = nullptr;
 
+        /**
+         * @member prefix : 文档前缀
+         * @desc : 源码文档的URI的驻留字符串，将片段挂载进入编译器上下文时，由上下文负责填写 */
+        istring prefix;
+
         /**
          * @member defs : 定义
          * @desc : 源文档中所有的定义 */
@@ -512,6 +530,11 @@ struct fragment : public node {
          * @member impls : 实现
          * @desc : 源文档中的所有实现 */
         implementations impls;
+
+        /**
+         * @member digest : 摘要
+         * @desc : 构造片段所用的记号序列的摘要，由编译器在语法分析后填写，空白的变化不影响摘要 */
+        unsigned __int128 digest = 0;
     public:
 
         virtual ~fragment() = default;
@@ -520,6 +543,7 @@ struct fragment : public node {
         this_is_scope
 
         virtual Uri getDocUri() override;
+        virtual istring getDocPrefix() override;
         virtual $fragment getFragment() override;
         virtual CompilerContext& getCompilerContext() override;
 };
@@ -1576,6 +1600,39 @@ struct mbrexpr : public exprstmt {
         $node clone( $scope scope ) const override;
 };
 
+/**
+ * @struct SyntaxCache : 语法缓存
+ * @desc :
+ *  全交互模式下，记录一个文档上一次分析时的文本、完整的词法序列和各个顶层定义的原型
+ *  文档被编辑后，词法序列只重新扫描受损的区域，构建片段时从词法序列中拷贝记号，跳过可以复用的顶层定义
+ *  原型以产生它的记号序列的摘要为键，摘要包含每个记号的种类、文本和位置
+ *  记号和位置都没有改变的顶层定义直接从原型克隆，不再重新分析
+ *  只有克隆结果与重新分析的结果完全一致的定义才会被记录：不含基类、模板参数、谓词和枚举的类定义以及别名定义
+ *  原型在片段交给语义分析之前克隆，不会被语义分析改写
+ */
+struct SyntaxCache {
+
+    /**
+     * @struct entry : 原型 */
+    struct entry {
+        token phrase;       // 定义的短语，替换定义的记号序列
+        int count;          // 定义的记号个数，不含空白和注释
+        $definition def;    // 定义的原型，不属于任何作用域
+    };
+
+    /**
+     * @member text : 文档的文本 */
+    string text;
+
+    /**
+     * @member source : 文档完整的词法序列
+     * @desc : 包含空白和注释，由LexicalContext::Relex维护 */
+    tokens source;
+
+    /**
+     * @member entries : 原型表 */
+    std::map<uint64_t,entry> entries;
+};
 
 /**
  * @class SyntaxContext : 语法上下文
@@ -1684,6 +1741,39 @@ class SyntaxContext {
          * @desc : 用于记录每个工作流程开始之前状态栈的层数，帮助工作流恢复状态栈*/
         chainz<int> ws;
 
+        /**
+         * @member rest : 待分析的记号
+         * @desc :
+         *  构建片段时，剔除空白后的记号先存放在这里，迭代器前进时才逐个移入源码记号序列
+         *  如此，归约时在序列中移动的只有迭代器之后少量的记号，分析长文档的开销是线性的
+         *  提供了语法缓存时不使用此序列，记号从语法缓存的词法序列中拷贝 */
+        tokens rest;
+
+        /**
+         * @member fed : 已移入的记号数
+         * @desc : 待分析的记号或语法缓存的词法序列中，下一个要移入的记号的位置 */
+        int fed;
+
+        /**
+         * @struct chunk : 顶层结构的记号范围 */
+        struct chunk {
+            int begin;      // 第一个记号在词法序列中的位置
+            int last;       // 最后一个不是空白或注释的记号的位置
+            int end;        // 下一个顶层结构的第一个记号的位置
+            int count;      // 不是空白或注释的记号个数
+            uint64_t key;   // 记号序列的摘要
+        };
+
+        /**
+         * @member chunks : 顶层结构
+         * @desc : 语法缓存的词法序列在深度为零的定义关键字处被切分成的顶层结构 */
+        std::vector<chunk> chunks;
+
+        /**
+         * @member cache : 语法缓存
+         * @desc : 若不为空，记号从其中的词法序列拷贝，构建片段时复用其中的原型，并在构建成功后以本次的顶层定义替换原型表 */
+        SyntaxCache* cache;
+
     public:
         /**
          * @ctor : 构造函数
@@ -1694,8 +1784,9 @@ class SyntaxContext {
          * @param doc : 源文档描述符
          * @param source : token序列引用
          * @param diagnostics : 诊断信息容器
+         * @param cache : 语法缓存，若不为空，构建片段时从其中的词法序列拷贝记号，source应当为空
          */
-        SyntaxContext( srcdesc doc, tokens& source, Diagnostics& diagnostics );
+        SyntaxContext( srcdesc doc, tokens& source, Diagnostics& diagnostics, SyntaxCache* cache = nullptr );
 
         /** 
          * @method extractSignature : 提取模块签名
@@ -1715,6 +1806,35 @@ class SyntaxContext {
          */
         $fragment constructFragment();
     private:
+        /**
+         * @method strip : 剔除空白
+         * @desc : 一次遍历剔除源码中的空白和注释，剩余的记号被移动到新的序列中 */
+        void strip();
+
+        /**
+         * @method split : 切分顶层结构
+         * @desc : 在深度为零的定义关键字处切分语法缓存的词法序列，计算每段记号的摘要 */
+        void split();
+
+        /**
+         * @method reuse : 复用原型
+         * @desc :
+         *  若迭代器指向刚刚移入的某个顶层结构的第一个记号，且语法缓存中有相同记号序列的原型
+         *  则以原型的短语替换这个记号，跳过其余的记号，返回克隆的定义
+         * @param scope : 克隆的定义所在的作用域
+         * @param index : 返回迭代器所在的顶层结构的序号，不在顶层结构开头时不改变
+         * @return $definition : 克隆的定义，不能复用时为空
+         */
+        $definition reuse( $scope scope, int& index );
+
+        /**
+         * @method Reusable : 判断定义能否复用
+         * @desc : 判断定义的克隆结果是否与重新分析的结果完全一致
+         * @param def : 刚刚分析得到的定义
+         * @return bool : 能否复用
+         */
+        static bool Reusable( $definition def );
+
         /**
          * @method movi : 移进方法
          * @desc : 移进c个单词,并进入s状态
@@ -1742,6 +1862,11 @@ class SyntaxContext {
          */
         void stay(int c = 1 );
 
+        /**
+         * @method supply : 供给记号
+         * @desc : 迭代器越过源码记号序列的末尾时，从待分析的记号中移入，或从语法缓存的词法序列中拷贝下一个记号 */
+        void supply();
+
         /**
          * @method redu : 归约方法
          * @desc : 用于将几个状态下的单词全部归约成一个非终结符
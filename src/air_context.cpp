@@ -5,8 +5,12 @@
 #include "diagnostic.hpp"
 #include "semantic.hpp"
 #include "value.hpp"
+#include "profiler.hpp"
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Transforms/Utils/Cloning.h>
 #include <llvm/Support/TargetRegistry.h>
-#include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/TargetSelect.h>
@@ -21,12 +25,105 @@
 #include <llvm/Support/Host.h>
 #include <llvm/IR/Constant.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Transforms/IPO.h>
 #include <llvm/IR/Type.h>
+#include <algorithm>
 
 namespace alioth {
 
+/**
+ * @function CollectMutatedNames : 收集可变名称
+ * @desc :
+ *  收集语句中可能被赋值、自增自减、取地址、绑定为引用或作为参数传递的名称
+ *  传递参数和成员运算可能以引用绑定元素，保守地视为可变，被lambda捕获的名称同样视为可变
+ *  同名的内层元素会使外层元素被视为可变，这只会放弃优化，不会影响正确性
+ */
+static void CollectMutatedNames( $statement n, set<string>& names, bool capture = false ) {
+    auto mark = [&]( auto e ) {
+        if( auto name = ($nameexpr)e; name and !name->next ) names.insert((string)name->name);
+    };
+    auto visit = [&]( auto e, bool c ) {
+        CollectMutatedNames(($statement)e, names, c);
+    };
+    if( !n ) return;
+
+    if( auto s = ($blockstmt)n; s ) {
+        for( auto i : *s ) visit(i, capture);
+    } else if( auto s = ($element)n; s ) {
+        if( s->proto and (s->proto->etype == eprototype::ref or s->proto->etype == eprototype::rel) ) mark(s->init);
+        visit(s->init, capture);
+    } else if( auto s = ($fctrlstmt)n; s ) {
+        visit(s->expr, capture);
+    } else if( auto s = ($branchstmt)n; s ) {
+        visit(s->condition, capture);
+        visit(s->branch_true, capture);
+        visit(s->branch_false, capture);
+    } else if( auto s = ($switchstmt)n; s ) {
+        visit(s->argument, capture);
+        for( auto b : s->branchs ) visit(b, capture);
+        visit(s->defbr, capture);
+    } else if( auto s = ($loopstmt)n; s ) {
+        mark(s->con);
+        visit(s->con, capture);
+        visit(s->key, capture);
+        visit(s->it, capture);
+        visit(s->ctrl, capture);
+        visit(s->body, capture);
+    } else if( auto s = ($assumestmt)n; s ) {
+        mark(s->expr);
+        visit(s->expr, capture);
+        visit(s->variable, capture);
+        visit(s->branch_true, capture);
+        visit(s->branch_false, capture);
+    } else if( auto s = ($dostmt)n; s ) {
+        visit(s->task, capture);
+        visit(s->on, capture);
+        visit(s->then, capture);
+    } else if( auto e = ($nameexpr)n; e ) {
+        if( capture ) mark(e);
+    } else if( auto e = ($monoexpr)n; e ) {
+        switch( e->etype ) {
+            case exprstmt::address: case exprstmt::preinc: case exprstmt::predec:
+            case exprstmt::postinc: case exprstmt::postdec: mark(e->operand); break;
+            default: break;
+        }
+        visit(e->operand, capture);
+    } else if( auto e = ($binexpr)n; e ) {
+        if( e->etype >= exprstmt::assign and e->etype <= exprstmt::bandass ) mark(e->left);
+        visit(e->left, capture);
+        visit(e->right, capture);
+    } else if( auto e = ($callexpr)n; e ) {
+        visit(e->callee, capture);
+        for( auto p : e->params ) mark(p), visit(p, capture);
+    } else if( auto e = ($mbrexpr)n; e ) {
+        mark(e->host);
+        visit(e->host, capture);
+    } else if( auto e = ($aspectexpr)n; e ) {
+        mark(e->host);
+        visit(e->host, capture);
+    } else if( auto e = ($tconvexpr)n; e ) {
+        visit(e->org, capture);
+    } else if( auto e = ($lambdaexpr)n; e ) {
+        visit(e->body, true);
+    } else if( auto e = ($sctorexpr)n; e ) {
+        for( auto i : *e ) visit(i, capture);
+    } else if( auto e = ($lctorexpr)n; e ) {
+        for( auto i : *e ) visit(i, capture);
+    } else if( auto e = ($tctorexpr)n; e ) {
+        for( auto i : *e ) visit(i, capture);
+    } else if( auto e = ($newexpr)n; e ) {
+        visit(e->array, capture);
+        visit(e->init, capture);
+    } else if( auto e = ($delexpr)n; e ) {
+        visit(e->target, capture);
+    } else if( auto e = ($doexpr)n; e ) {
+        visit(e->task, capture);
+    }
+}
+
 AirContext::AirContext( string _arch, string _plat, Diagnostics& diag ):
     diagnostics(diag),arch(_arch),platform(_plat),targetMachine(nullptr) {
         using namespace llvm;
@@ -88,25 +185,25 @@ void AirContext::initInlineStructures() {
         builder.getInt32Ty()                    // 变量类型附加信息
     );
 
-    createGlobalStr("void");
-    createGlobalStr("boolean");
-    createGlobalStr("uint8");
-    createGlobalStr("uint16");
-    createGlobalStr("uint32");
-    createGlobalStr("uint64");
-    createGlobalStr("int8");
-    createGlobalStr("int16");
-    createGlobalStr("int32");
-    createGlobalStr("int64");
-    createGlobalStr("float32");
-    createGlobalStr("float64");
+    createTypeId("void");
+    createTypeId("boolean");
+    createTypeId("uint8");
+    createTypeId("uint16");
+    createTypeId("uint32");
+    createTypeId("uint64");
+    createTypeId("int8");
+    createTypeId("int16");
+    createTypeId("int32");
+    createTypeId("int64");
+    createTypeId("float32");
+    createTypeId("float64");
 }
 
 bool AirContext::operator()( $module semantic ) {
     return translateModule(semantic);
 }
 
-bool AirContext::operator()( $module semantic, ostream& os, bool ir ) {
+bool AirContext::operator()( $module semantic, llvm::raw_pwrite_stream& os, emit_t emit ) {
     auto success = translateModule(semantic);
     string source_names;
     auto cctx = semantic->getCompilerContext();
@@ -119,17 +216,52 @@ bool AirContext::operator()( $module semantic, ostream& os, bool ir ) {
     auto errrso = llvm::raw_string_ostream(error);
     if( llvm::verifyModule(*module, &errrso) )
         errrso.flush(), diagnostics[semantic->sig->name]("81", error), success = false;
-    if( !success and !ir ) return false;
+    if( !success and emit != emit_t::ir ) return false;
+
+    success = generateOutput(module, os, emit) and success;
+    return success;
+}
+
+bool AirContext::operator()( llvm::raw_pwrite_stream& os, emit_t emit ) {
+    return generateOutput(alioth, os, emit);
+}
+bool AirContext::operator()( const modules& mods, llvm::raw_pwrite_stream& os, emit_t emit, bool program ) {
+    bool success = true;
+    auto linked = std::make_shared<llvm::Module>("lto", *this);
+    std::set<std::string> preserve = {"start"};
+
+    for( auto semantic : mods ) {
+        success = translateModule(semantic) and success;
+
+        /** 不构成完整程序时，目标模块定义的符号都是导出的 */
+        if( !program ) for( auto& gv : module->global_values() )
+            if( !gv.isDeclaration() and !gv.hasLocalLinkage() ) preserve.insert(gv.getName().str());
+
+        if( llvm::Linker::linkModules(*linked, llvm::CloneModule(*module)) )
+            diagnostics[semantic->sig->name]("81", "failed to link module " + semantic->sig->name.tx), success = false;
+    }
+    /** 类型标识在全程序范围内必须唯一，不构成完整程序时alioth模块仍然单独产生，不链接进来 */
+    if( program and llvm::Linker::linkModules(*linked, llvm::CloneModule(*alioth)) )
+        diagnostics["llvm"]("81", "failed to link module alioth"), success = false;
+
+    string error;
+    auto errrso = llvm::raw_string_ostream(error);
+    if( llvm::verifyModule(*linked, &errrso) )
+        errrso.flush(), diagnostics["llvm"]("81", error), success = false;
+    if( !success and emit != emit_t::ir ) return false;
 
-    success = generateOutput(module, os, ir) and success;
+    /** 校验失败的模块不能被优化，仍然输出未经优化的中间代码以便排查 */
+    if( success ) optimizeModule(*linked, preserve);
+    success = generateOutput(linked, os, emit) and success;
     return success;
 }
 
-bool AirContext::operator()( ostream& os, bool ir ) {
-    return generateOutput(alioth, os, ir);
+void AirContext::setLayout( layout_t strategy ) {
+    layout = strategy;
 }
 
 bool AirContext::translateModule( $module semantics ) {
+    auto timing = Profiler::scope("translation");
     module = std::make_shared<llvm::Module>((string)semantics->sig->name, *this);
 
     bool success = translateClassDefinition(semantics->trans);
@@ -169,21 +301,44 @@ bool AirContext::translateClassDefinition( $classdef def ) {
         return success;
     }
     auto table = SemanticContext::GetInheritTable(def) << def;
+    auto dl = targetMachine->createDataLayout();
     vector<llvm::Type*> layout_meta;
     vector<llvm::Type*> layout_inst;
-    for( auto layout : table )
-        for( auto def : layout->defs ) if( auto attr = ($attrdef)def; attr) {
-            if( attr->meta ) layout_meta.push_back($t(attr));
-            else layout_inst.push_back($t(attr));
+
+    /** 逐个类排列其自身的属性，基类的排列结果构成前缀
+     *  属性的类型已经经过语义检查，无法产生类型时不再排列，排序时所有类型都不为空
+     *  成员运算尚未被翻译，届时属性的下标应当按照同样的排列求出，而不是按照声明顺序 */
+    auto arrange = [&]( vector<$attrdef>& group, vector<llvm::Type*>& layout_types ) {
+        vector<llvm::Type*> types;
+        for( auto attr : group ) types.push_back($t(attr));
+        if( find(types.begin(), types.end(), nullptr) != types.end() ) return false;
+        vector<size_t> order(group.size());
+        for( size_t i = 0; i < order.size(); i++ ) order[i] = i;
+        if( layout == layout_t::sorted ) stable_sort(order.begin(), order.end(), [&]( size_t a, size_t b ) {
+            return dl.getABITypeAlignment(types[a]) > dl.getABITypeAlignment(types[b]);
+        });
+        for( auto i : order ) layout_types.push_back(types[i]);
+        return true;
+    };
+    for( auto cls : table ) {
+        vector<$attrdef> group_meta;
+        vector<$attrdef> group_inst;
+        for( auto def : cls->defs ) if( auto attr = ($attrdef)def; attr) {
+            if( attr->meta ) group_meta.push_back(attr);
+            else group_inst.push_back(attr);
         }
+        success = arrange(group_meta, layout_meta) and success;
+        success = arrange(group_inst, layout_inst) and success;
+    }
+    if( !success ) return internal_error, false;
 
     /** 产生类型 */
     auto entity_ty = (llvm::StructType*)$et(def);
     auto instance_ty = (llvm::StructType*)$t(def);
 
     /** 填充结构 */
-    entity_ty->setBody(layout_meta);
-    instance_ty->setBody(layout_inst);
+    entity_ty->setBody(layout_meta, layout == layout_t::packed);
+    instance_ty->setBody(layout_inst, layout == layout_t::packed);
 
     auto entity = $e(def);
     entity->setInitializer(llvm::ConstantAggregateZero::get(entity_ty));
@@ -231,12 +386,15 @@ bool AirContext::translateMethodImplementation( $metimpl impl ) {
     auto builder = IRBuilder<>(bb);
     auto attrs = $a(def);
 
-    /** 存储参数以获取地址 */
+    /** 未被修改且未被取地址的标量参数直接作为SSA值使用，其余参数存储在入口块分配的栈空间中 */
+    mutated_names.clear();
+    CollectMutatedNames(($statement)impl->body, mutated_names);
     auto argi = fp->arg_begin();
     if( attrs&metattr::retcm ) {
         $element rt = new element;
         rt->name = token("return");
         element_values[rt] = argi;
+        element_addrs[rt] = none;
         scoped_elements[impl][rt->name] = rt;
         argi++->setName("return");
     }
@@ -253,15 +411,23 @@ bool AirContext::translateMethodImplementation( $metimpl impl ) {
             ), eprototype::ptr, token("const")
         );
         element_values[ts] = argi;
+        element_addrs[ts] = none;
         scoped_elements[impl][ts->name] = ts;
         argi++->setName("this");
     }
     for( auto arg : impl->arguments ) {
         argi->setName((string)arg->name);
+        auto scalar = arg->proto->etype == eprototype::ptr
+            or (arg->proto->etype == eprototype::obj and !arg->proto->dtype->is_type(StructType));
         if( arg->proto->etype == eprototype::obj and arg->proto->dtype->is_type(StructType) ) {
             element_values[arg] = argi;
+            element_addrs[arg] = none;
+        } else if( scalar and !mutated_names.count((string)arg->name) ) {
+            element_values[arg] = argi;
+            element_addrs[arg] = none;
         } else {
-            auto addr = element_values[arg] = builder.CreateAlloca($t(arg->proto));
+            auto addr = element_values[arg] = createEntryAlloca(builder, $t(arg->proto), (string)arg->name);
+            element_addrs[arg] = direct;
             builder.CreateStore(argi,addr);
         }
         scoped_elements[impl][arg->name] = arg;
@@ -312,8 +478,56 @@ bool AirContext::translateBlockStatement( llvm::IRBuilder<>& builder, $blockstmt
 }
 
 bool AirContext::translateElementStatement( llvm::IRBuilder<>& builder, $element stmt ) {
-    not_ready_yet;
-    return false;
+    using namespace llvm;
+    auto proto = SemanticContext::$(stmt->proto);
+    if( !proto ) return false;
+    if( stmt->array.size() or proto->etype == eprototype::ref or proto->etype == eprototype::rel )
+        return not_ready_yet, false;
+
+    $value init;
+    if( stmt->init and !(init = translateExpressionStatement(builder, stmt->init)) ) return false;
+    if( init and !SemanticContext::$(init->proto) ) return false;
+    auto name = (string)stmt->name;
+    scoped_elements[stmt->getScope()][name] = stmt;
+
+    if( proto->dtype->is_type(UnknownType) ) {
+        /** 未被修改的元素只可能持有初始值，初始值的类型确定时，元素以该类型的SSA值存在 */
+        if( init and !mutated_names.count(name) and init->proto->dtype->is_type(BasicTypeMask) ) {
+            auto value = loadValue(builder, init);
+            if( !value ) return false;
+            inferred_protos[stmt] = init->proto;
+            element_values[stmt] = value;
+            element_addrs[stmt] = none;
+            return true;
+        }
+        auto addr = createEntryAlloca(builder, $t(proto), name);
+        element_values[stmt] = addr;
+        element_addrs[stmt] = direct;
+        if( !init ) {
+            builder.CreateStore(Constant::getNullValue($t(proto)), addr);
+            return true;
+        }
+        if( !init->proto->dtype->is_type(UnknownType) ) return boxValue(builder, init, addr);
+
+        /** 立即数直接存储，直接寻址的值先读取再存储 */
+        auto value = loadValue(builder, init);
+        if( !value ) return false;
+        builder.CreateStore(value, addr);
+        return true;
+    }
+
+    if( proto->etype == eprototype::obj and proto->dtype->is_type(StructType) ) return not_ready_yet, false;
+    Value* value = Constant::getNullValue($t(proto));
+    if( init and !(value = castValue(builder, init, proto)) ) return not_ready_yet, false;
+    if( !mutated_names.count(name) ) {
+        element_values[stmt] = value;
+        element_addrs[stmt] = none;
+    } else {
+        auto addr = element_values[stmt] = createEntryAlloca(builder, $t(proto), name);
+        element_addrs[stmt] = direct;
+        builder.CreateStore(value, addr);
+    }
+    return true;
 }
 
 bool AirContext::translateBranchStatement( llvm::IRBuilder<>& builder, $branchstmt stmt ) {
@@ -348,7 +562,9 @@ bool AirContext::translateFlowControlStatement( llvm::IRBuilder<>& builder, $fct
         if( stmt->expr ) {
             auto ex = translateExpressionStatement(builder, stmt->expr);
             if( !ex ) return false;
-            builder.CreateRet(ex->value);
+            auto value = ex->addr == direct ? loadValue(builder, ex) : ex->value;
+            if( !value ) return false;
+            builder.CreateRet(value);
         } else {
             builder.CreateRetVoid();
         }
@@ -404,8 +620,20 @@ $value AirContext::translateMonoExpression( llvm::IRBuilder<>& builder, $monoexp
 }
 
 $value AirContext::translateBinaryExpression( llvm::IRBuilder<>& builder, $binexpr expr ) {
-    not_ready_yet;
-    return nullptr;
+    if( expr->etype != exprstmt::assign ) return not_ready_yet, nullptr;
+
+    /** 赋值的左值必须直接寻址，被赋值的元素已由CollectMutatedNames分配了栈空间 */
+    auto left = translateExpressionStatement(builder, expr->left);
+    if( !left ) return nullptr;
+    auto proto = SemanticContext::$(left->proto);
+    if( !proto ) return nullptr;
+    if( left->addr != direct or !proto->dtype->is_type(BasicTypeMask) ) return not_ready_yet, nullptr;
+    auto right = translateExpressionStatement(builder, expr->right);
+    if( !right ) return nullptr;
+    auto value = castValue(builder, right, proto);
+    if( !value ) return not_ready_yet, nullptr;
+    builder.CreateStore(value, left->value);
+    return left;
 }
 
 $value AirContext::translateCallExpression( llvm::IRBuilder<>& builder, $callexpr expr ) {
@@ -429,6 +657,23 @@ $value AirContext::translateMemberExpression( llvm::IRBuilder<>& builder, $mbrex
 }
 
 $value AirContext::translateNameExpression( llvm::IRBuilder<>& builder, $nameexpr expr ) {
+    if( expr->next or expr->targs.size() ) return not_ready_yet, nullptr;
+
+    /** 由内向外搜索已经翻译的元素，直到方法实现为止 */
+    for( auto scope = expr->getScope(); scope; scope = scope->getScope() ) {
+        if( auto it = scoped_elements.find(scope); it != scoped_elements.end() ) {
+            if( auto jt = it->second.find((string)expr->name); jt != it->second.end() ) {
+                auto e = jt->second;
+                $value value = new value_t;
+                value->addr = element_addrs[e];
+                value->value = element_values[e];
+                value->proto = inferred_protos.count(e) ? inferred_protos[e] : e->proto;
+                return value;
+            }
+        }
+        if( scope->is(node::IMPLEMENTATION) ) break;
+    }
+
     not_ready_yet;
     return nullptr;
 }
@@ -644,6 +889,56 @@ $value AirContext::translateDoExpression( llvm::IRBuilder<>& builder, $doexpr ex
     return nullptr;
 }
 
+llvm::Value* AirContext::loadValue( llvm::IRBuilder<>& builder, $value val ) {
+    if( val->addr == none ) return val->value;
+    if( val->addr != direct ) return not_ready_yet, nullptr;
+    auto proto = SemanticContext::$(val->proto);
+    if( !proto ) return nullptr;
+    return builder.CreateLoad($t(proto), val->value);
+}
+
+llvm::Value* AirContext::castValue( llvm::IRBuilder<>& builder, $value val, $eprototype proto ) {
+    auto value = loadValue(builder, val);
+    auto src = val->proto->dtype;
+    auto dst = $t(proto);
+    if( !value or !dst ) return nullptr;
+    if( value->getType() == dst ) return value;
+    if( src->is_type(IntegerTypeMask) and dst->isIntegerTy() )
+        return builder.CreateIntCast(value, dst, src->is_type(SignedIntegerTypeMask));
+    if( src->is_type(FloatPointTypeMask) and dst->isFloatingPointTy() )
+        return builder.CreateFPCast(value, dst);
+    return nullptr;
+}
+
+bool AirContext::boxValue( llvm::IRBuilder<>& builder, $value val, llvm::Value* dst ) {
+    using namespace llvm;
+    auto dtype = val->proto->dtype;
+    if( !dtype->is_type(BasicTypeMask) or dtype->is_type(VoidType) ) return not_ready_yet, false;
+
+    /** 载荷按照指针宽度的整数存储，浮点数保留其位模式 */
+    auto value = loadValue(builder, val);
+    if( !value ) return false;
+    auto dl = targetMachine->createDataLayout();
+    auto bits = dl.getTypeSizeInBits(value->getType());
+    if( bits > dl.getPointerSizeInBits() ) return not_ready_yet, false;
+    if( value->getType()->isFloatingPointTy() ) value = builder.CreateBitCast(value, builder.getIntNTy(bits));
+    value = dtype->is_type(SignedIntegerTypeMask)
+        ? builder.CreateSExt(value, dl.getIntPtrType(*this))
+        : builder.CreateZExt(value, dl.getIntPtrType(*this));
+
+    auto ty = $t("unknown");
+    builder.CreateStore(builder.CreateIntToPtr(value, builder.getInt8PtrTy()), builder.CreateStructGEP(ty, dst, 0));
+    builder.CreateStore($id(SemanticContext::GetBinarySymbol(($node)dtype)), builder.CreateStructGEP(ty, dst, 1));
+    builder.CreateStore(builder.getInt32(0), builder.CreateStructGEP(ty, dst, 2));
+    return true;
+}
+
+llvm::AllocaInst* AirContext::createEntryAlloca( llvm::IRBuilder<>& builder, llvm::Type* type, const std::string& name ) {
+    auto& entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+    auto eb = llvm::IRBuilder<>(&entry, entry.begin());
+    return eb.CreateAlloca(type, nullptr, name + ".addr");
+}
+
 bool AirContext::generateStartFunction( $metdef met ) {
     using namespace llvm;
     bool success = true;
@@ -656,7 +951,7 @@ bool AirContext::generateStartFunction( $metdef met ) {
     );
     auto fp = module->getFunction(SemanticContext::GetBinarySymbol(($node)met));
     if( !fp ) {
-        diagnostics[met->getDocUri()]("116", met->name);
+        diagnostics[met->getDocPrefix()]("116", met->name);
         return false;
     }
 
@@ -671,30 +966,54 @@ bool AirContext::generateStartFunction( $metdef met ) {
     return success;
 }
 
-bool AirContext::generateOutput( shared_ptr<llvm::Module> mod, ostream& os, bool ir ) {
+void AirContext::optimizeModule( llvm::Module& mod, const std::set<std::string>& preserve ) {
+    using namespace llvm;
+    auto timing = Profiler::scope("emission");
+    mod.setTargetTriple(targetTriple);
+    mod.setDataLayout(targetMachine->createDataLayout());
+
+    legacy::PassManager pass;
+    pass.add(createTargetTransformInfoWrapperPass(targetMachine->getTargetIRAnalysis()));
+    pass.add(createInternalizePass([&]( const GlobalValue& gv ){ return preserve.count(gv.getName().str()) > 0; }));
+    pass.add(createGlobalDCEPass());
+
+    PassManagerBuilder builder;
+    builder.OptLevel = 2;
+    builder.Inliner = createFunctionInliningPass(builder.OptLevel, 0, false);
+    targetMachine->adjustPassManager(builder);
+    builder.populateModulePassManager(pass);
+    pass.run(mod);
+}
+
+bool AirContext::generateOutput( shared_ptr<llvm::Module> mod, llvm::raw_pwrite_stream& os, emit_t emit ) {
     bool success = true;
+    auto timing = Profiler::scope("emission");
     mod->setTargetTriple(targetTriple);
     mod->setDataLayout(targetMachine->createDataLayout());
 
-    auto ros = llvm::raw_os_ostream(os);
-    if( ir ) {
-        mod->print(ros,nullptr);
+    if( emit == emit_t::ir ) {
+        mod->print(os,nullptr);
+    } else if( emit == emit_t::bitcode ) {
+        llvm::WriteBitcodeToFile(*mod, os);
     } else {
         llvm::legacy::PassManager pass;
-        auto rpos = llvm::buffer_ostream(ros);
-        targetMachine->addPassesToEmitFile(pass, rpos, nullptr, llvm::TargetMachine::CGFT_ObjectFile );
+        targetMachine->addPassesToEmitFile(pass, os, nullptr, llvm::TargetMachine::CGFT_ObjectFile );
         pass.run(*mod);
     }
 
-    return true;
+    return success;
 }
 
 llvm::StructType* AirContext::$t( $classdef def ) {
-    return $t("struct."+SemanticContext::GetBinarySymbol(($node)def));
+    auto& ty = lowered_types[{StructType, (classdef*)def}];
+    if( !ty ) ty = $t("struct."+SemanticContext::GetBinarySymbol(($node)def));
+    return ty;
 }
 
 llvm::StructType* AirContext::$et( $classdef def ) {
-    return $t("entity_struct."+SemanticContext::GetBinarySymbol(($node)def));
+    auto& ty = lowered_types[{EntityType, (classdef*)def}];
+    if( !ty ) ty = $t("entity_struct."+SemanticContext::GetBinarySymbol(($node)def));
+    return ty;
 }
 
 llvm::Type* AirContext::$t( $attrdef attr ) {
@@ -743,18 +1062,22 @@ llvm::Type* AirContext::$t( $eprototype proto ) {
 
     if( proto->dtype->is_type(UnknownType) ) return $t(proto->dtype);
     if( proto->etype == eprototype::ref or proto->etype == eprototype::rel ) return $t("reference");
-    else return  $t(proto->dtype);
+    return $t(proto->dtype);
 }
 
 llvm::Type* AirContext::$t( $typeexpr type ) {
     SemanticContext::$(type);
-    auto builder = llvm::IRBuilder<>(*this);
 
     switch( type->id ) {
         case UnknownType: {
             return $t("unknown");
         } break;
-        case StructType: case EntityType: {
+        case StructType: {
+            if( auto def = ($classdef)type->sub; def ) return $t(def);
+            return $t(SemanticContext::GetBinarySymbol(($node)type));
+        } break;
+        case EntityType: {
+            if( auto def = ($classdef)type->sub; def ) return $et(def);
             return $t(SemanticContext::GetBinarySymbol(($node)type));
         } break;
         case CallableType: {
@@ -771,34 +1094,34 @@ llvm::Type* AirContext::$t( $typeexpr type ) {
             return $t(($typeexpr)type->sub)->getPointerTo();
         } break;
         case NullPointerType: {
-            return builder.getVoidTy()->getPointerTo();
+            return llvm::Type::getVoidTy(*this)->getPointerTo();
         } break;
         case VoidType: {
-            return builder.getVoidTy();
+            return llvm::Type::getVoidTy(*this);
         } break;
         case BooleanType: {
-            return builder.getInt1Ty();
+            return llvm::Type::getInt1Ty(*this);
         } break;
         case Int8Type: case Uint8Type: {
-            return builder.getInt8Ty();
+            return llvm::Type::getInt8Ty(*this);
         } break;
         case Int16Type: case Uint16Type: {
-            return builder.getInt16Ty();
+            return llvm::Type::getInt16Ty(*this);
         } break;
         case Int32Type: case Uint32Type: {
-            return builder.getInt32Ty();
+            return llvm::Type::getInt32Ty(*this);
         } break;
         case Int64Type: case Uint64Type: {
-            return builder.getInt64Ty();
+            return llvm::Type::getInt64Ty(*this);
         } break;
         case Float32Type: {
-            return builder.getFloatTy();
+            return llvm::Type::getFloatTy(*this);
         } break;
         case Float64Type: {
-            return builder.getDoubleTy();
+            return llvm::Type::getDoubleTy(*this);
         } break;
         case EnumType: {
-            return builder.getInt32Ty();
+            return llvm::Type::getInt32Ty(*this);
         } break;
     }
     return nullptr;
@@ -838,19 +1161,20 @@ $implementation AirContext::$impl( $statement stmt ) {
     return ($implementation)n;
 }
 
-llvm::GlobalVariable* AirContext::createGlobalStr( const string& str ) {
+llvm::GlobalVariable* AirContext::createTypeId( const string& name ) {
     using namespace llvm;
+    if( auto gv = alioth->getNamedGlobal(name); gv ) return gv;
 
-    auto builder = IRBuilder<>(*this);
-
-    vector<Constant*> init;
-    for( auto c : str ) init.push_back(builder.getInt8(c));
-    init.push_back(builder.getInt8(0));
-
-    auto ai8 = ArrayType::get(builder.getInt8Ty(), str.length()+1);
-    auto arr = ConstantArray::get(ai8, init);
+    auto init = ConstantDataArray::getString(*this, name);
+    return new GlobalVariable(*alioth, init->getType(), true, GlobalValue::ExternalLinkage, init, name);
+}
 
-    return new GlobalVariable(*alioth, ai8, true, GlobalValue::ExternalLinkage, arr, str);
+llvm::Constant* AirContext::$id( const string& name ) {
+    using namespace llvm;
+    auto ty = ArrayType::get(Type::getInt8Ty(*this), name.size()+1);
+    auto gv = module->getOrInsertGlobal(name, ty);
+    if( auto var = dyn_cast<GlobalVariable>(gv); var ) var->setConstant(true);
+    return ConstantExpr::getBitCast(gv, Type::getInt8PtrTy(*this));
 }
 
 }
@@ -4,6 +4,9 @@
 #include "asock.hpp"
 #include "space.hpp"
 #include <iostream>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
 
 namespace alioth {
 
@@ -12,6 +15,9 @@ map<Uri,Socket::$InputStream> Socket::istreams;
 map<Uri,Socket::$OutputStream> Socket::ostreams;
 mutex Socket::seq_lock;
 long Socket::global_seq = 0;
+protocol::Framing Socket::framing = protocol::TEXT;
+const char Socket::frame_magic = (char)0xA1;
+const size_t Socket::frame_limit = 64 << 20;
 
 Socket::Socket() {}
 Socket::Socket( Socket&& an ):
@@ -19,6 +25,10 @@ in(an.in),out(an.out) {
 
 }
 
+void Socket::SetFraming( protocol::Framing f ) {
+    framing = f;
+}
+
 bool Socket::ActivateInputStream( const Uri& uri ) {
     using namespace protocol;
     if( in ) return false;
@@ -58,6 +68,16 @@ void Socket::respondDiagnostics( long seq, const json& diagnostics ) {
     return sendRespond(seq, DIAGNOSTICS, pack);
 }
 
+void Socket::respondPartialDiagnostics( long seq, const json& diagnostics, const string& phase ) {
+    using namespace protocol;
+    json pack = json::object;
+    pack["diagnostics"] = diagnostics;
+    pack["status"] = (long)SUCCESS;
+    pack["partial"] = true;
+    pack["phase"] = phase;
+    return sendRespond(seq, DIAGNOSTICS, pack);
+}
+
 void Socket::respondSuccess( long seq, protocol::Title title ) {
     using namespace protocol;
     json pack = json::object;
@@ -72,6 +92,13 @@ void Socket::respondFailure( long seq, protocol::Title title ) {
     return sendRespond(seq, title, pack);
 }
 
+void Socket::respondCancellation( long seq, protocol::Title title ) {
+    using namespace protocol;
+    json pack = json::object;
+    pack["status"] = (long)CANCELED;
+    return sendRespond(seq, title, pack);
+}
+
 void Socket::reportException( const string& msg ) {
     using namespace protocol;
     json pack = json::object;
@@ -93,7 +120,7 @@ protocol::$Package Socket::receiveRespond( long seq ) {
             it = in->transactions.find(seq);
         }
         // it->second->cv.wait_for(guard, chrono::seconds{1});
-        it->second->cv.wait(guard);
+        it->second->cv.wait(guard, [&]{ return !in->is or in->responds.count(seq); });
         i = in->responds.find(seq);
     }
 
@@ -145,6 +172,7 @@ Socket::$OutputStream Socket::GetOutputStream( const Uri& uri ) {
     if( !os ) return nullptr;
 
     s = new OutputStream(std::move(os));
+    if( uri.scheme == "fd" ) s->fd = stoi(uri.host);
 
     return s;
 }
@@ -153,14 +181,16 @@ void Socket::GuardInputStream( $InputStream s ) {
     using namespace protocol;
     
     while( true ) try {
-        if( s->is->peek() == EOF ){
+        /** 跳过包之间的空白，使文本包和二进制帧可以在同一个流中交替出现 */
+        while( isspace(s->is->peek()) ) s->is->get();
+        if( auto head = s->is->peek(); head == EOF ){
             s->is = nullptr;
             s->cvreq.notify_all();
             for( auto& [_,t] : s->transactions )
                 t->cv.notify_all();
             break;
         } else {
-            auto recv = json::FromJsonStream(*s->is);
+            auto recv = head == (uint8_t)frame_magic ? ReceiveFrame(s) : json::FromJsonStream(*s->is);
             auto pack = ExtractPackage(recv);
             if( pack ) {
                 lock_guard guard(*s);
@@ -182,6 +212,23 @@ void Socket::GuardInputStream( $InputStream s ) {
     catch( exception& e ) {/*nothing to be done*/}
 }
 
+json Socket::ReceiveFrame( $InputStream s ) {
+    char head[5];
+    if( !s->is->read(head, sizeof(head)) )
+        throw runtime_error("Socket::ReceiveFrame( $InputStream s ): incomplete frame header");
+    size_t size = 0;
+    for( int i = 1; i < 5; i++ ) size = size << 8 | (uint8_t)head[i];
+    if( size > frame_limit ) {
+        s->is->ignore(size);
+        throw runtime_error("Socket::ReceiveFrame( $InputStream s ): frame exceeds the size limit");
+    }
+    if( s->frame.size() < size ) s->frame.resize(size);
+    if( !s->is->read(s->frame.data(), size) )
+        throw runtime_error("Socket::ReceiveFrame( $InputStream s ): incomplete frame payload");
+    const char* begin = s->frame.data();
+    return json::FromMsgPack(begin, begin + size);
+}
+
 protocol::$Package Socket::ExtractPackage( const json& data ) {
     using namespace protocol;
     if( !data.is(json::object) ) return nullptr;
@@ -202,6 +249,10 @@ protocol::$Package Socket::ExtractPackage( const json& data ) {
         package->title = DIAGNOSTICS;
     } else if( title == TitleStr(WORKSPACE) ) {
         package->title = WORKSPACE;
+    } else if( title == TitleStr(UPDATE) ) {
+        package->title = UPDATE;
+    } else if( title == TitleStr(CANCEL) ) {
+        package->title = CANCEL;
     } else if( title == TitleStr(EXIT) ) {
         package->title = EXIT;
     } else if( title == TitleStr(NOMORE) ) {
@@ -238,6 +289,7 @@ protocol::$Package Socket::ExtractRequestPackage( const json& data, protocol::$P
                 if( !target.is(json::string) ) continue;
                 params->targets << (string)target;
             }
+            if( data.count("stream", json::boolean) ) params->stream = (bool)data["stream"];
         } break;
         case WORKSPACE: {
             ex->params = new Parameter::Request::Workspace;
@@ -247,6 +299,33 @@ protocol::$Package Socket::ExtractRequestPackage( const json& data, protocol::$P
 
             params->uri = data["uri"];
         } break;
+        case UPDATE: {
+            ex->params = new Parameter::Request::Update;
+            auto params = ex->update();
+
+            if( !data.count("uri", json::string) ) return nullptr;
+            if( data.count("close", json::boolean) ) params->close = (bool)data["close"];
+            if( !data.count("edits", json::array) and !params->close ) return nullptr;
+
+            params->uri = data["uri"];
+            if( data.count("edits", json::array) ) for( const auto& item : data["edits"] ) {
+                if( !item.is(json::object) ) return nullptr;
+                auto& edit = params->edits.construct(-1);
+                if( item.count("offset", json::integer) ) edit.offset = (long)item["offset"];
+                if( item.count("line", json::integer) ) edit.line = (long)item["line"];
+                if( item.count("column", json::integer) ) edit.column = (long)item["column"];
+                if( item.count("length", json::integer) ) edit.length = (long)item["length"];
+                if( item.count("text", json::string) ) edit.text = (string)item["text"];
+            }
+        } break;
+        case CANCEL: {
+            ex->params = new Parameter::Request::Cancel;
+            auto params = ex->cancel();
+
+            if( !data.count("target", json::integer) ) return nullptr;
+
+            params->target = (long)data["target"];
+        } break;
         case EXIT: {
 
         } break;
@@ -325,12 +404,37 @@ void Socket::sendRespond( long seq, protocol::Title title, json& pack ) {
 void Socket::sendPackage( json& pack ) {
     if( !out ) throw logic_error("Socket::requestContent(...): please initial output stream first");
     pack["timestamp"] = time(nullptr);
-    out->lock();
-    auto data = pack.toJsonString();
-    *out->os << data << endl;
+    if( framing == protocol::TEXT ) {
+        auto data = pack.toJsonString();
+        lock_guard guard(*out);
+        *out->os << data << endl;
+        out->os->flush();
+        return;
+    }
+
+    string payload;
+    pack.toMsgPack(payload);
+    char head[5] = {frame_magic};
+    for( int i = 1; i < 5; i++ ) head[i] = (char)(payload.size() >> (4-i)*8);
+
+    lock_guard guard(*out);
+    if( out->fd < 0 ) {
+        out->os->write(head, sizeof(head));
+        out->os->write(payload.data(), payload.size());
+        out->os->flush();
+        return;
+    }
+
+    /** 帧头和载荷以一次系统调用写出，部分写入时从中断处继续 */
     out->os->flush();
-    // this_thread::sleep_for(std::chrono::microseconds{4});
-    out->unlock();
+    iovec iov[2] = {{head, sizeof(head)}, {payload.data(), payload.size()}};
+    for( int i = 0; i < 2; ) {
+        auto n = writev(out->fd, iov + i, 2 - i);
+        if( n < 0 and errno == EINTR ) continue;
+        if( n < 0 ) throw runtime_error("Socket::sendPackage( json& pack ): failed to write frame");
+        for( ; i < 2 and (size_t)n >= iov[i].iov_len; i++ ) n -= iov[i].iov_len;
+        if( i < 2 ) iov[i].iov_base = (char*)iov[i].iov_base + n, iov[i].iov_len -= n;
+    }
     return;
 }
 
@@ -340,6 +444,8 @@ string protocol::TitleStr( Title title ) {
         case CONTENTS: return "contents";
         case WORKSPACE: return "workspace";
         case DIAGNOSTICS: return "diagnostics";
+        case UPDATE: return "update";
+        case CANCEL: return "cancel";
         case EXIT: return "exit";
         case EXCEPTION: return "exception";
         case NOMORE: return "nomore";
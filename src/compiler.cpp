@@ -10,35 +10,77 @@
 #include "air.hpp"
 #include <iostream>
 #include <regex>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace alioth {
 using namespace std;
 
+/** 使用128位的FNV-1a算法累积摘要，结果与平台和标准库实现无关
+ *  摘要作为共享缓存的键在工作空间之间复用，64位的摘要不足以排除碰撞 */
+static unsigned __int128 Digest( const string& data, unsigned __int128 seed = (unsigned __int128)0x6c62272e07bb0142ull << 64 | 0x62b821756295c58dull ) {
+    const auto prime = (unsigned __int128)1 << 88 | 0x13b;
+    for( unsigned char c : data ) {
+        seed ^= c;
+        seed *= prime;
+    }
+    return seed;
+}
+
+/** 以十六进制表示摘要 */
+static string Hex( unsigned __int128 digest ) {
+    char buf[33];
+    snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)(digest >> 64), (unsigned long long)digest);
+    return buf;
+}
+
 AbstractCompiler::~AbstractCompiler() {
-    if( diagnostics.size() ) {
-        uostream os = nullptr;
-        if( diagnosticDestination.fd >= 0 ) os = SpaceEngine::OpenStreamForWrite(diagnosticDestination.fd);
-        else os = SpaceEngine::OpenStreamForWrite(diagnosticDestination.uri);
+    flushDiagnostics();
+    if( diagnosticStream and diagnosticMethod == JSON ) *diagnosticStream << ']' << flush;
+
+    if( spaceEngine ) delete spaceEngine;
+    if( diagnosticEngine ) delete diagnosticEngine;
+}
+
+void AbstractCompiler::flushDiagnostics() {
+    if( written >= diagnostics.size() or !diagnosticEngine ) return;
+    if( !diagnosticStream ) {
+        if( diagnosticDestination.fd >= 0 ) diagnosticStream = SpaceEngine::OpenStreamForWrite(diagnosticDestination.fd);
+        else diagnosticStream = SpaceEngine::OpenStreamForWrite(diagnosticDestination.uri);
+        if( !diagnosticStream ) return;
+        if( diagnosticMethod == JSON ) *diagnosticStream << '[';
+    }
+
+    for( ; written < diagnostics.size(); written++ ) {
+        diagnosticBuffer.clear();
         switch( diagnosticMethod ) {
             case STRING:
-                for( auto diagnostic : diagnosticEngine->printToString(diagnostics) )
-                    *os << diagnostic << endl;
+                diagnosticEngine->printToString(diagnostics[written], diagnosticBuffer);
+                diagnosticBuffer += '\n';
                 break;
             case JSON:
-                *os << diagnosticEngine->printToJson(diagnostics).toJsonString();
+                if( written > 0 ) diagnosticBuffer += ',';
+                diagnosticEngine->printToJson(diagnostics[written]).toJsonString(diagnosticBuffer);
+                break;
+            case JSONL:
+                diagnosticEngine->printToJson(diagnostics[written]).toJsonString(diagnosticBuffer);
+                diagnosticBuffer += '\n';
                 break;
         }
+        diagnosticStream->write(diagnosticBuffer.data(), diagnosticBuffer.size());
+        diagnosticStream->flush();
     }
-
-    if( spaceEngine ) delete spaceEngine;
-    if( diagnosticEngine ) delete diagnosticEngine;
 }
+
 AbstractCompiler::AbstractCompiler( AbstractCompiler&& compiler ):
 spaceEngine(compiler.spaceEngine),
 diagnosticEngine(compiler.diagnosticEngine),
 diagnosticMethod(compiler.diagnosticMethod),
 diagnosticDestination(compiler.diagnosticDestination),
-diagnostics(move(diagnostics)) {
+diagnostics(move(diagnostics)),
+diagnosticStream(move(compiler.diagnosticStream)),
+written(compiler.written) {
     compiler.spaceEngine = nullptr;
     compiler.diagnosticEngine = nullptr;
 }
@@ -48,6 +90,8 @@ bool AbstractCompiler::configureDiagnosticMethod( const string& m ) {
         diagnosticMethod = STRING;
     } else if( m == "json" ) {
         diagnosticMethod = JSON;
+    } else if( m == "jsonl" ) {
+        diagnosticMethod = JSONL;
     } else {
         diagnostics["command-line"]("11",m);
         return false;
@@ -158,11 +202,16 @@ int BasicCompiler::execute() {
     diagnostics[spaceEngine->getUri(diagnostic_desc)];
     if( auto file = spaceEngine->openDocumentForRead(diagnostic_desc); file and !root_remapping_failed ) {
         try {
-            auto config = json::FromJsonStream(*file);
-            if( !diagnosticEngine->configure(config) ) {
-                diagnostics("1");
-                success = false;
-                diagnostic_engine_failed = true;
+            /** 预编译的诊断目录记录的修改时间和尺寸与配置文件一致时直接映射目录，配置文件被修改过时才解析Json */
+            auto stamp = spaceEngine->getUri(diagnostic_desc).scheme == "file" ? spaceEngine->statDataSource(diagnostic_desc) : fulldesc();
+            auto catalog_path = spaceEngine->getPath({flags: DOCUMENT | ROOT | DOC, name: "diagnostic.cat"});
+            if( !stamp or !diagnosticEngine->loadCatalog(catalog_path, stamp.mtime, stamp.size) ) {
+                auto config = json::FromJsonStream(*file);
+                if( !diagnosticEngine->configure(config) ) {
+                    diagnostics("1");
+                    success = false;
+                    diagnostic_engine_failed = true;
+                }
             }
         } catch( exception& e ) {
             diagnostics("1");
@@ -240,6 +289,9 @@ int BasicCompiler::execute() {
             } else {
                 return init(args[i]);
             }
+        } else if( arg == "--catalog" ) {
+            args.remove(i);
+            return catalog();
         } else if( arg == ":" or arg == "x:" or arg == "s:" or arg == "d:" or arg == "v:" or arg == "i:" ) {
             target_found = true;
             if( args.remove(i); i >= args.size() ) {
@@ -329,16 +381,49 @@ int BasicCompiler::init( const string& package ) {
     return correct?0:1;
 }
 
+int BasicCompiler::catalog() {
+    auto diagnostic_desc = (srcdesc){
+        flags: DOCUMENT | ROOT | DOC,
+        name: "diagnostic.json" };
+    diagnostics[spaceEngine->getUri(diagnostic_desc)];
+    auto file = spaceEngine->openDocumentForRead(diagnostic_desc);
+    if( !file ) {
+        diagnostics("0");
+        return 1;
+    }
+
+    /** 使用独立的诊断引擎，命令行中与诊断引擎有关的选项不会被编入目录 */
+    DiagnosticEngine engine;
+    fulldesc stamp;
+    try {
+        stamp = spaceEngine->statDataSource(diagnostic_desc);
+        if( !stamp or !engine.configure(json::FromJsonStream(*file)) ) {
+            diagnostics("1");
+            return 1;
+        }
+    } catch( exception& e ) {
+        diagnostics("1");
+        return 1;
+    }
+
+    auto path = spaceEngine->getPath({flags: DOCUMENT | ROOT | DOC, name: "diagnostic.cat"});
+    if( !engine.saveCatalog(path, stamp.mtime, stamp.size) ) {
+        diagnostics("126", path);
+        return 1;
+    }
+    return 0;
+}
+
 BasicCompiler::~BasicCompiler() {
 }
 
 AliothCompiler::AliothCompiler( AbstractCompiler& basic, CompilingTarget compilingTarget ):
 AbstractCompiler(move(basic)),target(compilingTarget),context(*spaceEngine,diagnostics),semantic(context,diagnostics) {
-
+    semantic.setProfiler(&profiler);
 }
 
 AliothCompiler::~AliothCompiler() {
-
+    reportTime();
 }
 
 int AliothCompiler::execute() {
@@ -365,14 +450,139 @@ int AliothCompiler::execute() {
                 }
                 target.modules.remove(i--);
             }
+        } else if( arg == "--cache-dir" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else {
+                cache_dir = target.modules[i];
+                target.modules.remove(i--);
+            }
+        } else if( arg == "--cache-size" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( !regex_match( target.modules[i], regex(R"(\d+)") ) ) {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            } else {
+                cache_capacity = stoull(target.modules[i]) << 20;
+                target.modules.remove(i--);
+            }
+        } else if( arg == "--layout" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( target.modules[i] == "declared" ) {
+                layout = layout_t::declared;
+            } else if( target.modules[i] == "sorted" ) {
+                layout = layout_t::sorted;
+            } else if( target.modules[i] == "packed" ) {
+                layout = layout_t::packed;
+            } else {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            target.modules.remove(i--);
+        } else if( arg == "--time-report" ) {
+            time_report = true;
+            target.modules.remove(i--);
+        } else if( arg == "--time-report-method" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( target.modules[i] == "table" ) {
+                time_report_json = false;
+            } else if( target.modules[i] == "json" ) {
+                time_report_json = true;
+            } else {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            time_report = true;
+            target.modules.remove(i--);
+        } else if( arg == "--time-report-to" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( regex_match( target.modules[i], regex(R"(\d+)") ) ) {
+                time_report_to.fd = stoi(target.modules[i]);
+            } else try {
+                time_report_to.uri = Uri::FromString(target.modules[i]);
+                time_report_to.fd = -1;
+            } catch( exception& e ) {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            time_report = true;
+            target.modules.remove(i--);
+        } else if( arg == "--trace" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( regex_match( target.modules[i], regex(R"(\d+)") ) ) {
+                trace_to.fd = stoi(target.modules[i]);
+            } else try {
+                trace_to.uri = Uri::FromString(target.modules[i]);
+                trace_to.fd = -1;
+            } catch( exception& e ) {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            trace = true;
+            target.modules.remove(i--);
+        } else if( arg == "--lto" ) {
+            lto = true;
+            target.modules.remove(i--);
+        } else if( arg == "--emit" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( target.modules[i] == "obj" ) {
+                emit = emit_t::object;
+            } else if( target.modules[i] == "bc" ) {
+                emit = emit_t::bitcode;
+            } else {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            target.modules.remove(i--);
+        } else if( arg == "--framing" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( target.modules[i] == "text" ) {
+                Socket::SetFraming(protocol::TEXT);
+            } else if( target.modules[i] == "binary" ) {
+                Socket::SetFraming(protocol::BINARY);
+            } else {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            }
+            target.modules.remove(i--);
+        } else if( arg == "--jobs" ) {
+            if( target.modules.remove(i); i >= target.modules.size() ) {
+                diagnostics["command-line"]("2",arg);
+                return 1;
+            } else if( !regex_match( target.modules[i], regex(R"(\d+)") ) ) {
+                diagnostics["command-line"]("122",arg,target.modules[i]);
+                return 1;
+            } else {
+                semantic.setConcurrency( stoi(target.modules[i]) );
+                target.modules.remove(i--);
+            }
         }
     }if( !success ) return diagnostics("48"), 1;
 
+    if( time_report ) profiler.enable();
+    if( trace ) profiler.enableTracing();
     if( full_interactive ) return execute_full_interactive();
     
-    context.loadModules({flags:WORK});
+    if( auto timing = profiler.measure("load"); true ) context.loadModules({flags:WORK});
     if( !detectInvolvedModules() ) return 2;
+    flushDiagnostics();
     if( !performSyntaticAnalysis() ) return 3;
+    flushDiagnostics();
     if( !performSemanticAnalysis() ) return 4;
     if( target.indicator == Target::VALIDATE ) return 0;
     else if( target.indicator == Target::LLVMIR) {
@@ -387,34 +597,58 @@ int AliothCompiler::execute() {
 int AliothCompiler::execute_full_interactive() {
     using namespace protocol;
     context.loadModules({flags:WORK});
+    auto analyzer = thread([this]{ serve(); });
     while( true ) try {
-        diagnostics.clear();
         auto package = msock.receiveRequest();
         auto request = package->request();
         switch( package->title ) {
-            case DIAGNOSTICS: {
-                auto params = request->diagnostics();
-                target.modules = params->targets;
+            case UPDATE: {
+                auto params = request->update();
+
+                /** 只更新缓冲，下一次诊断请求同步模块时，被编辑的文档因修改时间变化而被重新分析
+                 *  释放缓冲的请求可以不携带编辑操作，释放之后文档回到IDE或文件中的内容 */
+                auto uri = Uri::FromString(params->uri);
                 bool success = true;
-                
-                success = success and detectInvolvedModules();
-                success = success and performSyntaticAnalysis();
-                success = success and performSemanticAnalysis(true);
-                
-                auto info = diagnosticEngine->printToJson(diagnostics);
-                msock.respondDiagnostics(package->seq, info);
+                if( params->edits.size() or !params->close ) success = spaceEngine->updateDocument(uri, params->edits);
+                if( params->close ) spaceEngine->releaseDocument(uri);
+                {
+                    lock_guard guard(jobs_lock);
+                    revision += 1;
+                }
+                if( success )
+                    msock.respondSuccess(package->seq, UPDATE);
+                else
+                    msock.respondFailure(package->seq, UPDATE);
+            } break;
+            case CANCEL: {
+                /** 被取消的请求在下一个检查点处停止，尚未开始的请求不再执行，已经结束或者从未收到的请求被忽略 */
+                auto target = request->cancel()->target;
+                lock_guard guard(jobs_lock);
+                if( pending(target) ) cancellations.insert(target);
+            } break;
+            case DIAGNOSTICS: {
+                /** 目标相同的请求共享一次分析，不再排队 */
+                lock_guard guard(jobs_lock);
+                if( auto leader = companion(package); leader ) {
+                    followers[leader->seq] << package;
+                } else {
+                    jobs << package;
+                    jobs_cv.notify_one();
+                }
             } break;
             case WORKSPACE: {
-                auto params = request->workspace();
-
-                spaceEngine->setMainSpaceMapping(WORK,params->uri);
-                semantic.releaseModules(context.getModules({flags:WORK}));
-                context.clearSpace({flags:WORK});
-                context.loadModules({flags:WORK});
-
-                msock.respondSuccess(package->seq, WORKSPACE);
+                lock_guard guard(jobs_lock);
+                revision += 1;
+                jobs << package;
+                jobs_cv.notify_one();
             } break;
             case EXIT: case NOMORE: {
+                {
+                    lock_guard guard(jobs_lock);
+                    jobs << package;
+                    jobs_cv.notify_one();
+                }
+                analyzer.join();
                 return 0;
             }
             default: break;
@@ -426,6 +660,78 @@ int AliothCompiler::execute_full_interactive() {
     return 0;
 }
 
+void AliothCompiler::serve() {
+    using namespace protocol;
+    while( true ) {
+        $Package package;
+        {
+            unique_lock guard(jobs_lock);
+            jobs_cv.wait(guard, [this]{ return jobs.size() > 0; });
+            package = jobs[0];
+            jobs.remove(0);
+            if( package->title == DIAGNOSTICS ) {
+                serving = package;
+                serving_revision = revision;
+                canceled = false;
+            }
+        }
+        try {
+            auto request = package->request();
+            diagnostics.clear();
+            switch( package->title ) {
+                case DIAGNOSTICS: {
+                    auto params = request->diagnostics();
+                    target.modules = params->targets;
+                    streamed = 0;
+                    bool success = !superseded(package);
+                
+                    success = success and detectInvolvedModules() and !checkpoint("detect");
+                    success = success and performSyntaticAnalysis() and !checkpoint("syntax");
+                    success = success and performSemanticAnalysis(true);
+
+                    /** 结束执行之后不再接受跟随者，逐个取消的跟随者单独以CANCELED响应 */
+                    chainz<long> answered, dropped;
+                    {
+                        lock_guard guard(jobs_lock);
+                        for( auto& sub : subscribers(package) )
+                            (cancellations.erase(sub->seq) or canceled ? dropped : answered) << sub->seq;
+                        followers.erase(package->seq);
+                        serving = nullptr;
+                    }
+
+                    if( answered.size() ) {
+                        auto info = diagnosticEngine->printToJson(diagnostics);
+                        for( auto seq : answered ) msock.respondDiagnostics(seq, info);
+                    }
+                    for( auto seq : dropped ) msock.respondCancellation(seq, DIAGNOSTICS);
+                } break;
+                case WORKSPACE: {
+                    auto params = request->workspace();
+
+                    spaceEngine->setMainSpaceMapping(WORK,params->uri);
+                    semantic.releaseModules(context.getModules({flags:WORK}));
+                    context.clearSpace({flags:WORK});
+                    context.loadModules({flags:WORK});
+
+                    msock.respondSuccess(package->seq, WORKSPACE);
+                } break;
+                case EXIT: case NOMORE: {
+                    return;
+                }
+                default: break;
+            }
+        } catch( exception& e ) {
+            msock.reportException(e.what());
+        }
+
+        /** 请求结束或者抛出异常后，其取消记录和跟随者都不再有用 */
+        lock_guard guard(jobs_lock);
+        for( auto& sub : subscribers(package) ) cancellations.erase(sub->seq);
+        followers.erase(package->seq);
+        serving = nullptr;
+    }
+}
+
 bool AliothCompiler::enableFullInteractiveMode( int input, int output ) {
     if( full_interactive ) return true;
     auto i = msock.ActivateInputStream({scheme:"fd",host:to_string(input),port:0});
@@ -436,10 +742,81 @@ bool AliothCompiler::enableFullInteractiveMode( int input, int output ) {
     return i and o and s;
 }
 
+bool AliothCompiler::checkpoint( const string& phase ) {
+    using namespace protocol;
+    if( !full_interactive ) flushDiagnostics();
+    if( !serving ) return false;
+    if( canceled ) return true;
+
+    Packages streaming;
+    {
+        lock_guard guard(jobs_lock);
+        for( auto& sub : subscribers(serving) )
+            if( sub->request()->diagnostics()->stream and !cancellations.count(sub->seq) ) streaming << sub;
+    }
+    if( diagnostics.size() > streamed ) {
+        Diagnostics fresh;
+        for( int i = streamed; i < diagnostics.size(); i++ ) fresh << diagnostics[i];
+        streamed = diagnostics.size();
+        if( streaming.size() ) {
+            auto info = diagnosticEngine->printToJson(fresh);
+            for( auto& sub : streaming ) msock.respondPartialDiagnostics(sub->seq, info, phase);
+        }
+    }
+
+    return superseded(serving);
+}
+
+bool AliothCompiler::superseded( protocol::$Package package ) {
+    using namespace protocol;
+    lock_guard guard(jobs_lock);
+    if( canceled ) return true;
+
+    canceled = true;
+    for( auto& sub : subscribers(package) ) canceled = canceled and cancellations.count(sub->seq);
+    for( auto& job : jobs ) canceled = canceled or (job->title == DIAGNOSTICS and SameTargets(job, package));
+    return canceled;
+}
+
+protocol::Packages AliothCompiler::subscribers( protocol::$Package package ) {
+    protocol::Packages subs;
+    subs << package;
+    if( auto it = followers.find(package->seq); it != followers.end() )
+        for( auto& follower : it->second ) subs << follower;
+    return subs;
+}
+
+protocol::$Package AliothCompiler::companion( protocol::$Package package ) {
+    using namespace protocol;
+    for( int i = jobs.size() - 1; i >= 0 and jobs[i]->title == DIAGNOSTICS; i-- )
+        if( SameTargets(jobs[i], package) ) return jobs[i];
+    if( serving and serving_revision == revision and !canceled and SameTargets(serving, package) )
+        return serving;
+    return nullptr;
+}
+
+bool AliothCompiler::pending( long seq ) {
+    if( serving and serving->seq == seq ) return true;
+    for( auto& job : jobs ) if( job->seq == seq ) return true;
+    for( auto& [_,list] : followers ) for( auto& follower : list ) if( follower->seq == seq ) return true;
+    return false;
+}
+
+bool AliothCompiler::SameTargets( protocol::$Package a, protocol::$Package b ) {
+    const auto& x = a->request()->diagnostics()->targets;
+    const auto& y = b->request()->diagnostics()->targets;
+    if( x.size() != y.size() ) return false;
+    for( int i = 0; i < x.size(); i++ ) if( x[i] != y[i] ) return false;
+    return true;
+}
+
 bool AliothCompiler::detectInvolvedModules() {
     bool success = true;
+    auto timing = profiler.measure("detect");
     
     target_modules.clear();
+    dependencies.clear();
+    defective_modules.clear();
     success = success and context.syncModules( {flags:WORK} );
 
     if( target.modules.size() ==  0 )
@@ -448,22 +825,33 @@ bool AliothCompiler::detectInvolvedModules() {
 
     for( auto& name : target.modules )
         success = confirmModuleCompleteness( name ) and success;
+    success = arrangeTargetModules() and success;
     
     return success;
 }
 
 bool AliothCompiler::performSyntaticAnalysis() {
-    bool success = true;
-    for( auto s : target_modules )
-        success = performSyntaticAnalysis(s) and success;
-    return success;
+    return performSyntaticAnalysis(target_modules);
 }
 
 bool AliothCompiler::performSemanticAnalysis( bool backend ) {
-    semantic.clearCache();
-    if( !semantic.associateModules(target_modules) ) return false;
-    if( !semantic.validateDefinitionSemantics() ) return false;
-    if( !semantic.validateImplementationSemantics() ) return false;
+    bool valid = true;
+    signatures stale;
+
+    /** 语义检查会改写语法树，所引用的接口发生改变的模块只能重新构造语法树再检查 */
+    do {
+        for( auto sig : stale ) {
+            context.resetFragments(sig);
+            if( !performSyntaticAnalysis(sig) ) return false;
+        }
+        semantic.clearCache();
+        if( !semantic.associateModules(target_modules) ) return false;
+        valid = semantic.validateDefinitionSemantics(dependencies);
+        stale = semantic.collectStaleModules();
+    } while( stale.size() );
+
+    if( !valid or checkpoint("definition") ) return false;
+    if( !semantic.validateImplementationSemantics() or checkpoint("implementation") ) return false;
 
     if( backend ) {
         bool success = true;
@@ -473,6 +861,7 @@ bool AliothCompiler::performSemanticAnalysis( bool backend ) {
         if( target.variables.count("arch",json::string) ) arch = target.variables["arch"];
         if( target.variables.count("platform",json::string) ) platform = target.variables["platform"];
         auto air = AirContext(arch, platform, diagnostics);
+        air.setLayout(layout);
 
         signatures targets;
         for( auto mname : target.modules )
@@ -482,6 +871,7 @@ bool AliothCompiler::performSemanticAnalysis( bool backend ) {
             auto mod = semantic.getModule(sig);
             if( !mod ) {success = false; continue;}
             else success  = air(mod) and success;
+            if( checkpoint("backend") ) return false;
         }
     }
     return true;
@@ -489,96 +879,286 @@ bool AliothCompiler::performSemanticAnalysis( bool backend ) {
 
 bool AliothCompiler::generateTargetFile() {
     bool success = true;
+    auto timing = profiler.measure("backend");
 
     auto arch = PackageLocator::THIS_ARCH;
     auto platform = PackageLocator::THIS_PLATFORM;
     if( target.variables.count("arch",json::string) ) arch = target.variables["arch"];
     if( target.variables.count("platform",json::string) ) platform = target.variables["platform"];
-    auto air = AirContext(arch, platform, diagnostics);
+    unique_ptr<AirContext> air; // 全部命中缓存时不必初始化后端
+
+    unique_ptr<ObjectCache> cache;
+    if( cache_dir.size() ) {
+        cache = make_unique<ObjectCache>(cache_dir, cache_capacity);
+        if( !cache->open() ) diagnostics[cache_dir]("124", cache_dir), cache = nullptr;
+    }
+
+    /** 若指纹文件记录的指纹与当前指纹一致，并且目标文件存在，则目标文件可以复用 */
+    auto cached = [&]( const string& fname, const string& fingerprint ) {
+        if( !spaceEngine->statDataSource(srcdesc{flags: WORK|OBJ|DOCUMENT, name: fname}) ) return false;
+        auto is = spaceEngine->openDocumentForRead({flags: WORK|OBJ|DOCUMENT, name: fname + ".fingerprint"});
+        string recorded;
+        return is and getline(*is, recorded) and recorded == fingerprint;
+    };
+
+    /** 先清空指纹文件再产生目标文件，产生失败或中断时不会留下与目标文件不符的指纹
+     *  共享缓存命中时直接复制缓存的内容，否则由后端产生，需要存入共享缓存时先产生到内存中 */
+    auto generate = [&]( const string& fname, const string& fingerprint, const string& key, auto translate ) {
+        auto timing = profiler.measure("backend", fname);
+        auto fdesc = srcdesc{flags: WORK|OBJ|DOCUMENT, name: fname + ".fingerprint"};
+        spaceEngine->openDocumentForWrite(fdesc);
+        auto desc = srcdesc{flags: WORK|OBJ|DOCUMENT, name: fname};
+        string content;
+        bool success = true;
+        if( cache and cache->fetch(key, content) ) {
+            success = emitDocument(desc, [&]( llvm::raw_pwrite_stream& os ){ return os.write(content.data(), content.size()), true; });
+        } else {
+            if( !air ) air = make_unique<AirContext>(arch, platform, diagnostics), air->setLayout(layout);
+            if( cache ) {
+                llvm::SmallVector<char,0> buf;
+                auto os = llvm::raw_svector_ostream(buf);
+                if( !translate(os) ) return false;
+                cache->store(key, string(buf.begin(), buf.end()));
+                success = emitDocument(desc, [&]( llvm::raw_pwrite_stream& os ){ return os.write(buf.data(), buf.size()), true; });
+            } else {
+                success = emitDocument(desc, translate);
+            }
+        }
+        if( !success ) return false;
+        if( auto fs = spaceEngine->openDocumentForWrite(fdesc); fs ) *fs << fingerprint << endl;
+        return true;
+    };
+    auto ext = emit == emit_t::bitcode ? string(".bc") : string(".o");
 
     signatures targets;
     for( auto mname : target.modules )
         targets += context.getModule(mname, {flags:WORK});
 
-    for( auto sig : targets ) {
+    /** 链接时优化的目标文件依赖所有目标模块，任何模块的指纹变化都需要重新产生 */
+    if( lto ) {
+        modules mods;
+        auto program = target.indicator == Target::EXECUTABLE;
+        auto fingerprint = Digest(string("lto|") + (program ? "program|" : "library|"));
+        auto key = fingerprint;
+        for( auto sig : targets ) {
+            auto mod = semantic.getModule(sig);
+            if( !mod ) {success = false; continue;}
+            mods << mod;
+            fingerprint = Digest(calculateObjectFingerprint(mod, arch, platform) + "|", fingerprint);
+            if( cache ) key = Digest(calculateObjectFingerprint(mod, arch, platform, true) + "|", key);
+        }
+        auto fname = target.name + ".lto" + ext;
+        if( success and !cached(fname, Hex(fingerprint)) )
+            success = generate(fname, Hex(fingerprint), Hex(key), [&]( llvm::raw_pwrite_stream& os ){ return (*air)(mods, os, emit, program); });
+    } else for( auto sig : targets ) {
         auto mod = semantic.getModule(sig);
         if( !mod ) {success = false; continue;}
-        auto fname = mod->sig->name.tx + ".o";
-        auto desc = srcdesc{
-            flags: WORK|OBJ|DOCUMENT,
-            name: fname
-        };
-        auto os = spaceEngine->openDocumentForWrite(desc);
-        if( !os ) diagnostics[spaceEngine->getUri(desc)]("80", fname), success = false;
-        else success  = air(mod, *os) and success;
+        auto fname = mod->sig->name.tx + ext;
+        auto fingerprint = calculateObjectFingerprint(mod, arch, platform);
+        if( cached(fname, fingerprint) ) continue;
+        auto key = cache ? calculateObjectFingerprint(mod, arch, platform, true) : "";
+        success = generate(fname, fingerprint, key, [&]( llvm::raw_pwrite_stream& os ){ return (*air)(mod, os, emit); }) and success;
     }
 
-    if( auto os = spaceEngine->openDocumentForWrite({flags: WORK|OBJ|DOCUMENT,name: "alioth.o"}); os ) {
-        success = air(*os) and success;
-    } else {
-        diagnostics[spaceEngine->getUri({flags: WORK|OBJ|DOCUMENT,name: "alioth.o"})]("80", "alioth.o");
-        success = false;
-    }
+    /** 构成完整程序的链接时优化目标文件已经包含了alioth模块 */
+    auto fingerprint = Hex(Digest(__compiler_ver_str__ + "|" + arch + "|" + platform + "|" + to_string((int)emit)));
+    if( !(lto and target.indicator == Target::EXECUTABLE) and !cached("alioth" + ext, fingerprint) )
+        success = generate("alioth" + ext, fingerprint, fingerprint, [&]( llvm::raw_pwrite_stream& os ){ return (*air)(os, emit); }) and success;
+
+    /** 一次构建可能存入多个条目，构建结束后统一修剪缓存 */
+    if( cache and cache->getStatistics().stores ) cache->trim();
 
     return success;
 }
 
+string AliothCompiler::calculateObjectFingerprint( $module mod, const string& arch, const string& platform, bool portable ) {
+    auto fingerprint = Digest(__compiler_ver_str__ + "|" + arch + "|" + platform + "|" + to_string((int)layout) + "|" + to_string((int)emit) + "|");
+
+    /** 可移植的指纹以空间中的相对位置代替绝对位置识别文档和模块 */
+    auto identify = [&]( const srcdesc& desc ) {
+        if( portable ) return to_string(desc.flags) + ":" + desc.package + ":" + desc.name;
+        return (string)spaceEngine->getUri(desc);
+    };
+
+    /** 模块自身的源码和接口 */
+    for( auto& [doc,rec] : mod->sig->docs ) {
+        fingerprint = Digest(identify(doc) + "|", fingerprint);
+        fingerprint = Digest(Hex(rec.fg ? rec.fg->digest : 0) + "|", fingerprint);
+    }
+    fingerprint = Digest(semantic.getInterface(mod->sig) + "|", fingerprint);
+
+    /** 模板类的用例由其他模块请求，却产生在定义模板的模块的目标文件中
+     *  用例的符号按序累积，模板实参所属的模块的接口也参与计算 */
+    set<string> usages;
+    set<$signature> owners;
+    function<void($typeexpr)> own = [&]( $typeexpr type ) {
+        if( !type or !(type = SemanticContext::$(type)) ) return;
+        if( type->is_type(PointerTypeMask) ) own(($typeexpr)type->sub);
+        else if( type->is_type(StructType) or type->is_type(EntityType) or type->is_type(EnumType) )
+            if( auto node = ($node)type->sub; node and node->getModule() ) owners.insert(node->getModule()->sig);
+    };
+    function<void($classdef)> collect = [&]( $classdef cls ) {
+        if( !cls ) return;
+        if( cls->targf.size() and cls->targs.size() == 0 ) for( auto usage : cls->usages ) {
+            usages.insert(SemanticContext::GetBinarySymbol(($node)usage));
+            for( auto targ : usage->targs ) if( targ ) own(targ->dtype);
+            collect(usage);
+        } else for( auto def : cls->defs ) if( auto sub = ($classdef)def; sub ) collect(sub);
+    };
+    collect(mod->trans);
+    for( auto& symbol : usages ) fingerprint = Digest(symbol + "|", fingerprint);
+    owners.erase(mod->sig);
+
+    /** 所有直接或间接依赖的接口以及模板实参所属的模块的接口，按照拓扑序累积 */
+    set<$signature> closure;
+    signatures padding = {mod->sig};
+    while( padding.size() ) {
+        auto sig = padding[-1];
+        padding.pop();
+        for( auto& e : dependencies.dependencies(sig) )
+            if( closure.insert(e.to).second ) padding << e.to;
+    }
+    for( auto sig : target_modules ) if( closure.count(sig) or owners.count(sig) ) {
+        fingerprint = Digest(identify(sig->space) + "|" + sig->name.tx + "|", fingerprint);
+        fingerprint = Digest(semantic.getInterface(sig) + "|", fingerprint);
+    }
+
+    return Hex(fingerprint);
+}
+
 bool AliothCompiler::generateAssembleFile() {
     bool success = true;
+    auto timing = profiler.measure("backend");
 
     auto arch = PackageLocator::THIS_ARCH;
     auto platform = PackageLocator::THIS_PLATFORM;
     if( target.variables.count("arch",json::string) ) arch = target.variables["arch"];
     if( target.variables.count("platform",json::string) ) platform = target.variables["platform"];
     auto air = AirContext(arch, platform, diagnostics);
+    air.setLayout(layout);
 
     signatures targets;
     for( auto mname : target.modules )
         targets += context.getModule(mname, {flags:WORK});
 
-    for( auto sig : targets ) {
+    auto program = target.indicator == Target::EXECUTABLE;
+    if( lto ) {
+        modules mods;
+        for( auto sig : targets )
+            if( auto mod = semantic.getModule(sig); mod ) mods << mod;
+            else success = false;
+        auto desc = srcdesc{
+            flags: WORK|OBJ|DOCUMENT,
+            name: target.name + ".lto.ll"
+        };
+        auto timing = profiler.measure("backend", desc.name);
+        success = emitDocument(desc, [&]( llvm::raw_pwrite_stream& os ){ return air(mods, os, emit_t::ir, program); }) and success;
+        if( program ) return success;
+    } else for( auto sig : targets ) {
         auto mod = semantic.getModule(sig);
         if( !mod ) {success = false; continue;}
-        auto fname = mod->sig->name.tx + ".ll";
         auto desc = srcdesc{
             flags: WORK|OBJ|DOCUMENT,
-            name: fname
+            name: mod->sig->name.tx + ".ll"
         };
-        auto os = spaceEngine->openDocumentForWrite(desc);
-        if( !os ) diagnostics[spaceEngine->getUri(desc)]("80", fname);
-        else success  = air(mod, *os, true) and success;
+        auto timing = profiler.measure("backend", desc.name);
+        success = emitDocument(desc, [&]( llvm::raw_pwrite_stream& os ){ return air(mod, os, emit_t::ir); }) and success;
     }
 
-    if( auto os = spaceEngine->openDocumentForWrite({flags: WORK|OBJ|DOCUMENT,name: "alioth.ll"}); os ) {
-        success = air(*os, true) and success;
-    } else {
-        diagnostics[spaceEngine->getUri({flags: WORK|OBJ|DOCUMENT,name: "alioth.ll"})]("80", "alioth.ll");
-        success = false;
+    auto desc = srcdesc{flags: WORK|OBJ|DOCUMENT, name: "alioth.ll"};
+    if( auto timing = profiler.measure("backend", desc.name); true )
+        success = emitDocument(desc, [&]( llvm::raw_pwrite_stream& os ){ return air(os, emit_t::ir); }) and success;
+
+    return success;
+}
+
+bool AliothCompiler::emitDocument( const srcdesc& desc, const function<bool(llvm::raw_pwrite_stream&)>& emit ) {
+    auto uri = spaceEngine->getUri(desc);
+
+    /** 不在本地文件系统中的文档先产生到内存中，再一次性写入输出流 */
+    if( uri.scheme != "file" ) {
+        llvm::SmallVector<char,0> buf;
+        auto os = llvm::raw_svector_ostream(buf);
+        if( !emit(os) ) return false;
+        auto out = spaceEngine->openDocumentForWrite(desc);
+        if( !out ) return diagnostics[uri]("80", desc.name), false;
+        out->write(buf.data(), buf.size());
+        return out->good();
     }
 
+    auto fd = ::open(spaceEngine->getPath(desc).data(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if( fd < 0 ) return diagnostics[uri]("80", desc.name), false;
+    auto os = llvm::raw_fd_ostream(fd, true);
+    auto success = emit(os);
+    os.close();
+    if( os.has_error() ) os.clear_error(), diagnostics[uri]("80", desc.name), success = false;
     return success;
 }
 
+void AliothCompiler::reportTime() {
+    if( !profiler.isEnabled() ) return;
+
+    /** 复制文件描述符，报告的流关闭时不会关闭诊断信息可能仍在使用的文件描述符 */
+    auto report = [&]( const DiagnosticDestination& to, const string& code, auto write ) {
+        uostream os;
+        if( to.fd >= 0 ) os = SpaceEngine::OpenStreamForWrite(dup(to.fd));
+        else os = SpaceEngine::OpenStreamForWrite(to.uri);
+        if( os ) write(*os), os->flush();
+        if( !os or !os->good() ) diagnostics["command-line"](code, to.fd >= 0 ? to_string(to.fd) : (string)to.uri);
+    };
+
+    if( time_report ) report(time_report_to, "127", [&]( ostream& os ) {
+        if( time_report_json ) os << profiler.toJson().toJsonString() << '\n';
+        else os << profiler.toTable();
+    });
+    if( profiler.isTracing() ) report(trace_to, "128", [&]( ostream& os ) {
+        profiler.writeTrace(os);
+    });
+}
+
 bool AliothCompiler::performSyntaticAnalysis( $signature sig ) {
+    return performSyntaticAnalysis(signatures{sig});
+}
+
+bool AliothCompiler::performSyntaticAnalysis( const signatures& sigs ) {
     bool success = true;
-    for( auto& [doc,_] : sig->docs ) {
+    auto timing = profiler.measure("syntax");
+    signatures owners;
+    chainz<srcdesc> docs;
+    for( auto sig : sigs ) for( auto& [doc,_] : sig->docs ) {
         if( _.status != _.unloaded ) {diagnostics += _.ds; continue;}
+        owners << sig;
+        docs << doc;
+    }
+
+    auto streams = spaceEngine->openDocumentsForRead(docs);
+    for( int i = 0; i < docs.size(); i++ ) {
+        auto& doc = docs[i];
         Diagnostics tempd;
         tempd[spaceEngine->getUri(doc)];
+        auto timing = profiler.measure("syntax", owners[i]->name.tx);
 
-        auto is = spaceEngine->openDocumentForRead( doc );
-        if( !is ) {
+        if( auto& is = streams[i]; !is ) {
             tempd("15", spaceEngine->getUri(doc));
+            drafts.erase((string)spaceEngine->getUri(doc));
             success = false;
         } else {
-            auto lc = LexicalContext( *is, false );
-            auto tokens = lc.perform();
-            auto sc = SyntaxContext(doc, tokens, tempd);
+            /** 全交互模式下只重新扫描文档受损的区域，语法分析复用未改变的顶层定义 */
+            auto cache = full_interactive ? &drafts[(string)spaceEngine->getUri(doc)] : nullptr;
+            auto tokens = cache ? alioth::tokens() : LexicalContext( *is, false ).perform();
+            if( cache ) LexicalContext::Relex(cache->text, cache->source, string(istreambuf_iterator<char>(*is), istreambuf_iterator<char>()));
+            if( profiler.isEnabled() ) {
+                is->clear();
+                if( auto bytes = (long)is->tellg(); bytes > 0 ) Profiler::Count(Profiler::BYTES, bytes);
+                Profiler::Count(Profiler::TOKENS, cache ? cache->source.size() : tokens.size());
+            }
+            auto sc = SyntaxContext(doc, tokens, tempd, cache);
             auto fg = sc.constructFragment();
+            if( fg ) for( auto& t : tokens ) fg->digest = Digest(to_string(t.id) + ":" + t.tx + ";", fg->digest);
             if( fg ) context.registerFragment(doc,fg);
             else context.registerFragmentFailure(doc,tempd);
             if( !fg ) success = false;
-            else semantic.releaseModule(sig); // 若模块的语法有所改动，则模块的语义被卸载
+            else semantic.releaseModule(owners[i]); // 若模块的语法有所改动，则模块的语义被卸载
         }
         diagnostics += tempd;
     }
@@ -593,61 +1173,81 @@ bool AliothCompiler::confirmModuleCompleteness( const string& name ) {
         return confirmModuleCompleteness(mod);
 }
 
-bool AliothCompiler::confirmModuleCompleteness( $signature mod, chainz<tuple<$signature,$depdesc>> padding, $depdesc _from ) {
+bool AliothCompiler::confirmModuleCompleteness( $signature root ) {
 
     bool correct = true;
-    auto space = spaceEngine->getUri(mod->space);
-    diagnostics[space];
-    /** 检查循环依赖 */
-    for( auto& [sig,_] : padding ) {
-        if( sig == mod ) {
-            diagnostics[get<1>(padding[-2])->getDocUri()]("16", space, sig->name );
-            for( auto& [s,f] : padding ) {
-                space = spaceEngine->getUri(s->space);
-                diagnostics[f->getDocUri()][-1](space, "17", space, s->name, f->phrase );
-                if( s == sig ) break;
-            }
-            return false;
-        }
-    } padding.insert( {mod,_from}, 0 );
-
-    for( auto& dep : mod->deps ) {
-        bool repeat = false;
-        /** 检查依赖可达性 */
-        srcdesc sp;
-        auto sig = calculateDependencySignature(dep,&sp);  //解算依赖空间
-        if( !sig ) {
-            if( dep->from.tx.size() ) {
-                auto [suc,str,dia] = dep->from.extractContent();
-                diagnostics[dep->getDocUri()]("20",mod->name, space, dep->name, str );
-            } else {
-                diagnostics[dep->getDocUri()]("20", mod->name, space, dep->name, "*" );
+    signatures padding;
+    if( dependencies.insert(root) ) padding << root;
+
+    /** 每个模块只被展开一次，每个依赖描述符只被解算一次 */
+    while( padding.size() ) {
+        auto mod = padding[0];
+        padding.remove(0);
+        auto space = spaceEngine->getUri(mod->space);
+        diagnostics[space];
+        map<$signature,depdescs> resolved;
+
+        for( auto& dep : mod->deps ) {
+            /** 检查依赖可达性 */
+            srcdesc sp;
+            auto sig = calculateDependencySignature(dep,&sp);  //解算依赖空间
+            if( !sig ) {
+                if( dep->from.tx.size() ) {
+                    auto [suc,str,dia] = dep->from.extractContent();
+                    diagnostics[dep->getDocPrefix()]("20",mod->name, space, dep->name, str );
+                } else {
+                    diagnostics[dep->getDocPrefix()]("20", mod->name, space, dep->name, "*" );
+                }
+                defective_modules.insert(mod);
+                correct = false;
+                continue;
             }
-            correct = false; 
-            continue;
-        }
-        /** 检查依赖重复 */
-        for( auto i = mod->deps.begin(); &*i != &dep; i++ ) {
-            auto sigi = calculateDependencySignature(*i);
-            if( sig == sigi ) {
-                diagnostics[dep->getDocUri()]( "19", dep->name, spaceEngine->getUri(sp) );
-                diagnostics[-1]((*i)->getDocUri(), "45", (*i)->phrase );
+            /** 检查依赖重复 */
+            auto& prvs = resolved[sig];
+            for( auto& prv : prvs ) {
+                diagnostics[dep->getDocPrefix()]( "19", dep->name, spaceEngine->getUri(sp) );
+                diagnostics[-1](prv->getDocPrefix(), "45", prv->phrase );
+            }
+            if( prvs.size() ) {
+                prvs << dep;
+                defective_modules.insert(mod);
                 correct = false;
-                repeat = true;
+                continue;
             }
+            prvs << dep;
+            /** 记录依赖关系，新发现的模块稍后展开 */
+            if( dependencies.insert(sig) ) padding << sig;
+            dependencies.connect(mod, dep, sig);
         }
-        /** 检查依赖完备性 */
-        if( !repeat ) correct = confirmModuleCompleteness(sig, padding,dep) and correct;
     }
 
-    /** 若模块完备，加入到目标模块队列中 */
-    if( correct ) {
-        bool found = false;
-        for( auto& sig : target_modules ) if( sig == mod ) {found = true; break;}
-        if( !found ) target_modules << mod;
+    return correct;
+}
+
+bool AliothCompiler::arrangeTargetModules() {
+    set<$signature> incomplete = defective_modules;
+
+    /** 强连通分量按照拓扑序产出，被依赖的模块总是先被处理 */
+    for( auto& component : dependencies.components() ) {
+        if( auto cycle = dependencies.cycle(component); cycle.size() ) {
+            auto root = component[0];
+            diagnostics[cycle[-1].dep->getDocPrefix()]("16", spaceEngine->getUri(root->space), root->name );
+            for( auto i = cycle.size()-1; i >= 0; i-- ) {
+                auto space = spaceEngine->getUri(cycle[i].from->space);
+                diagnostics[-1](cycle[i].dep->getDocPrefix(), "17", space, cycle[i].from->name, cycle[i].dep->phrase );
+            }
+            for( auto& sig : component ) incomplete.insert(sig);
+            continue;
+        }
+
+        /** 若模块及其所有依赖都完备，加入到目标模块队列中 */
+        auto sig = component[0];
+        for( auto& e : dependencies.dependencies(sig) )
+            if( incomplete.count(e.to) ) incomplete.insert(sig);
+        if( !incomplete.count(sig) ) target_modules << sig;
     }
 
-    return correct;
+    return incomplete.empty();
 }
 
 srcdesc AliothCompiler::calculateDependencySpace( $depdesc desc ) {
@@ -666,18 +1266,18 @@ srcdesc AliothCompiler::calculateDependencySpace( $depdesc desc ) {
         auto loc = PackageLocator::Parse(desc->from);
         if( loc ) {
             if( loc.major<0 or loc.minor<0 or loc.patch<0 ) {
-                diagnostics[desc->getDocUri()]("84", desc->from);
+                diagnostics[desc->getDocPrefix()]("84", desc->from);
                 return srcdesc::error;
             }
             if( loc.sections != 0 ) {
-                diagnostics[desc->getDocUri()]("86", desc->from);
+                diagnostics[desc->getDocPrefix()]("86", desc->from);
                 return srcdesc::error;
             }
             auto arch = spaceEngine->getArch();
             auto platform = spaceEngine->getPlatform();
             desc->from.tx = loc.toString(false,arch,platform);
         } else {
-            diagnostics[desc->getDocUri()]("85", desc->from);
+            diagnostics[desc->getDocPrefix()]("85", desc->from);
             return srcdesc::error;
         }
         return {flags:APKG,package:from};
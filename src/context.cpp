@@ -197,7 +197,7 @@ bool CompilerContext::syncModules( srcdesc space ) {
             found = true;
             if( cached.size != ie->size or cached.mtime != ie->mtime ) {
                 different = true;
-                modified << cached;
+                modified << *ie;
             }
             all_existing.remover(*ie--);
             break;
@@ -216,9 +216,14 @@ bool CompilerContext::syncModules( srcdesc space ) {
     if( different ) {
         //cache_map->clear();
 
-        for( const auto& desc : created + modified ) {
-            auto src = isalioth(desc.name);
-            auto x = loadDocument(desc,true);
+        /** 交互模式下，所有需要加载的文档以流水线方式一并读取 */
+        auto loading = created + modified;
+        chainz<srcdesc> descs;
+        for( const auto& desc : loading ) descs << desc;
+        auto streams = spaceEngine.openDocumentsForRead(descs);
+        for( int i = 0; i < loading.size(); i++ ) {
+            auto src = isalioth(loading[i].name);
+            auto x = loadDocument(loading[i],true,std::move(streams[i]));
             if( src and !x ) success = false;
         }
 
@@ -267,7 +272,7 @@ fulldesc CompilerContext::loadDocument( srcdesc doc, bool forceload ) {
     return loadDocument(spaceEngine.statDataSource(doc),forceload);
 }
 
-fulldesc CompilerContext::loadDocument( fulldesc doc, bool forceload ) {
+fulldesc CompilerContext::loadDocument( fulldesc doc, bool forceload, uistream prefetched ) {
     auto module = getModule(doc);
     if( module and !forceload ) {
         if( auto it = module->docs.find(doc); 
@@ -275,7 +280,7 @@ fulldesc CompilerContext::loadDocument( fulldesc doc, bool forceload ) {
                 return it->first;
     }
     auto src = isalioth(doc.name);
-    auto is = spaceEngine.openDocumentForRead( doc );
+    auto is = prefetched ? std::move(prefetched) : spaceEngine.openDocumentForRead( doc );
     if( !is ) {
         if( module ) module->docs.erase(doc);
         if( src ) return diagnostics("15",spaceEngine.getUri(doc)), srcdesc::error; 
@@ -304,6 +309,8 @@ fulldesc CompilerContext::loadDocument( fulldesc doc, bool forceload ) {
     /** 合并签名 */
     if( !module->combine(sig) ) return diagnostics("78", sig->entry), srcdesc::error;
     module->context = this;
+    /** 键中记录的修改时间和长度需要随之更新，否则同步时会反复认为文档被修改 */
+    module->docs.erase(doc);
     module->docs[doc] = {};
     return doc;
 }
@@ -328,9 +335,15 @@ bool CompilerContext::registerFragment( srcdesc doc, $fragment fg ) {
     reg.ds.clear();
     fg->doc = doc;
     fg->context = this;
+    fg->prefix = spaceEngine.getUri(doc);
     return true;
 }
 
+void CompilerContext::resetFragments( $signature sig ) {
+    if( !sig ) return;
+    for( auto& [_,reg] : sig->docs ) reg = signature::record();
+}
+
 bool CompilerContext::registerFragmentFailure( srcdesc doc, const Diagnostics& info ) {
     auto mod = getModule(doc);
     if( !mod or !mod->docs.count(doc) ) return false;
@@ -0,0 +1,110 @@
+#ifndef __depgraph_cpp__
+#define __depgraph_cpp__
+
+#include "depgraph.hpp"
+#include <functional>
+#include <set>
+
+namespace alioth {
+
+bool DependencyGraph::insert( $signature sig ) {
+    if( !sig or adjacency.count(sig) ) return false;
+    adjacency[sig];
+    nodes << sig;
+    return true;
+}
+
+void DependencyGraph::connect( $signature from, $depdesc dep, $signature to ) {
+    insert(from);
+    insert(to);
+    adjacency[from] << edge{from, dep, to};
+}
+
+bool DependencyGraph::contains( $signature sig )const {
+    return adjacency.count(sig);
+}
+
+const DependencyGraph::edges& DependencyGraph::dependencies( $signature sig )const {
+    static const edges none;
+    auto it = adjacency.find(sig);
+    if( it == adjacency.end() ) return none;
+    return it->second;
+}
+
+chainz<signatures> DependencyGraph::components()const {
+    chainz<signatures> result;
+    map<$signature,tuple<int,int>> marks;
+    set<$signature> onstack;
+    signatures stack;
+    int index = 0;
+
+    function<void($signature)> visit = [&]( $signature v ) {
+        marks[v] = {index,index};
+        index += 1;
+        stack << v;
+        onstack.insert(v);
+
+        for( auto& e : dependencies(v) ) {
+            if( !marks.count(e.to) ) {
+                visit(e.to);
+                get<1>(marks[v]) = min(get<1>(marks[v]), get<1>(marks[e.to]));
+            } else if( onstack.count(e.to) ) {
+                get<1>(marks[v]) = min(get<1>(marks[v]), get<0>(marks[e.to]));
+            }
+        }
+
+        if( get<0>(marks[v]) == get<1>(marks[v]) ) {
+            signatures component;
+            $signature w;
+            do {
+                w = stack[-1];
+                stack.pop();
+                onstack.erase(w);
+                component.insert(w, 0);
+            } while( w != v );
+            result << component;
+        }
+    };
+
+    for( auto& v : nodes ) if( !marks.count(v) ) visit(v);
+    return result;
+}
+
+DependencyGraph::edges DependencyGraph::cycle( const signatures& component )const {
+    edges path;
+    if( component.size() == 0 ) return path;
+    auto root = component[0];
+    set<$signature> members, visited;
+    for( auto& sig : component ) members.insert(sig);
+
+    function<bool($signature)> walk = [&]( $signature v ) {
+        for( auto& e : dependencies(v) ) {
+            if( !members.count(e.to) ) continue;
+            if( e.to == root ) return path << e, true;
+            if( visited.count(e.to) ) continue;
+            visited.insert(e.to);
+            path << e;
+            if( walk(e.to) ) return true;
+            path.pop();
+        }
+        return false;
+    };
+
+    walk(root);
+    return path;
+}
+
+signatures DependencyGraph::topological()const {
+    signatures order;
+    for( auto& component : components() ) order += component;
+    return order;
+}
+
+void DependencyGraph::clear() {
+    nodes.clear();
+    adjacency.clear();
+}
+
+}
+
+#endif
@@ -4,65 +4,241 @@
 #include "diagnostic.hpp"
 #include <ctime>
 #include <regex>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <unordered_set>
+#include <unordered_map>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace alioth {
 
-DiagnosticEngine::DiagnosticEngine():language(nullptr),format("%p:%l:%c:(%s<%E>) %i") {
-    auto& deflang = languages["default"];
-    language = &deflang;
-
-    deflang.severities[0] = "\033[1;31m错误\033[0m";
-    deflang.severities[1] = "\033[1;35m警告\033[0m";
-    deflang.severities[2] = "\033[1;34m信息\033[0m";
-    deflang.severities[3] = "\033[1;36m提示\033[0m";
-
-    deflang.templates["0"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "诊断引擎配置文件缺失" };
-
-    deflang.templates["1"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "诊断引擎配置文件损坏" };
-
-    deflang.templates["2"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "命令行选项'%B0'的参数缺失" };
-
-    deflang.templates["3"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "工作空间重映射失败" };
-
-    deflang.templates["4"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "根空间重映射失败" };
+const string istring::empty;
+
+istring::istring( const string& s ) {
+    static mutex lock;
+    static unordered_set<string> pool;
+
+    /** 池中的字符串永不释放，缓冲的键直接引用池中的内容 */
+    thread_local unordered_map<string_view,const string*> cache;
+    if( auto it = cache.find(s); it != cache.end() ) {
+        str = it->second;
+        return;
+    }
+
+    lock_guard guard(lock);
+    auto it = pool.find(s);
+    if( it == pool.end() ) it = pool.insert(s).first;
+    str = &*it;
+    cache.emplace(*str, str);
+}
+
+const char DiagnosticCatalog::magic[4] = {'A','D','C','\0'};
+const uint32_t DiagnosticCatalog::version = 2;
+
+DiagnosticTemplateRef DiagnosticLanguage::lookup( const string& code )const {
+    if( auto it = templates.find(code); it != templates.end() )
+        return {it->second.severity, it->second.beg, it->second.end, it->second.msg};
+    for( uint32_t lo = 0, hi = count; lo < hi; ) {
+        auto mid = lo + (hi - lo) / 2;
+        const auto& e = entries[mid];
+        auto cmp = strcmp(catalog + e.code, code.data());
+        if( cmp < 0 ) lo = mid + 1;
+        else if( cmp > 0 ) hi = mid;
+        else return {e.severity, {e.beg[0],e.beg[1]}, {e.end[0],e.end[1]}, catalog + e.msg};
+    }
+    return {};
+}
+
+DiagnosticEngine::DiagnosticEngine():format("%p:%l:%c:(%s<%E>) %i"),language(&Builtin()) {}
+
+DiagnosticEngine::~DiagnosticEngine() {
+    if( catalog ) munmap((void*)catalog, catalog_size);
+}
+
+const DiagnosticLanguage& DiagnosticEngine::Builtin() {
+    static const DiagnosticLanguage builtin = []{
+        DiagnosticLanguage lang;
+
+        lang.severities[0] = "\033[1;31m错误\033[0m";
+        lang.severities[1] = "\033[1;35m警告\033[0m";
+        lang.severities[2] = "\033[1;34m信息\033[0m";
+        lang.severities[3] = "\033[1;36m提示\033[0m";
+
+        lang.templates["0"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "诊断引擎配置文件缺失" };
+
+        lang.templates["1"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "诊断引擎配置文件损坏" };
+
+        lang.templates["2"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "命令行选项'%B0'的参数缺失" };
+
+        lang.templates["3"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "工作空间重映射失败" };
+
+        lang.templates["4"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "根空间重映射失败" };
     
-    deflang.templates["5"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "选项'%B0'无效，未找到诊断语种'%R1'" };
+        lang.templates["5"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "选项'%B0'无效，未找到诊断语种'%R1'" };
     
-    deflang.templates["6"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "交互模式启动失败，参数'%R0'格式不正确" };
-
-    deflang.templates["7"] = {
-        severity: 1,
-        beg: {0,0},
-        end: {0,0},
-        msg: "未找到执行目标" };
+        lang.templates["6"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "交互模式启动失败，参数'%R0'格式不正确" };
+
+        lang.templates["7"] = {
+            severity: 1,
+            beg: {0,0},
+            end: {0,0},
+            msg: "未找到执行目标" };
+
+        return lang;
+    }();
+    return builtin;
+}
+
+bool DiagnosticEngine::loadCatalog( const string& path, int64_t mtime, uint64_t size ) {
+    using C = DiagnosticCatalog;
+    int fd = open(path.data(), O_RDONLY);
+    if( fd < 0 ) return false;
+    struct stat st;
+    void* data = MAP_FAILED;
+    if( fstat(fd, &st) == 0 and (size_t)st.st_size >= sizeof(C::header) )
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( data == MAP_FAILED ) return false;
+
+    /** 目录中的每一个偏移都被校验，损坏的目录被拒绝，而不会导致越界访问 */
+    auto base = (const char*)data;
+    size_t length = st.st_size;
+    auto head = (const C::header*)base;
+    auto text = [&]( uint32_t off ) { return off < length and memchr(base + off, '\0', length - off); };
+    auto langs = (const C::language*)(base + sizeof(C::header));
+    bool valid = memcmp(head->magic, C::magic, sizeof(C::magic)) == 0
+        and head->version == C::version and head->mtime == mtime and head->size == size
+        and text(head->format) and text(head->language)
+        and head->languages <= (length - sizeof(C::header)) / sizeof(C::language);
+    for( uint32_t i = 0; valid and i < head->languages; i++ ) {
+        const auto& l = langs[i];
+        valid = text(l.name) and text(l.severities[0]) and text(l.severities[1]) and text(l.severities[2]) and text(l.severities[3])
+            and l.templates % alignof(C::entry) == 0 and l.templates <= length and l.count <= (length - l.templates) / sizeof(C::entry);
+        auto entries = (const C::entry*)(base + l.templates);
+        for( uint32_t k = 0; valid and k < l.count; k++ )
+            valid = text(entries[k].code) and text(entries[k].msg) and entries[k].severity >= 1 and entries[k].severity <= 4
+                and entries[k].beg[1] >= 0 and entries[k].end[1] >= 0;
+    }
+    if( !valid ) return munmap(data, length), false;
+
+    /** 语种引用映射的模板表，加载时不复制模板，查找时只读，多个线程可以同时打印诊断信息 */
+    format = base + head->format;
+    for( uint32_t i = 0; i < head->languages; i++ ) {
+        auto& lang = languages[base + langs[i].name] = DiagnosticLanguage();
+        for( int k = 0; k < 4; k++ ) lang.severities[k] = base + langs[i].severities[k];
+        lang.catalog = base;
+        lang.entries = (const C::entry*)(base + langs[i].templates);
+        lang.count = langs[i].count;
+    }
+    selectLanguage(base + head->language);
+    if( catalog ) munmap((void*)catalog, catalog_size);
+    catalog = base;
+    catalog_size = length;
+    return true;
+}
+
+bool DiagnosticEngine::saveCatalog( const string& path, int64_t mtime, uint64_t size )const {
+    using C = DiagnosticCatalog;
+
+    /** 模板表已经按诊断代码排序，从目录加载的模板同样被编入 */
+    map<string,map<string,DiagnosticTemplate>> merged;
+    string selected;
+    for( const auto& [name,lang] : languages ) {
+        auto& templates = merged[name] = lang.templates;
+        for( uint32_t k = 0; k < lang.count; k++ ) {
+            const auto& e = lang.entries[k];
+            templates.emplace(lang.catalog + e.code, DiagnosticTemplate{
+                severity: e.severity,
+                beg: {e.beg[0],e.beg[1]},
+                end: {e.end[0],e.end[1]},
+                msg: lang.catalog + e.msg });
+        }
+        if( &lang == language ) selected = name;
+    }
+
+    size_t total = 0;
+    for( const auto& [name,templates] : merged ) total += templates.size();
+    const size_t pool_base = sizeof(C::header) + merged.size() * sizeof(C::language) + total * sizeof(C::entry);
+    string pool;
+    map<string,uint32_t> interned;
+    auto intern = [&]( const string& str ) -> uint32_t {
+        if( auto it = interned.find(str); it != interned.end() ) return it->second;
+        auto off = (uint32_t)(pool_base + pool.size());
+        pool.append(str.data(), str.size() + 1);
+        return interned[str] = off;
+    };
+
+    C::header head = {};
+    memcpy(head.magic, C::magic, sizeof(C::magic));
+    head.version = C::version;
+    head.mtime = mtime;
+    head.size = size;
+    head.format = intern(format);
+    head.language = intern(selected);
+    head.languages = merged.size();
+
+    vector<C::language> langs;
+    vector<C::entry> entries;
+    for( const auto& [name,templates] : merged ) {
+        auto& l = langs.emplace_back();
+        const auto& lang = languages.at(name);
+        l.name = intern(name);
+        for( int k = 0; k < 4; k++ ) l.severities[k] = intern(lang.severities[k]);
+        l.templates = sizeof(C::header) + merged.size() * sizeof(C::language) + entries.size() * sizeof(C::entry);
+        l.count = templates.size();
+        for( const auto& [code,tmpl] : templates ) entries.push_back({
+            code: intern(code),
+            severity: tmpl.severity,
+            beg: {get<0>(tmpl.beg),get<1>(tmpl.beg)},
+            end: {get<0>(tmpl.end),get<1>(tmpl.end)},
+            msg: intern(tmpl.msg) });
+    }
+
+    /** 先写入临时文件再替换，正在映射旧目录的编译器不受影响 */
+    auto temp = path + ".tmp";
+    auto os = ofstream(temp, ios::binary | ios::trunc);
+    os.write((const char*)&head, sizeof(head));
+    os.write((const char*)langs.data(), langs.size() * sizeof(C::language));
+    os.write((const char*)entries.data(), entries.size() * sizeof(C::entry));
+    os.write(pool.data(), pool.size());
+    os.close();
+    if( !os or rename(temp.data(), path.data()) != 0 ) return remove(temp.data()), false;
+    return true;
 }
 
 bool DiagnosticEngine::configure( const json& config ) {
@@ -142,6 +318,7 @@ chainz<string> DiagnosticEngine::enumerateLanguages() const {
 }
 
 bool DiagnosticEngine::selectLanguage( const string& lang ) {
+    if( lang == "default" and languages.count(lang) == 0 ) return language = &Builtin(), true;
     if( languages.count(lang) == 0 ) return false;
     language = &languages[lang];
     return true;
@@ -149,11 +326,22 @@ bool DiagnosticEngine::selectLanguage( const string& lang ) {
 
 string DiagnosticEngine::printToString( const Diagnostic& d )const {
     string res;
+    formatDiagnostic(d, res, 0);
+    return res;
+}
+
+void DiagnosticEngine::printToString( const Diagnostic& d, string& out )const {
+    formatDiagnostic(d, out, 0);
+}
+
+void DiagnosticEngine::formatDiagnostic( const Diagnostic& d, string& res, int depth )const {
+    auto mark = res.size();
     int off = 0;
 
     if( !language ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: language options unavailable");
-    if( !language->templates.count(d.code) ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: no corresponding diagnostic template found for error code "+d.code);
-    auto tmpl = language->templates.at(d.code);
+    auto tmpl = language->lookup(d.code);
+    if( !tmpl ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: no corresponding diagnostic template found for error code "+(const string&)d.code);
+    res.reserve(mark + format.size() + d.prefix.size() + tmpl.msg.size() * 2);
     
     while( format[off] != '\0' ) {
         if( format[off] == '%' ) switch( format[++off] ) {
@@ -179,7 +367,7 @@ string DiagnosticEngine::printToString( const Diagnostic& d )const {
                 res += d.code;
                 break;
             case 'i':
-                res += organizeDiagnosticInformation( d );
+                organizeDiagnosticInformation( d, res );
                 break;
             case 'l':
                 if( auto [lo,nu] = tmpl.beg; lo == 0 ) res += "0";
@@ -219,15 +407,17 @@ string DiagnosticEngine::printToString( const Diagnostic& d )const {
         off += 1;
     }
 
-    for( auto i : printToString(d.info) ) {
-        i.insert(0,"\n");
-        for( int o = 0; o < i.size(); o++ ) {
-            if( i[o] == '\n' ) i.insert(++o,"\t");
-        }
-        res += i;
+    /** 辅助信息逐层缩进，每一层的每一行都比上一层多一个制表符 */
+    if( depth > 0 and res.find('\n', mark) != string::npos ) {
+        auto text = res.substr(mark);
+        res.resize(mark);
+        for( auto c : text ) if( res += c; c == '\n' ) res.append(depth, '\t');
+    }
+    for( const auto& i : d.info ) {
+        res += '\n';
+        res.append(depth + 1, '\t');
+        formatDiagnostic(i, res, depth + 1);
     }
-
-    return res;
 }
 
 chainz<string> DiagnosticEngine::printToString( const Diagnostics& s )const {
@@ -240,13 +430,15 @@ json DiagnosticEngine::printToJson( const Diagnostic& d )const {
     json diagnostic = json::object;
 
     if( !language ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: language options unavailable");
-    if( !language->templates.count(d.code) ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: no corresponding diagnostic template found");
-    auto tmpl = language->templates.at(d.code);
+    auto tmpl = language->lookup(d.code);
+    if( !tmpl ) throw runtime_error("DiagnosticEngine::printToString( const Diagnostic& d, const DiagnosticLanguage* lang )const: no corresponding diagnostic template found");
 
     diagnostic["severity"] = (long)tmpl.severity;
-    diagnostic["prefix"] = d.prefix;
-    diagnostic["error_code"] = d.code;
-    diagnostic["message"] = organizeDiagnosticInformation(d, false);
+    diagnostic["prefix"] = (const string&)d.prefix;
+    diagnostic["error_code"] = (const string&)d.code;
+    string message;
+    organizeDiagnosticInformation(d, message, false);
+    diagnostic["message"] = move(message);
 
     if( auto [lo,nu] = tmpl.beg; lo == 0 ) diagnostic["begin_line"] = (long)0;
     else if( lo > 0 ) diagnostic["begin_line"] = (long)d.args[nu].bl;
@@ -278,15 +470,15 @@ json DiagnosticEngine::printToJson( const Diagnostics& s )const {
     return diagnostics;
 }
 
-string DiagnosticEngine::organizeDiagnosticInformation( const Diagnostic& d, bool colored ) const {
-    string res;
+void DiagnosticEngine::organizeDiagnosticInformation( const Diagnostic& d, string& res, bool colored ) const {
     int off = 0;
     int state = 1;
     bool stay = false;
 
-    const auto& tmpl = language->templates.at(d.code);
+    auto tmpl = language->lookup(d.code);
+    if( !tmpl ) throw runtime_error("DiagnosticEngine::organizeDiagnosticInformation( const Diagnostic& d, bool colored ): no corresponding diagnostic template found");
     while( state > 0 ) {
-        switch( auto c = tmpl.msg[off]; state ) {
+        switch( auto c = tmpl.msg.data()[off]; state ) {
             case 1:
                 if( c == '%' ) state = 2;
                 else if( c == '\0' ) state = 0;
@@ -323,8 +515,6 @@ string DiagnosticEngine::organizeDiagnosticInformation( const Diagnostic& d, boo
         if( stay ) stay = false;
         else off += 1;
     }
-
-    return res;
 }
 
 }
@@ -0,0 +1,110 @@
+#ifndef __docbuf_cpp__
+#define __docbuf_cpp__
+
+#include "docbuf.hpp"
+#include <algorithm>
+
+namespace alioth {
+
+const size_t DocumentBuffer::piece_size = 4096;
+
+DocumentBuffer::DocumentBuffer( const string& content ) {
+    assign(content);
+}
+
+void DocumentBuffer::assign( const string& content ) {
+    pieces.clear();
+    for( size_t at = 0; at < content.size() or pieces.empty(); at += piece_size ) {
+        auto& p = pieces.emplace_back();
+        p.text = content.substr(min(at, content.size()), piece_size);
+        p.lines = count(p.text.begin(), p.text.end(), '\n');
+    }
+    length = content.size();
+}
+
+bool DocumentBuffer::replace( size_t offset, size_t count, const string& text ) {
+    if( offset > length or count > length - offset ) return false;
+
+    /** 偏移恰好位于片段末尾时仍然落在该片段中，在末尾追加时不必跨越片段 */
+    size_t index = 0, local = offset;
+    while( index + 1 < pieces.size() and local > pieces[index].text.size() )
+        local -= pieces[index++].text.size();
+
+    /** 删除的范围可能跨越多个片段，被删空的片段在平衡之前移除 */
+    for( size_t i = index, at = local, rest = count; rest > 0; i++, at = 0 ) {
+        auto& p = pieces[i];
+        auto n = min(rest, p.text.size() - at);
+        p.lines -= std::count(p.text.begin() + at, p.text.begin() + at + n, '\n');
+        p.text.erase(at, n);
+        rest -= n;
+    }
+    auto last = index + 1;
+    while( last < pieces.size() and pieces[last].text.empty() ) last += 1;
+    pieces.erase(pieces.begin() + index + 1, pieces.begin() + last);
+
+    auto& p = pieces[index];
+    p.text.insert(local, text);
+    p.lines += std::count(text.begin(), text.end(), '\n');
+    length = length - count + text.size();
+
+    balance(index);
+    return true;
+}
+
+bool DocumentBuffer::locate( size_t line, size_t column, size_t& offset )const {
+    if( line < 1 or column < 1 ) return false;
+    size_t need = line - 1, base = 0;
+    for( auto& p : pieces ) {
+        if( need > p.lines ) {
+            need -= p.lines;
+            base += p.text.size();
+            continue;
+        }
+        size_t pos = 0;
+        for( ; need > 0; need-- ) pos = p.text.find('\n', pos) + 1;
+        offset = base + pos + column - 1;
+        return offset <= length;
+    }
+    return false;
+}
+
+size_t DocumentBuffer::size()const {
+    return length;
+}
+
+string DocumentBuffer::content()const {
+    string ret;
+    ret.reserve(length);
+    for( auto& p : pieces ) ret += p.text;
+    return ret;
+}
+
+void DocumentBuffer::balance( size_t index ) {
+    auto merge = [this]( size_t i ) {
+        pieces[i].text += pieces[i+1].text;
+        pieces[i].lines += pieces[i+1].lines;
+        pieces.erase(pieces.begin() + i + 1);
+    };
+
+    if( index + 1 < pieces.size() and pieces[index].text.size() + pieces[index+1].text.size() <= piece_size )
+        merge(index);
+    if( index > 0 and pieces[index-1].text.size() + pieces[index].text.size() <= piece_size )
+        merge(--index);
+    if( pieces.size() > 1 and pieces[index].text.empty() )
+        return (void)pieces.erase(pieces.begin() + index);
+
+    if( pieces[index].text.size() <= 2 * piece_size ) return;
+    auto whole = std::move(pieces[index].text);
+    vector<piece> parts;
+    for( size_t at = 0; at < whole.size(); at += piece_size ) {
+        auto& p = parts.emplace_back();
+        p.text = whole.substr(at, piece_size);
+        p.lines = std::count(p.text.begin(), p.text.end(), '\n');
+    }
+    pieces.erase(pieces.begin() + index);
+    pieces.insert(pieces.begin() + index, parts.begin(), parts.end());
+}
+
+}
+
+#endif
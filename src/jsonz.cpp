@@ -5,6 +5,8 @@
 #include <map>
 #include <stdexcept>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 #include "chainz.hpp"
 
 using strty = std::string;
@@ -431,60 +433,179 @@ json json::FromJsonStream( std::istream& is ) {
 }
 
 strty json::toJsonString() const {
+    strty ret;
+    toJsonString(ret);
+    return ret;
+}
+
+void json::toJsonString( strty& out ) const {
     switch ( mtype ) {
-        case null: return "null";
-        case boolean: return *(bool*)mdata?"true":"false";
-        case integer: return std::to_string(*(long*)mdata);
-        case number: return std::to_string(*(double*)mdata);
+        case null: out += "null"; break;
+        case boolean: out += *(bool*)mdata?"true":"false"; break;
+        case integer: out += std::to_string(*(long*)mdata); break;
+        case number: out += std::to_string(*(double*)mdata); break;
         case object: {
             const auto& map = *(objty*)mdata;
             auto count = map.size();
-            if( count == 0 ) return "{}";
-            strty ret = "{";
-            for( auto [key,value] : map ) {
-                ret += "\"" + key + "\":" + value.toJsonString();
-                if( count-- > 1 ) ret += ',';
+            out += '{';
+            for( const auto& [key,value] : map ) {
+                out += '\"';
+                out += key;
+                out += "\":";
+                value.toJsonString(out);
+                if( count-- > 1 ) out += ',';
             }
-            ret += "}";
-            return ret;
-        }
+            out += '}';
+        } break;
         case array: {
             const auto& list = *(arrty*)mdata;
             auto count = list.size();
-            if( count == 0 ) return "[]";
-            strty ret = "[";
-            for( auto value : list ) {
-                ret += value.toJsonString();
-                if( count-- > 1 ) ret += ',';
+            out += '[';
+            for( const auto& value : list ) {
+                value.toJsonString(out);
+                if( count-- > 1 ) out += ',';
             }
-            ret += "]";
-            return ret;
-        }
+            out += ']';
+        } break;
         case string: {
-            strty ret = "\"";
+            out += '\"';
             for( auto i = ((strty*)mdata)->begin(); i != ((strty*)mdata)->end(); i++ ) switch( *i ) {
-                case '\"': ret += "\\\"";break;
-                case '\\': ret += "\\\\";break;
-                //case '/': ret += "\\/";break;
-                case '\b': ret += "\\b";break;
-                case '\n': ret += "\\n";break;
-                case '\r': ret += "\\r";break;
-                default:
-                    /*if( isprint(*i) )*/ ret += *i;
-                    /*else if( *(i+1) != '\0' ) {
-                        char buf[8];
-                        sprintf(buf,"%02x%02x", 0x00FF&*(i+1), 0x00FF&*i );
-                        ret += "\\u" + strty(buf);
-                        i += 1;
-                    } else {
-                        char buf[8];
-                        sprintf(buf,"00%02x", 0x00FF&*i );
-                        ret += "\\u" + strty(buf);
-                    }*/
+                case '\"': out += "\\\"";break;
+                case '\\': out += "\\\\";break;
+                //case '/': out += "\\/";break;
+                case '\b': out += "\\b";break;
+                case '\n': out += "\\n";break;
+                case '\r': out += "\\r";break;
+                default: out += *i;
             }
-            ret += "\"";
-            return ret;
+            out += '\"';
+        } break;
+        default:
+            throw std::runtime_error("internal error of json type");
+    }
+}
+
+json json::FromMsgPack( const char*& begin, const char* end, int depth ) {
+    auto take = [&]( size_t n ) {
+        if( (size_t)(end - begin) < n ) throw std::runtime_error("json::FromMsgPack: unexpected end of data");
+        uint64_t value = 0;
+        for( size_t i = 0; i < n; i++ ) value = value << 8 | (uint8_t)*begin++;
+        return value;
+    };
+    auto text = [&]( size_t n ) {
+        if( (size_t)(end - begin) < n ) throw std::runtime_error("json::FromMsgPack: unexpected end of string");
+        auto ret = json(strty(begin, n));
+        begin += n;
+        return ret;
+    };
+    auto list = [&]( size_t n ) {
+        if( depth <= 0 ) throw std::runtime_error("json::FromMsgPack: nesting too deep");
+        auto ret = json(array);
+        auto& items = *(arrty*)ret.mdata;
+        for( size_t i = 0; i < n; i++ ) items.construct(-1, FromMsgPack(begin, end, depth - 1));
+        return ret;
+    };
+    auto dict = [&]( size_t n ) {
+        if( depth <= 0 ) throw std::runtime_error("json::FromMsgPack: nesting too deep");
+        auto ret = json(object);
+        auto& items = *(objty*)ret.mdata;
+        for( size_t i = 0; i < n; i++ ) {
+            auto key = FromMsgPack(begin, end, 0);
+            if( !key.is(string) ) throw std::runtime_error("json::FromMsgPack: map key is not a string");
+            items[*(strty*)key.mdata] = FromMsgPack(begin, end, depth - 1);
+        }
+        return ret;
+    };
+
+    auto byte = (uint8_t)take(1);
+    if( byte <= 0x7f ) return json((long)byte);
+    if( byte >= 0xe0 ) return json((long)(int8_t)byte);
+    if( (byte & 0xe0) == 0xa0 ) return text(byte & 0x1f);
+    if( (byte & 0xf0) == 0x90 ) return list(byte & 0x0f);
+    if( (byte & 0xf0) == 0x80 ) return dict(byte & 0x0f);
+    switch( byte ) {
+        case 0xc0: return json();
+        case 0xc2: return json(false);
+        case 0xc3: return json(true);
+        case 0xca: {
+            uint32_t bits = take(4);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return json((double)value);
+        }
+        case 0xcb: {
+            uint64_t bits = take(8);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return json(value);
         }
+        case 0xcc: return json((long)take(1));
+        case 0xcd: return json((long)take(2));
+        case 0xce: return json((long)take(4));
+        case 0xcf: return json((long)take(8));
+        case 0xd0: return json((long)(int8_t)take(1));
+        case 0xd1: return json((long)(int16_t)take(2));
+        case 0xd2: return json((long)(int32_t)take(4));
+        case 0xd3: return json((long)(int64_t)take(8));
+        case 0xd9: return text(take(1));
+        case 0xda: return text(take(2));
+        case 0xdb: return text(take(4));
+        case 0xdc: return list(take(2));
+        case 0xdd: return list(take(4));
+        case 0xde: return dict(take(2));
+        case 0xdf: return dict(take(4));
+        default: throw std::runtime_error("json::FromMsgPack: unsupported type byte " + std::to_string(byte));
+    }
+}
+
+void json::toMsgPack( strty& out )const {
+    auto put = [&]( uint8_t head, uint64_t value, size_t n ) {
+        out += (char)head;
+        for( size_t i = n; i > 0; i-- ) out += (char)(value >> (i-1)*8);
+    };
+    auto sized = [&]( size_t n, uint8_t fix, size_t fixmax, uint8_t b8, uint8_t b16, uint8_t b32 ) {
+        if( n <= fixmax ) out += (char)(fix | n);
+        else if( b8 and n <= 0xff ) put(b8, n, 1);
+        else if( n <= 0xffff ) put(b16, n, 2);
+        else put(b32, n, 4);
+    };
+
+    switch( mtype ) {
+        case null: out += (char)0xc0; break;
+        case boolean: out += (char)(*(bool*)mdata ? 0xc3 : 0xc2); break;
+        case integer: {
+            auto value = *(long*)mdata;
+            if( value >= 0 and value <= 0x7f ) out += (char)value;
+            else if( value < 0 and value >= -32 ) out += (char)value;
+            else if( value >= INT8_MIN and value <= INT8_MAX ) put(0xd0, value, 1);
+            else if( value >= INT16_MIN and value <= INT16_MAX ) put(0xd1, value, 2);
+            else if( value >= INT32_MIN and value <= INT32_MAX ) put(0xd2, value, 4);
+            else put(0xd3, value, 8);
+        } break;
+        case number: {
+            uint64_t bits;
+            memcpy(&bits, mdata, sizeof(bits));
+            put(0xcb, bits, 8);
+        } break;
+        case string: {
+            const auto& str = *(strty*)mdata;
+            sized(str.size(), 0xa0, 0x1f, 0xd9, 0xda, 0xdb);
+            out += str;
+        } break;
+        case array: {
+            const auto& list = *(arrty*)mdata;
+            sized(list.size(), 0x90, 0x0f, 0, 0xdc, 0xdd);
+            for( const auto& value : list ) value.toMsgPack(out);
+        } break;
+        case object: {
+            const auto& map = *(objty*)mdata;
+            sized(map.size(), 0x80, 0x0f, 0, 0xde, 0xdf);
+            for( const auto& [key,value] : map ) {
+                sized(key.size(), 0xa0, 0x1f, 0xd9, 0xda, 0xdb);
+                out += key;
+                value.toMsgPack(out);
+            }
+        } break;
         default:
             throw std::runtime_error("internal error of json type");
     }
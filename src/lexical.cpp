@@ -6,19 +6,104 @@
 namespace alioth {
 
 LexicalContext::LexicalContext( istream& is, bool limit ):
-  source(is),heading(limit) {
+  source(is),heading(limit),consumed(0),next(0),halted(false) {
 }
 
 tokens LexicalContext::perform() {
 
+    ret.clear();
+    ret << token(VT::R::BEG);
+    scan(1, 1);
+
+    if( state < 0 ) {
+        ret[-1].id = VT::R::END;
+    } else {
+        ret << token(VT::R::END);
+        ret[-1].bl = ret[-1].el = begl;
+        ret[-1].bc = ret[-1].ec = begc;
+    }
+    return std::move(ret);
+}
+
+int LexicalContext::Relex( string& text, tokens& toks, string after ) {
+
+    /** 不拷贝文本的输入流缓冲 */
+    struct view : public streambuf {
+        view( string& s, size_t from ) { setg(s.data() + from, s.data() + from, s.data() + s.size()); } };
+
+    if( toks.size() <= 2 ) {
+        auto buf = view(after, 0);
+        auto is = istream(&buf);
+        toks = LexicalContext(is).perform();
+        text = std::move(after);
+        return toks.size();
+    }
+
+    size_t p = 0, s = 0, limit = min(text.size(), after.size());
+    while( p < limit and text[p] == after[p] ) p++;
+    if( p == text.size() and p == after.size() ) return 0;
+    while( s < limit - p and text[text.size()-1-s] == after[after.size()-1-s] ) s++;
+    long delta = (long)after.size() - (long)text.size();
+
+    /** 从第一个结束于公共前缀末尾或之后的记号开始，此前的记号与它们之后的一个字节都没有改变 */
+    std::vector<long> starts(toks.size());
+    for( long i = 0, off = 0; i < toks.size(); off += toks[i++].tx.size() ) starts[i] = off;
+    int a = 1, end = toks.size() - 1;
+    while( a < end and starts[a] + (long)toks[a].tx.size() < (long)p ) a++;
+    long r = starts[a];
+
+    auto buf = view(after, r);
+    auto is = istream(&buf);
+    auto lc = LexicalContext(is);
+    for( int j = a + 1; j < end; j++ )
+        if( starts[j] >= (long)(text.size() - s) ) lc.stops.push_back(starts[j] + delta - r);
+    lc.scan(toks[a].bl, toks[a].bc);
+    auto fresh = std::move(lc.ret);
+
+    /** 停止点之后的旧记号整体平移，停止点所在行的列偏移只作用于同一行 */
+    int j = end;
+    if( lc.halted ) {
+        j = std::lower_bound(starts.begin(), starts.end(), r + lc.consumed - delta) - starts.begin();
+        int line = toks[j].bl, dl = lc.begl - toks[j].bl, dc = lc.begc - toks[j].bc;
+        for( int k = j; k < toks.size(); k++ ) {
+            auto& t = toks[k];
+            if( t.bl == line ) t.bc += dc;
+            if( t.el == line ) t.ec += dc;
+            t.bl += dl;
+            t.el += dl;
+        }
+    } else {
+        toks[end].bl = toks[end].el = lc.begl;
+        toks[end].bc = toks[end].ec = lc.begc;
+    }
+
+    /** 替换的记号较少时就地替换，否则重建序列，避免反复移动之后的记号 */
+    int count = fresh.size();
+    if( j - a + count <= 64 ) {
+        for( int k = j; k-- > a; ) toks.remove(k);
+        for( int k = 0; k < count; k++ ) toks.construct(a + k, std::move(fresh[k]));
+    } else {
+        tokens spliced;
+        for( int k = 0; k < a; k++ ) spliced.construct(-1, std::move(toks[k]));
+        for( auto& t : fresh ) spliced.construct(-1, std::move(t));
+        for( int k = j; k < toks.size(); k++ ) spliced.construct(-1, std::move(toks[k]));
+        toks = std::move(spliced);
+    }
+    text = std::move(after);
+    return count;
+}
+
+void LexicalContext::scan( int line, int column ) {
+
     state = 1;
     stay = false;
     synst = 1;
     T = token(VT::R::BEG);
-    ret.clear();
-    ret << std::move(T);
-    T.bl = begl = 1;
-    T.bc = begc = 1;
+    T.bl = begl = line;
+    T.bc = begc = column;
+    consumed = 0;
+    next = 0;
+    halted = false;
     
     for(pre = source.peek(); state > 0; goon() ) switch( state ) {
         case 1:
@@ -393,15 +478,6 @@ tokens LexicalContext::perform() {
             else check(VT::O::ASSIGN, false);
             break;
     }
-
-    if( state < 0 ) {
-        ret[-1].id = VT::R::END;
-    } else {
-        ret << token(VT::R::END);
-        ret[-1].bl = ret[-1].el = begl;
-        ret[-1].bc = ret[-1].ec = begc;
-    }
-    return std::move(ret);
 }
 
 
@@ -411,6 +487,7 @@ void LexicalContext::goon() {
     if( pre == '\n' ) begl += begc = 1;
     else begc += 1;
     T.tx += source.get();
+    consumed += 1;
     pre = source.peek();
 };
 
@@ -428,6 +505,13 @@ void LexicalContext::check(int t,bool s ) {
     state = ((pre==EOF)?0:1);
     stay = true;
 
+    /*增量分析时，在与旧记号对齐的边界停止*/
+    while( next < stops.size() and stops[next] < consumed ) next += 1;
+    if( state > 0 and next < stops.size() and stops[next] == consumed ) {
+        state = 0;
+        halted = true;
+    }
+
     /*微型语法分析器*/
     if( heading ) switch(t) {
         case VT::U::SPACE:case VT::U::C::LINE:case VT::U::C::BLOCK: break;
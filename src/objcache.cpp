@@ -0,0 +1,114 @@
+#ifndef __objcache_cpp__
+#define __objcache_cpp__
+
+#include "objcache.hpp"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <cerrno>
+
+namespace alioth {
+
+ObjectCache::ObjectCache( const string& path, uint64_t capacity ):dir(path),capacity(capacity) {
+    while( dir.size() > 1 and dir.back() == '/' ) dir.pop_back();
+}
+
+bool ObjectCache::open() {
+    if( dir.empty() ) return false;
+    for( size_t i = 1; i <= dir.size(); i++ ) {
+        if( i < dir.size() and dir[i] != '/' ) continue;
+        if( mkdir(dir.substr(0,i).data(), 0755) != 0 and errno != EEXIST ) return false;
+    }
+    struct stat st;
+    if( stat(dir.data(), &st) != 0 or !S_ISDIR(st.st_mode) ) return false;
+    return access(dir.data(), R_OK|W_OK|X_OK) == 0;
+}
+
+bool ObjectCache::fetch( const string& key, string& content ) {
+    auto path = locate(key);
+    auto is = ifstream(path, ios::binary);
+    if( !is ) return stats.misses += 1, false;
+
+    auto buf = stringstream();
+    buf << is.rdbuf();
+    if( is.bad() ) return stats.misses += 1, false;
+    content = buf.str();
+
+    utimensat(AT_FDCWD, path.data(), nullptr, 0);
+    stats.hits += 1;
+    return true;
+}
+
+bool ObjectCache::store( const string& key, const string& content ) {
+    static atomic<int> sequence = 0;
+    auto temp = dir + "/." + key + "." + to_string(getpid()) + "." + to_string(sequence++) + ".tmp";
+    {
+        auto os = ofstream(temp, ios::binary|ios::trunc);
+        if( !os ) return false;
+        os.write(content.data(), content.size());
+        os.close();
+        if( !os ) return unlink(temp.data()), false;
+    }
+    if( rename(temp.data(), locate(key).data()) != 0 ) return unlink(temp.data()), false;
+
+    stats.stores += 1;
+    return true;
+}
+
+const ObjectCache::statistics& ObjectCache::getStatistics()const {
+    return stats;
+}
+
+const string& ObjectCache::getPath()const {
+    return dir;
+}
+
+void ObjectCache::trim() {
+    auto d = opendir(dir.data());
+    if( !d ) return;
+
+    vector<tuple<time_t,long,string,uint64_t>> entries;
+    uint64_t total = 0;
+    auto now = time(nullptr);
+    while( auto e = readdir(d) ) {
+        string name = e->d_name;
+        auto path = dir + "/" + name;
+        struct stat st;
+        if( stat(path.data(), &st) != 0 or !S_ISREG(st.st_mode) ) continue;
+
+        /** 临时文件由正在写入的进程负责，仅清理一天前遗留的 */
+        if( name.size() > 4 and name[0] == '.' and name.substr(name.size()-4) == ".tmp" ) {
+            if( now - st.st_mtime > 24*60*60 ) unlink(path.data());
+            continue;
+        }
+        if( name.size() <= 2 or name.substr(name.size()-2) != ".o" ) continue;
+        entries.emplace_back(st.st_mtim.tv_sec, st.st_mtim.tv_nsec, path, st.st_size);
+        total += st.st_size;
+    }
+    closedir(d);
+
+    if( total <= capacity ) return;
+    sort(entries.begin(), entries.end());
+    for( auto& [sec,nsec,path,size] : entries ) {
+        if( total <= capacity ) break;
+        if( unlink(path.data()) != 0 ) continue;
+        total -= size;
+        stats.evictions += 1;
+    }
+}
+
+string ObjectCache::locate( const string& key )const {
+    return dir + "/" + key + ".o";
+}
+
+}
+
+#endif
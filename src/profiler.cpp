@@ -0,0 +1,255 @@
+#ifndef __profiler_cpp__
+#define __profiler_cpp__
+
+#include "profiler.hpp"
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdio>
+
+namespace alioth {
+
+thread_local Profiler::scope* Profiler::current = nullptr;
+thread_local Profiler::track* Profiler::tracked = nullptr;
+thread_local Profiler::table* Profiler::counted = nullptr;
+
+/** 当前线程的轨道和累积表所属的剖析器 */
+static thread_local Profiler* tracking = nullptr;
+static thread_local Profiler* counting = nullptr;
+
+Profiler::scope::scope( Profiler* owner, const string& phase, const string& module ):
+owner(owner and owner->enabled ? owner : nullptr),saved(current) {
+    if( !this->owner ) return;
+    if( owner->tracing ) this->phase = phase, this->module = module;
+    current = this;
+    slot = &owner->account(phase, module);
+    start = clock::now();
+}
+
+Profiler::scope::scope( const string& phase ):
+scope(current ? current->owner : nullptr, phase, current and current->slot ? current->slot->local.module : string()) {
+}
+
+Profiler::scope::~scope() {
+    if( !owner ) return;
+    auto time = clock::now() - start;
+    current = saved;
+    auto& e = slot->local;
+    e.time += time;
+    e.calls += 1;
+    for( int c = 0; c < COUNTERS; c++ ) e.counters[c] += counters[c];
+    if( owner->tracing ) owner->trace({move(phase), move(module), start, time});
+}
+
+void Profiler::enable() {
+    enabled = true;
+    origin = clock::now();
+}
+
+bool Profiler::isEnabled()const {
+    return enabled;
+}
+
+void Profiler::enableTracing() {
+    if( !enabled ) enable();
+    tracing = true;
+}
+
+bool Profiler::isTracing()const {
+    return tracing;
+}
+
+Profiler::scope Profiler::measure( const string& phase, const string& module ) {
+    return scope(this, phase, module);
+}
+
+Profiler::entry& Profiler::locate( const string& phase, const string& module ) {
+    auto it = phases.begin();
+    while( it != phases.end() and it->name != phase ) ++it;
+    auto& p = it != phases.end() ? *it : phases.emplace_back();
+    if( p.name.empty() ) p.name = phase;
+    if( module.empty() ) return p.total;
+
+    auto& e = p.index[module];
+    if( !e ) e = &p.modules.emplace_back(entry{module});
+    return *e;
+}
+
+Profiler::table::slot& Profiler::account( const string& phase, const string& module ) {
+    if( !counted or counting != this ) {
+        lock_guard guard(lock);
+        counted = tables.emplace_back(make_unique<table>()).get();
+        counting = this;
+    }
+
+    auto& t = *counted;
+    auto& modules = t.index[phase];
+    if( auto it = modules.find(module); it != modules.end() ) return *it->second;
+    entry* target;
+    {
+        lock_guard guard(lock);
+        target = &locate(phase, module);
+    }
+    auto& s = t.slots.emplace_back(table::slot{target, entry{module}});
+    return *(modules[module] = &s);
+}
+
+void Profiler::collect()const {
+    for( auto& t : tables ) for( auto& s : t->slots ) {
+        s.target->time += s.local.time;
+        s.target->calls += s.local.calls;
+        for( int c = 0; c < COUNTERS; c++ ) s.target->counters[c] += s.local.counters[c];
+        s.local.time = {};
+        s.local.calls = 0;
+        s.local.counters = {};
+    }
+}
+
+void Profiler::trace( event&& e ) {
+    if( !tracked or tracking != this ) {
+        lock_guard guard(lock);
+        tracked = tracks.emplace_back(make_unique<track>()).get();
+        tracked->tid = syscall(SYS_gettid);
+        tracking = this;
+    }
+
+    auto& t = *tracked;
+    if( t.events.size() < TrackCapacity ) {
+        t.events.push_back(move(e));
+    } else {
+        t.events[t.next] = move(e);
+        t.next = (t.next + 1) % TrackCapacity;
+        t.dropped += 1;
+    }
+}
+
+/** 以毫秒表示用时，保留三位小数 */
+static double Milliseconds( Profiler::clock::duration d ) {
+    return chrono::duration_cast<chrono::microseconds>(d).count() / 1000.0;
+}
+
+/** 汇总阶段的条目：计数包含所有模块的计数，阶段自身未被度量时用时为各模块用时之和 */
+static Profiler::entry Summarize( const Profiler::phase& p ) {
+    auto total = p.total;
+    for( auto& m : p.modules ) for( int c = 0; c < Profiler::COUNTERS; c++ ) total.counters[c] += m.counters[c];
+    if( total.calls == 0 ) for( auto& m : p.modules ) total.time += m.time, total.calls += m.calls;
+    return total;
+}
+
+string Profiler::toTable()const {
+    lock_guard guard(lock);
+    collect();
+    string res;
+    char line[256];
+    auto row = [&]( const string& phase, const string& module, const entry& e ) {
+        snprintf(line, sizeof(line), "%-16s %-24s %6ld %12.3f", phase.data(), module.data(), e.calls, Milliseconds(e.time));
+        res += line;
+        for( int c = 0; c < COUNTERS; c++ ) snprintf(line, sizeof(line), " %10ld", e.counters[c]), res += line;
+        res += '\n';
+    };
+
+    snprintf(line, sizeof(line), "%-16s %-24s %6s %12s", "phase", "module", "calls", "time(ms)");
+    res += line;
+    for( int c = 0; c < COUNTERS; c++ ) snprintf(line, sizeof(line), " %10s", CounterName((counter)c)), res += line;
+    res += '\n';
+
+    for( auto& p : phases ) {
+        row(p.name, "*", Summarize(p));
+        for( auto& m : p.modules ) row("", m.module, m);
+    }
+
+    snprintf(line, sizeof(line), "%-16s %-24s %6s %12.3f\n", "total", "*", "", Milliseconds(clock::now() - origin));
+    return res += line;
+}
+
+json Profiler::toJson()const {
+    lock_guard guard(lock);
+    collect();
+    auto item = [&]( const entry& e ) {
+        json res = json::object;
+        res["calls"] = e.calls;
+        res["time"] = Milliseconds(e.time);
+        json cs = json::object;
+        for( int c = 0; c < COUNTERS; c++ ) cs[CounterName((counter)c)] = e.counters[c];
+        res["counters"] = cs;
+        return res;
+    };
+
+    json list = json::array;
+    for( auto& p : phases ) {
+        json modules = json::array;
+        for( auto& m : p.modules ) {
+            auto mi = item(m);
+            mi["module"] = m.module;
+            modules[modules.count()] = mi;
+        }
+        auto pi = item(Summarize(p));
+        pi["phase"] = p.name;
+        pi["modules"] = modules;
+        list[list.count()] = pi;
+    }
+
+    json res = json::object;
+    res["time"] = Milliseconds(clock::now() - origin);
+    res["phases"] = list;
+    return res;
+}
+
+void Profiler::writeTrace( ostream& os )const {
+    lock_guard guard(lock);
+    auto us = []( clock::duration d ) { return chrono::duration_cast<chrono::nanoseconds>(d).count() / 1000.0; };
+    auto pid = (long)getpid();
+    long dropped = 0;
+    char buf[128];
+    string res = "{\"traceEvents\":[";
+    bool first = true;
+
+    for( auto& t : tracks ) {
+        dropped += t->dropped;
+        snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", pid, t->tid, t->tid == pid ? "main" : "worker");
+        res += buf;
+        first = false;
+
+        /** 环形缓冲中最早的事件位于next处 */
+        for( size_t k = 0; k < t->events.size(); k++ ) {
+            auto& e = t->events[(t->next + k) % t->events.size()];
+            res += ",{\"name\":";
+            json(e.module.empty() ? e.phase : e.phase + " " + e.module).toJsonString(res);
+            res += ",\"cat\":";
+            json(e.phase).toJsonString(res);
+            snprintf(buf, sizeof(buf), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld",
+                us(e.start - origin), us(e.time), pid, t->tid);
+            res += buf;
+            if( e.module.size() ) {
+                res += ",\"args\":{\"module\":";
+                json(e.module).toJsonString(res);
+                res += '}';
+            }
+            res += '}';
+            if( res.size() > (1 << 16) ) os.write(res.data(), res.size()), res.clear();
+        }
+    }
+
+    snprintf(buf, sizeof(buf), "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%ld}}\n", dropped);
+    res += buf;
+    os.write(res.data(), res.size());
+}
+
+void Profiler::Count( counter c, long n ) {
+    if( current ) current->counters[c] += n;
+}
+
+const char* Profiler::CounterName( counter c ) {
+    switch( c ) {
+        case BYTES: return "bytes";
+        case TOKENS: return "tokens";
+        case NODES: return "nodes";
+        case LOOKUPS: return "lookups";
+        case INSTANCES: return "instances";
+        default: return "";
+    }
+}
+
+}
+
+#endif
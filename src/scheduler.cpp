@@ -0,0 +1,88 @@
+#ifndef __scheduler_cpp__
+#define __scheduler_cpp__
+
+#include "scheduler.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <exception>
+
+namespace alioth {
+
+int Scheduler::submit( task t, const set<int>& deps ) {
+    int id = jobs.size();
+    jobs.push_back({t,{},0});
+    for( auto dep : deps ) {
+        if( dep < 0 or dep >= id ) continue;
+        jobs[dep].next.push_back(id);
+        jobs[id].padding += 1;
+    }
+    return id;
+}
+
+bool Scheduler::perform( int workers ) {
+    bool success = true;
+    deque<int> ready;
+    for( size_t i = 0; i < jobs.size(); i++ ) if( jobs[i].padding == 0 ) ready.push_back(i);
+
+    if( workers <= 1 or jobs.size() <= 1 ) {
+        while( ready.size() ) {
+            auto& j = jobs[ready.front()];
+            ready.pop_front();
+            success = j.run() and success;
+            for( auto n : j.next ) if( --jobs[n].padding == 0 ) ready.push_back(n);
+        }
+        jobs.clear();
+        return success;
+    }
+
+    mutex lock;
+    condition_variable cv;
+    exception_ptr error;
+    int running = 0;
+
+    auto work = [&] {
+        auto guard = unique_lock<mutex>(lock);
+        while( true ) {
+            cv.wait(guard, [&]{ return ready.size() or running == 0; });
+            if( ready.empty() ) return;
+            auto& j = jobs[ready.front()];
+            ready.pop_front();
+            running += 1;
+
+            guard.unlock();
+            bool r = false;
+            try {
+                r = j.run();
+            } catch( ... ) {
+                auto g = lock_guard<mutex>(lock);
+                if( !error ) error = current_exception();
+            }
+            guard.lock();
+
+            running -= 1;
+            success = r and success;
+            for( auto n : j.next ) if( --jobs[n].padding == 0 ) ready.push_back(n);
+            cv.notify_all();
+        }
+    };
+
+    vector<thread> threads;
+    for( int i = 0; i < workers; i++ ) threads.emplace_back(work);
+    for( auto& t : threads ) t.join();
+
+    jobs.clear();
+    if( error ) rethrow_exception(error);
+    return success;
+}
+
+int Scheduler::Concurrency( int jobs ) {
+    if( jobs > 0 ) return jobs;
+    auto hc = (int)thread::hardware_concurrency();
+    return hc > 0 ? hc : 1;
+}
+
+}
+
+#endif
@@ -2,9 +2,16 @@
 #define __semantic_cpp__
 
 #include "semantic.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
 
 namespace alioth {
 
+thread_local Diagnostics* SemanticContext::diagnostics_channel::bound = nullptr;
+thread_local chainz<$scope> SemanticContext::searching_layers;
+thread_local chainz<$aliasdef> SemanticContext::alias_searching_layers;
+thread_local SemanticContext::record* SemanticContext::recording = nullptr;
+
 module::module( SemanticContext& context ):sctx(context) {
 
 }
@@ -42,6 +49,7 @@ bool SemanticContext::associateModule( $signature sig ) {
         auto fg = rec.fg;
         defs += fg->defs;
         mod->impls += fg->impls;
+        mod->frags << fg;
         fg->setScope(mod);
     }
 
@@ -51,14 +59,14 @@ bool SemanticContext::associateModule( $signature sig ) {
         if( auto cdef = ($classdef)def; cdef and (string)cdef->name == (string)mod->sig->name ) {
             if( mod->trans )
                 success = (diagnostics
-                    [cdef->getDocUri()]("77", cdef->name)
-                    [-1](mod->trans->getDocUri(),"45",mod->trans->name), false);
+                    [cdef->getDocPrefix()]("77", cdef->name)
+                    [-1](mod->trans->getDocPrefix(),"45",mod->trans->name), false);
             if( cdef->targf.size() )
-                success = (diagnostics[cdef->getDocUri()]("74", cdef->name), false);
+                success = (diagnostics[cdef->getDocPrefix()]("74", cdef->name), false);
             if( cdef->abstract )
-                success = (diagnostics[cdef->getDocUri()]("75", cdef->name), false);
+                success = (diagnostics[cdef->getDocPrefix()]("75", cdef->name), false);
             if( cdef->supers.size() )
-                success = (diagnostics[cdef->getDocUri()]("76", cdef->name), false);
+                success = (diagnostics[cdef->getDocPrefix()]("76", cdef->name), false);
             if( success ) {
                 mod->trans = def;
                 defs.remove(i--);
@@ -75,11 +83,11 @@ bool SemanticContext::associateModule( $signature sig ) {
 
     for( auto def : mod->trans->defs ) {
         if( auto opd = ($opdef)def; opd ) {
-            diagnostics[def->getDocUri()]("119", def->name), success = false;
+            diagnostics[def->getDocPrefix()]("119", def->name), success = false;
         } else if( auto md = ($metdef)def; md ) {
             if( !md->meta ) {
                 md->meta = token(VT::META);
-                diagnostics[def->getDocUri()]("120", def->name);
+                diagnostics[def->getDocPrefix()]("120", def->name);
             }
         }
     }
@@ -96,11 +104,19 @@ bool SemanticContext::associateModules( signatures all ) {
 }
 
 bool SemanticContext::releaseModule( $signature sig ) {
+    if( auto mod = getModule(sig); mod ) {
+        definition_records.erase(mod);
+        for( auto impl : mod->impls ) implementation_records.erase(impl);
+    }
     return forest.erase(sig);
 }
 
 void SemanticContext::releaseModules( signatures sigs ) {
-    for( auto sig : sigs ) releaseModule(sig);
+    for( auto sig : sigs ) {
+        releaseModule(sig);
+        interfaces.erase(sig);
+        revisions.erase(sig);
+    }
 }
 
 $module SemanticContext::getModule( $signature sig ) {
@@ -110,8 +126,10 @@ $module SemanticContext::getModule( $signature sig ) {
 }
 
 $module SemanticContext::getModule( $depdesc dep ) {
-    auto it = dep_cache.find(dep);
-    if( it != dep_cache.end() ) return it->second;
+    if( auto guard = lock_guard<mutex>(cache_lock); true ) {
+        auto it = dep_cache.find(dep);
+        if( it != dep_cache.end() ) return it->second;
+    }
 
     auto sig = ($signature)dep->getScope();
     if( !sig ) return internal_error, nullptr;
@@ -149,39 +167,178 @@ $module SemanticContext::getModule( $depdesc dep ) {
     }
 
     if( !result ) return internal_error, nullptr;
+    auto guard = lock_guard<mutex>(cache_lock);
+    dep_cache[dep] = result;
     return result;
 }
 
 void SemanticContext::clearCache() {
     symbol_cache.clear();
+    symbol_ids.clear();
+    symbol_pool.clear();
     dep_cache.clear();
     searching_layers.clear();
     alias_searching_layers.clear();
 }
 
-bool SemanticContext::validateDefinitionSemantics() {
+void SemanticContext::setConcurrency( int jobs ) {
+    concurrency = jobs;
+}
+
+void SemanticContext::setProfiler( Profiler* p ) {
+    profiler = p;
+}
+
+bool SemanticContext::validateDefinitionSemantics( const DependencyGraph& graph ) {
     bool success = true;
+    auto timing = Profiler::scope(profiler, "definition", "");
+    auto scheduler = Scheduler();
+    map<$module,int> tasks;
+
+    /** 预先建立表项，任务执行期间每个任务只修改属于自己的表项 */
+    for( auto [sig,mod] : forest ) {
+        interfaces[sig];
+        revisions[sig];
+        if( mod ) definition_records[mod];
+    }
+
+    /** 依赖先于依赖者提交，使得依赖的定义检查完成后才检查依赖者的定义 */
+    function<int($module)> submit = [&]( $module mod ) {
+        if( auto it = tasks.find(mod); it != tasks.end() ) return it->second;
+        tasks[mod] = -1;
+        set<int> deps;
+        modules dmods;
+        if( graph.contains(mod->sig) ) for( auto& e : graph.dependencies(mod->sig) ) dmods << getModule(e.to);
+        else for( auto dep : mod->sig->deps ) dmods << getModule(dep); // 全交互模式下此前请求遗留的模块不在图中
+        for( auto dmod : dmods ) if( dmod and dmod != mod ) deps.insert(submit(dmod));
+        auto& rec = definition_records[mod];
+        return tasks[mod] = scheduler.submit([this,mod,&rec]{
+            if( reusable(rec) ) return rec.success;
+            if( rec.valid ) {
+                auto guard = lock_guard<mutex>(cache_lock);
+                stale.insert(mod->sig);
+                return true;
+            }
+            auto bind = diagnostics_channel::binding(rec.ds);
+            auto rcd = record::binding(rec);
+            auto timing = Profiler::scope(profiler, "definition", mod->sig->name.tx);
+            auto success = validateModuleDefinition(mod);
+            renewInterface(mod);
+            rec.refs.erase(mod); // 模块自身的改变总是伴随着语法树的替换
+            seal(rec, success);
+            for( auto& [ref,_] : rec.refs ) mod->referenced.insert(ref);
+            for( auto& ref : rec.usages ) if( ref != mod ) mod->referenced.insert(ref);
+            return success;
+        }, deps);
+    };
+
     for( auto [sig,mod] : forest )
-        success = mod and validateModuleDefinition(mod) and success;
+        if( !mod ) success = false;
+        else submit(mod);
+    success = scheduler.perform(Scheduler::Concurrency(concurrency)) and success;
+
+    /** 实现的检查结论不能复用时，模块同样需要重新构造语法树 */
+    for( auto [sig,mod] : forest ) if( mod and !stale.count(sig) )
+        for( auto impl : mod->impls )
+            if( auto it = implementation_records.find(impl); it != implementation_records.end() )
+                if( it->second.valid and !reusable(it->second) ) {
+                    stale.insert(sig);
+                    break;
+                }
+    if( stale.size() ) return success;
+
+    /** 按照森林的顺序合并诊断信息 */
+    for( auto [sig,mod] : forest )
+        if( mod ) diagnostics += definition_records[mod].ds;
     return success;
 }
 
 bool SemanticContext::validateImplementationSemantics() {
     bool success = true;
+    auto timing = Profiler::scope(profiler, "implementation", "");
+    auto scheduler = Scheduler();
+    chainz<record*> slots;
+
+    /** 所有定义都已检查完毕，实现之间互不依赖 */
     for( auto [sig,mod] : forest ) {
         if( !mod ) {
             success = false;
         } else for( auto impl : mod->impls ) {
-            if( auto op = ($opimpl)impl; op ) success = validateOperatorImplementation(op) and success;
-            else if( auto mt = ($metimpl)impl; mt ) success = validateMethodImplementation(mt) and success;
-            else internal_error, success = false;
+            auto& rec = implementation_records[impl];
+            slots << &rec;
+            scheduler.submit([this,impl,&rec]{
+                if( reusable(rec) ) return rec.success;
+                auto bind = diagnostics_channel::binding(rec.ds);
+                auto rcd = record::binding(rec);
+                auto timing = Profiler::scope(profiler, "implementation", impl->getModule()->sig->name.tx);
+                bool success = false;
+                if( auto op = ($opimpl)impl; op ) success = validateOperatorImplementation(op);
+                else if( auto mt = ($metimpl)impl; mt ) success = validateMethodImplementation(mt);
+                else internal_error;
+                seal(rec, success);
+                return success;
+            });
         }
     }
+    success = scheduler.perform(Scheduler::Concurrency(concurrency)) and success;
+
+    for( auto rec : slots ) diagnostics += rec->ds;
+    for( auto [sig,mod] : forest ) if( mod ) for( auto impl : mod->impls ) {
+        auto& rec = implementation_records[impl];
+        for( auto& [ref,_] : rec.refs ) if( ref != mod ) mod->referenced.insert(ref);
+        for( auto& ref : rec.usages ) if( ref != mod ) mod->referenced.insert(ref);
+    }
     return success;
 }
 
+const string& SemanticContext::getInterface( $signature sig ) {
+    static const string none;
+    auto it = interfaces.find(sig);
+    if( it == interfaces.end() ) return none;
+    return it->second;
+}
+
+signatures SemanticContext::collectStaleModules() {
+    signatures result;
+    for( auto sig : stale ) result << sig;
+    stale.clear();
+    return result;
+}
+
+bool SemanticContext::reusable( const record& rec ) {
+    if( !rec.valid ) return false;
+    /** 被引用的模块即使替换了语法树，只要接口没有改变，旧的语法树就仍然可以被引用 */
+    for( auto& [mod,rev] : rec.refs ) {
+        auto it = revisions.find(mod->sig);
+        if( it == revisions.end() or it->second != rev or !getModule(mod->sig) ) return false;
+    }
+    /** 模板类用例产生在模板类所在的语法树中，语法树被替换后用例随之消失 */
+    for( auto& mod : rec.usages )
+        if( getModule(mod->sig) != mod ) return false;
+    return true;
+}
+
+void SemanticContext::seal( record& rec, bool success ) {
+    for( auto& [mod,rev] : rec.refs )
+        if( auto it = revisions.find(mod->sig); it != revisions.end() ) rev = it->second;
+    rec.success = success;
+    rec.valid = true;
+}
+
+void SemanticContext::renewInterface( $module mod ) {
+    string iface;
+    Diagnostics ignored; // 归约过程中遭遇的错误已经在检查中报告过
+    if( auto bind = diagnostics_channel::binding(ignored); true )
+        WriteInterface(($definition)mod->trans, iface);
+    if( auto& prev = interfaces[mod->sig]; prev != iface ) {
+        prev = move(iface);
+        revisions[mod->sig] += 1;
+    }
+}
+
 bool SemanticContext::validateModuleDefinition( $module mod ) {
     bool success = true;
+    auto table = definition_table(*this, false);
 
     /** 检查定义语义以及重复定义 */
     for( auto& def : mod->trans->defs ) {
@@ -195,21 +352,7 @@ bool SemanticContext::validateModuleDefinition( $module mod ) {
         else internal_error, success = false;
 
         /** 检查重复定义 */
-        for( auto& prv : mod->trans->defs ) {
-            if( &def == &prv ) break;
-            if( def->name != prv->name ) continue;
-            bool repeat = true;
-
-            string dname = GetBinarySymbol(($node)def);
-            string pname = GetBinarySymbol(($node)prv);
-            if( def->is(node::METHODDEF) and prv->is(node::METHODDEF) ) repeat = dname == pname;
-
-            if( repeat ) {
-                diagnostics[def->getDocUri()]("98", def->name, dname)
-                [-1](prv->getDocUri(), "45", prv->name);
-                success = false;
-            }
-        }
+        success = table.insert(def) and success;
 
         if( mod->sig->entry ) {
             auto i32 = eprototype::make(mod,token("int32"), 
@@ -247,10 +390,10 @@ bool SemanticContext::validateClassDefinition(  $classdef cls ) {
             for( auto prei : pred ) if( prei.type ) {
                 if( !$(prei.type) ) {
                     success = false;
-                    diagnostics[cls->getDocUri()]("107", prei.vn);
+                    diagnostics[cls->getDocPrefix()]("107", prei.vn);
                 } else if( prei.type->is_type(PointerTypeMask) ) {
                     success = false;
-                    diagnostics[cls->getDocUri()]("108", prei.vn);
+                    diagnostics[cls->getDocPrefix()]("108", prei.vn);
                 }
             }
         if( !cls->targs.size() ) return success;
@@ -260,19 +403,20 @@ bool SemanticContext::validateClassDefinition(  $classdef cls ) {
     for( auto super : cls->supers ) {
         auto res = $(super);
         if( res.size() != 1 ) {
-            diagnostics[cls->getDocUri()]("82", super->phrase);
+            diagnostics[cls->getDocPrefix()]("82", super->phrase);
             success = false;
             continue;
         }
         auto def = ($classdef)res[0];
         if( !def or !CanBeInstanced(def) ) {
-            diagnostics[cls->getDocUri()]("83", super->phrase);
+            diagnostics[cls->getDocPrefix()]("83", super->phrase);
             success = false;
             continue;
         }
     }
 
     /** 检查定义语义以及重复定义 */
+    auto table = definition_table(*this, true);
     for( auto& def : cls->defs ) {
 
         if( auto cldef = ($classdef)def; cldef ) success = validateClassDefinition(cldef) and success;
@@ -284,27 +428,7 @@ bool SemanticContext::validateClassDefinition(  $classdef cls ) {
         else internal_error, success = false;
 
         /** 检查重复定义 */
-        for( auto& prv : cls->defs ) {
-            if( &def == &prv ) break;
-            if( def->name != prv->name ) continue;
-            bool repeat = true;
-
-            string dname = GetBinarySymbol(($node)def);
-            string pname = GetBinarySymbol(($node)prv);
-            if( def->is(node::METHODDEF) and prv->is(node::METHODDEF) ) {
-                repeat = (dname == pname);
-            } else if( def->is(node::OPERATORDEF) and prv->is(node::OPERATORDEF) ) {
-                auto odef = ($opdef)def, oprv = ($opdef)prv;
-                if( !odef->modifier.is(VT::DELETE) and !oprv->modifier.is(VT::DELETE) )
-                    repeat = (dname == pname);
-            }
-
-            if( repeat ) {
-                diagnostics[def->getDocUri()]("98", def->name, dname)
-                [-1](prv->getDocUri(), "45", prv->name);
-                success = false;
-            }
-        }
+        success = table.insert(def) and success;
     }
 
     /** 检查循环包含 */
@@ -317,7 +441,7 @@ bool SemanticContext::validateClassDefinition(  $classdef cls ) {
                 auto sdef = ReachClass(super);
                 if( !sdef ) return internal_error, false;
                 if( !check( sdef, paddings + classdefs{def} ) ) {
-                    if( paddings.size() == 0 ) diagnostics[def->getDocUri()]("91", super->phrase );
+                    if( paddings.size() == 0 ) diagnostics[def->getDocPrefix()]("91", super->phrase );
                     return false;
                 }
             }
@@ -328,7 +452,7 @@ bool SemanticContext::validateClassDefinition(  $classdef cls ) {
                     $(attr);
                     if( attr->etype == eprototype::obj and attr->dtype->is_type(StructType) )
                         if( !check( ($classdef)attr->dtype->sub, paddings + classdefs{def}) ) {
-                            if( paddings.size() == 0 ) diagnostics[def->getDocUri()]("92", attr->phrase);
+                            if( paddings.size() == 0 ) diagnostics[def->getDocPrefix()]("92", attr->phrase);
                             return false;
                         }
                 }
@@ -368,16 +492,16 @@ bool SemanticContext::validateAttributeDefinition(  $attrdef def ) {
         success = false;
     } else if( def->proto->etype == eprototype::obj and def->proto->dtype->is_type(PointerTypeMask) ) {
         success = false;
-        diagnostics[def->getDocUri()]("42", def->phrase);
+        diagnostics[def->getDocPrefix()]("42", def->phrase);
     } else if( def->proto->etype == eprototype::ptr and !def->proto->dtype->is_type(PointerTypeMask) ) {
         success = false;
-        diagnostics[def->getDocUri()]("42", def->phrase);
+        diagnostics[def->getDocPrefix()]("42", def->phrase);
     } else if( def->proto->etype == eprototype::rel ) {
         success = false;
-        diagnostics[def->getDocUri()]("117", def->proto->phrase);
+        diagnostics[def->getDocPrefix()]("117", def->proto->phrase);
     } else if( def->proto->etype == eprototype::ref and def->arr.size() ) {
         success = false;
-        diagnostics[def->getDocUri()]("118", def->phrase);
+        diagnostics[def->getDocPrefix()]("118", def->phrase);
     }
 
     return success;
@@ -403,61 +527,61 @@ bool SemanticContext::validateOperatorDefinition(  $opdef def ) {
         PVT::INDEX ) ) {
             if( def->modifier.is(PVT::PREFIX,PVT::SUFFIX,VT::DEFAULT,VT::DELETE) ) {
                 success = false;
-                diagnostics[def->getDocUri()]("99", def->modifier);
+                diagnostics[def->getDocPrefix()]("99", def->modifier);
             }
             if( def->arguments.size() != 1 or def->va_arg ) {
                 success = false;
-                diagnostics[def->getDocUri()]("100", def->name);
+                diagnostics[def->getDocPrefix()]("100", def->name);
             }
     } else if( def->name.is(PVT::NOT,PVT::NEGATIVE,PVT::BITREV) ) {
         if( def->modifier ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
         if( def->arguments.size() != 1 or def->va_arg ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         }
     } else if( def->name.is(PVT::INCREMENT,PVT::DECREMENT) ) {
         if( !def->modifier or def->modifier.is(PVT::REV,PVT::ISM,VT::DELETE,VT::DEFAULT) ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
         if( def->arguments.size() != 0 or def->va_arg ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         }
     } else if( def->name.is(PVT::ASSIGN,PVT::CCTOR,PVT::MCTOR) ) {
         if( def->modifier.is(VT::DEFAULT) ) {
             if( def->name.is(PVT::CCTOR,PVT::MCTOR ) ) {
                 success = false;
-                diagnostics[def->getDocUri()]("100", def->name);
+                diagnostics[def->getDocPrefix()]("100", def->name);
             }
         } else if( def->modifier.is(VT::DELETE) ) {
             if(  def->name.is(PVT::ASSIGN) ) {
                 success = false;
-                diagnostics[def->getDocUri()]("100", def->name);
+                diagnostics[def->getDocPrefix()]("100", def->name);
             }
         } else {
             if( def->modifier ) {
                 success = false;
-                diagnostics[def->getDocUri()]("99", def->modifier);
+                diagnostics[def->getDocPrefix()]("99", def->modifier);
             }
             if( def->arguments.size() != 1 or def->va_arg ) {
                 success = false;
-                diagnostics[def->getDocUri()]("100", def->name);
+                diagnostics[def->getDocPrefix()]("100", def->name);
             } else if( auto proto = $(def->arguments[0]->proto); proto ) {
                 if( !proto->dtype->is_type(StructType) or proto->dtype->sub != def->getScope() ) {
-                    diagnostics[def->getDocUri()]("101", proto->dtype->phrase);
+                    diagnostics[def->getDocPrefix()]("101", proto->dtype->phrase);
                     success = false;
                 } else if( def->name.is(PVT::CCTOR) ) {
                     if( proto->etype != eprototype::obj or !proto->cons ) {
-                        diagnostics[def->getDocUri()]("101", proto->phrase );
+                        diagnostics[def->getDocPrefix()]("101", proto->phrase );
                         success = false;
                     }
                 } else if( def->name.is(PVT::MCTOR) ) {
                     if( proto->etype != eprototype::rel or proto->cons ) {
-                        diagnostics[def->getDocUri()]("101", proto->phrase );
+                        diagnostics[def->getDocPrefix()]("101", proto->phrase );
                         success = false;
                     }
                 }
@@ -467,43 +591,43 @@ bool SemanticContext::validateOperatorDefinition(  $opdef def ) {
         PVT::ASSIGN_SHL,PVT::ASSIGN_SHR,PVT::ASSIGN_BITAND,PVT::ASSIGN_BITOR,PVT::ASSIGN_BITXOR ) ) {
             if( def->modifier ) {
                 success = false;
-                diagnostics[def->getDocUri()]("99", def->modifier);
+                diagnostics[def->getDocPrefix()]("99", def->modifier);
             }
             if( def->arguments.size() != 1 or def->va_arg ) {
                 success = false;
-                diagnostics[def->getDocUri()]("100", def->name);
+                diagnostics[def->getDocPrefix()]("100", def->name);
             }
     } else if( def->name.is(PVT::SCTOR,PVT::LCTOR) ) {
         if( def->modifier and !def->modifier.is(VT::DEFAULT) ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
     } else if( def->name.is(PVT::DTOR) ) {
         if( def->modifier ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
         if( def->arguments.size() != 0 or def->va_arg ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         }
     } else if( def->name.is(PVT::AS,PVT::MEMBER,PVT::ASPECT) ) {
         if( def->modifier ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
         if( def->name.is(PVT::MEMBER) and (def->arguments.size() > 1 or def->va_arg) ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         } else if( def->name.is(PVT::AS) and (def->arguments.size() != 0 or def->va_arg) ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         }
     } else if( def->name.is(PVT::MOVE) ) {
         //应当允许重载两个move运算符，无参数版本用于move动作之后，带指针参数版本用于move动作之前
         if( def->modifier ) {
             success = false;
-            diagnostics[def->getDocUri()]("99", def->modifier);
+            diagnostics[def->getDocPrefix()]("99", def->modifier);
         }
         if( def->arguments.size() == 1 ) {
             auto proto  =$(def->arguments[0]->proto);
@@ -518,11 +642,11 @@ bool SemanticContext::validateOperatorDefinition(  $opdef def ) {
                 } else {
                     bad = true;
                 }
-                if( bad ) diagnostics[def->getDocUri()]("101", def->arguments[0]->phrase);
+                if( bad ) diagnostics[def->getDocPrefix()]("101", def->arguments[0]->phrase);
             }
         } else if( def->arguments.size() > 1 ) {
             success = false;
-            diagnostics[def->getDocUri()]("100", def->name);
+            diagnostics[def->getDocPrefix()]("100", def->name);
         }
     } else {
         return internal_error, false;
@@ -530,12 +654,12 @@ bool SemanticContext::validateOperatorDefinition(  $opdef def ) {
 
     for( auto arg : def->arguments ) if( !$(arg->proto) ) {
         success = false;
-        diagnostics[arg->proto->getDocUri()]("102", arg->proto->phrase );
+        diagnostics[arg->proto->getDocPrefix()]("102", arg->proto->phrase );
     }
 
     if( def->ret_proto and !$(def->ret_proto) ) {
         success = false;
-        diagnostics[def->getDocUri()]("103", def->ret_proto->phrase);
+        diagnostics[def->getDocPrefix()]("103", def->ret_proto->phrase);
     }
 
     return success;
@@ -546,7 +670,7 @@ bool SemanticContext::validateMethodImplementation( $metimpl impl ) {
 
     auto host = ReachClass(impl->host);
     if( !host ) {
-        diagnostics[impl->getDocUri()]("112", impl->host->phrase, impl->name);
+        diagnostics[impl->getDocPrefix()]("112", impl->host->phrase, impl->name);
         return false;
     }
 
@@ -567,7 +691,7 @@ bool SemanticContext::validateMethodImplementation( $metimpl impl ) {
         org = def;
         break;
     } if( !org ) {
-        diagnostics[impl->getDocUri()]("113", impl->name);
+        diagnostics[impl->getDocPrefix()]("113", impl->name);
         return false;
     }
 
@@ -579,7 +703,7 @@ bool SemanticContext::validateOperatorImplementation( $opimpl impl ) {
 
     auto host = ReachClass(impl->host);
     if( !host ) {
-        diagnostics[impl->getDocUri()]("112", impl->host->phrase, impl->name);
+        diagnostics[impl->getDocPrefix()]("112", impl->host->phrase, impl->name);
         return false;
     }
 
@@ -602,157 +726,275 @@ bool SemanticContext::validateOperatorImplementation( $opimpl impl ) {
         org = def;
         break;
     } if( !org ) {
-        diagnostics[impl->getDocUri()]("113", impl->name);
+        diagnostics[impl->getDocPrefix()]("113", impl->name);
         return false;
     }
 
     return true;
 }
 
+/** 将记号的书写形式追加到缓冲区，避免构造临时字符串 */
+static void AppendToken( string& buf, const token& t ) {
+    if( auto it = VT::written_table.find(t.id); it != VT::written_table.end() ) buf += it->second;
+    else buf += t.tx;
+}
+
+/** 将定义的名称追加到缓冲区，名称沿用tostr()的形式，运算符写作add、shl等单词 */
+static void AppendName( string& buf, const token& t ) {
+    buf += t.tostr();
+}
+
+/** 将作用域路径 Module::Class::... 追加到缓冲区，作用域只被向外遍历一次 */
+static void AppendScopePath( string& buf, $node scope ) {
+    chainz<const token*> path;
+    for( auto d = scope; d != nullptr; d = d->getScope() ) {
+        if( auto cd = ($classdef)d; cd ) path << &cd->name;
+        else if( auto md = ($module)d; md ) path << &md->sig->name;
+    }
+    for( auto i = path.size()-1; i >= 0; i-- ) {
+        AppendToken(buf, *path[i]);
+        buf += "::";
+    }
+}
+
 string SemanticContext::GetBinarySymbol( $node s ) {
-    if( !s ) return "<error-0>";
     string symbol;
+    WriteBinarySymbol(s, symbol);
+    return symbol;
+}
+
+int SemanticContext::GetSymbolId( $node s ) {
+    auto mod = s ? s->getModule() : nullptr;
+    if( !mod ) return -1;
+    auto& context = mod->sctx;
+    if( auto guard = lock_guard<mutex>(context.cache_lock); true )
+        if( auto it = context.symbol_cache.find((node*)s); it != context.symbol_cache.end() )
+            return get<1>(it->second);
+    return context.internSymbol(GetBinarySymbol(s));
+}
+
+const string& SemanticContext::getSymbol( int id ) {
+    auto guard = lock_guard<mutex>(cache_lock);
+    return symbol_pool.at(id);
+}
+
+int SemanticContext::internSymbol( const string& symbol ) {
+    auto guard = lock_guard<mutex>(cache_lock);
+    if( auto it = symbol_ids.find(symbol); it != symbol_ids.end() ) return it->second;
+    auto id = (int)symbol_pool.size();
+    symbol_pool.push_back(symbol);
+    symbol_ids[symbol_pool.back()] = id;
+    return id;
+}
+
+void SemanticContext::WriteBinarySymbol( $node s, string& buf ) {
+    if( !s ) {buf += "<error-0>"; return;}
     auto mod = s->getModule();
     auto src = s;
-    bool skip = false;
+    auto start = buf.size();
+    auto fail = [&]( const char* error ) { buf.resize(start); buf += error; };
 
     if( mod ) {
-        if( mod->sctx.symbol_cache.count(s) )
-            return mod->sctx.symbol_cache[s];
-    }
-
-    if( auto impl = ($implementation)s; impl ) {
-        if( auto def = GetDefinition(impl); def ) {
-            src = def;
-        } else {
-            auto tc = GetThisClassDef(($node)impl);
-            if( !tc ) return "<error-1>";
-            symbol = tc->name.tostr();
-            for( auto d = tc->getScope(); d != nullptr; d = d->getScope() ) {
-                if( auto cd = ($classdef)d; cd ) symbol = (string)cd->name + "::" + symbol;
-                else if( auto md = ($module)d; md ) symbol = (string)md->sig->name + "::" + symbol;
-            }
-            symbol += "::" + (string)impl->name;
+        auto guard = lock_guard<mutex>(mod->sctx.cache_lock);
+        if( auto it = mod->sctx.symbol_cache.find((node*)s); it != mod->sctx.symbol_cache.end() ) {
+            buf += mod->sctx.symbol_pool[get<1>(it->second)];
+            return;
         }
-        /** 接下来的工作在原型处处理 */
     }
+
+    /** 实现尽可能使用其定义的符号 */
+    auto impl = ($implementation)s;
+    if( impl ) if( auto def = GetDefinition(impl); def ) src = def;
+
     if( auto met = ($metdef)src; met and met->raw ) {
         auto [suc,dat,diag] = met->raw.extractContent();
-        if( !suc ) return "<error-8>";
-        symbol = dat;
-        skip = true;
-    } else if( auto def = ($definition)src; def ) {
-        symbol = def->name.tostr();
-        for( auto d = def->getScope(); d != nullptr; d = d->getScope() ) {
-            if( auto cd = ($classdef)d; cd ) symbol = (string)cd->name + "::" + symbol;
-            else if( auto md = ($module)d; md ) symbol = (string)md->sig->name + "::" + symbol;
-        }
-        if( auto cdef = ($classdef)def; cdef ) symbol = "class:" + symbol;
-        else if( auto edef = ($enumdef)def; edef ) symbol = "enum:" + symbol;
-        else if( auto mdef = ($metdef)def; mdef ) /** 此部分工作在原型部分完成 */;
-        else if( auto odef = ($opdef)def; odef ) /** 此部分工作在原型部分完成 */;
-        else if( auto adef = ($attrdef)def; adef ) symbol = "attribute:" + symbol;
-        else if( auto idef = ($aliasdef)def; idef ) symbol = "alias:" + symbol;
-        else return "<error-2>";
-
-    } else if( auto proto = ($eprototype)src; proto ) {
-        proto = $(proto);
-        if( !proto ) return "<error-3>";
-        switch( proto->etype ) {
-            case eprototype::obj: symbol = "obj"; break;
-            case eprototype::ptr: symbol = "ptr"; break;
-            case eprototype::ref: symbol = "ref"; break;
-            case eprototype::rel: symbol = "rel"; break;
-            case eprototype::var: symbol = "var"; break;
-            default: return "<error-4>";
+        if( !suc ) return fail("<error-8>");
+        buf += dat;
+    } else {
+        /** 前缀先于名称写入，方法原型和运算符原型的前缀与定义种类的前缀不会同时出现 */
+        if( auto met = dynamic_cast<metprototype*>(&*src); met ) {
+            buf += "method";
+            if( met->cons ) buf += ".const";
+            if( met->meta ) buf += ".meta";
+            buf += ":";
+        } else if( auto op = dynamic_cast<opprototype*>(&*src); op ) {
+            buf += "operator:";
         }
-        symbol += ":" + GetBinarySymbol(($node)proto->dtype);
-    } else if( auto type = ($typeexpr)src; type ) {
-        type = $(type);
-        if( !type ) return "<error-5>";
-        if( type->is_type(UnknownType) ) {
-            return "<unknown>";
-        } else if( type->is_type(BasicTypeMask) ) {
-            switch( type->id ) {
-                case VoidType: symbol = "void"; break;
-                case BooleanType: symbol = "boolean"; break;
-                case Uint8Type: symbol = "uint8"; break;
-                case Uint16Type: symbol = "uint16"; break;
-                case Uint32Type: symbol = "uint32"; break;
-                case Uint64Type: symbol = "uint64"; break;
-                case Int8Type: symbol = "int8"; break;
-                case Int16Type: symbol = "int16"; break;
-                case Int32Type: symbol = "int32"; break;
-                case Int64Type: symbol = "int64"; break;
-                case Float32Type: symbol = "float32"; break;
-                case Float64Type: symbol = "float64"; break;
-                default: return "<error-6>";
+
+        if( src == s and impl ) {
+            auto tc = GetThisClassDef(($node)impl);
+            if( !tc ) return fail("<error-1>");
+            AppendScopePath(buf, tc->getScope());
+            AppendName(buf, tc->name);
+            buf += "::";
+            AppendToken(buf, impl->name);
+        } else if( auto def = ($definition)src; def ) {
+            if( auto cdef = ($classdef)def; cdef ) buf += "class:";
+            else if( auto edef = ($enumdef)def; edef ) buf += "enum:";
+            else if( auto mdef = ($metdef)def; mdef ) /** 前缀已经写入 */;
+            else if( auto odef = ($opdef)def; odef ) /** 前缀已经写入 */;
+            else if( auto adef = ($attrdef)def; adef ) buf += "attribute:";
+            else if( auto idef = ($aliasdef)def; idef ) buf += "alias:";
+            else return fail("<error-2>");
+            AppendScopePath(buf, def->getScope());
+            AppendName(buf, def->name);
+        } else if( auto proto = ($eprototype)src; proto ) {
+            proto = $(proto);
+            if( !proto ) return fail("<error-3>");
+            switch( proto->etype ) {
+                case eprototype::obj: buf += "obj"; break;
+                case eprototype::ptr: buf += "ptr"; break;
+                case eprototype::ref: buf += "ref"; break;
+                case eprototype::rel: buf += "rel"; break;
+                case eprototype::var: buf += "var"; break;
+                default: return fail("<error-4>");
             }
-        } else if( type->is_type(ConstraintedPointerType) ) {
-            symbol = "^" + GetBinarySymbol(($node)type->sub);
-        } else if( type->is_type(UnconstraintedPointerType) ) {
-            symbol = "*" + GetBinarySymbol(($node)type->sub);
-        } else if( type->is_type(NullPointerType) ) {
-            symbol = "null";
-        } else if( type->is_type(CallableType) ) {
-            /** 此处的任务在下面的call部分被处理 */
-        } else if( type->is_type(EntityType) ) {
-            symbol = "entity_struct." + GetBinarySymbol(($node)type->sub);
-        } else if( type->is_type(StructType) ) {
-            symbol = "struct." + GetBinarySymbol(($node)type->sub);
-        } else {
-            return "<error-7>";
+            buf += ":";
+            WriteBinarySymbol(($node)proto->dtype, buf);
+        } else if( auto type = ($typeexpr)src; type ) {
+            type = $(type);
+            if( !type ) return fail("<error-5>");
+            if( type->is_type(UnknownType) ) {
+                return fail("<unknown>");
+            } else if( type->is_type(BasicTypeMask) ) {
+                switch( type->id ) {
+                    case VoidType: buf += "void"; break;
+                    case BooleanType: buf += "boolean"; break;
+                    case Uint8Type: buf += "uint8"; break;
+                    case Uint16Type: buf += "uint16"; break;
+                    case Uint32Type: buf += "uint32"; break;
+                    case Uint64Type: buf += "uint64"; break;
+                    case Int8Type: buf += "int8"; break;
+                    case Int16Type: buf += "int16"; break;
+                    case Int32Type: buf += "int32"; break;
+                    case Int64Type: buf += "int64"; break;
+                    case Float32Type: buf += "float32"; break;
+                    case Float64Type: buf += "float64"; break;
+                    default: return fail("<error-6>");
+                }
+            } else if( type->is_type(ConstraintedPointerType) ) {
+                buf += "^";
+                WriteBinarySymbol(($node)type->sub, buf);
+            } else if( type->is_type(UnconstraintedPointerType) ) {
+                buf += "*";
+                WriteBinarySymbol(($node)type->sub, buf);
+            } else if( type->is_type(NullPointerType) ) {
+                buf += "null";
+            } else if( type->is_type(CallableType) ) {
+                /** 此处的任务在下面的call部分被处理 */
+            } else if( type->is_type(EntityType) ) {
+                buf += "entity_struct.";
+                WriteBinarySymbol(($node)type->sub, buf);
+            } else if( type->is_type(StructType) ) {
+                buf += "struct.";
+                WriteBinarySymbol(($node)type->sub, buf);
+            } else {
+                return fail("<error-7>");
+            }
+        } else if( auto stmt = ($statement)src; stmt ) {
+            AppendToken(buf, stmt->name);
         }
-    } else if( auto stmt = ($statement)src; stmt ) {
-        symbol = stmt->name;
-    }
 
-    if( !skip ) {
         /** 处理模板类的情况 */
         if( auto usage = ($classdef)src; usage and usage->targs.size() ) {
-            symbol += "<";
+            buf += "<";
             for( int i = 0; i < usage->targs.size(); i++ ) {
-                if( i != 0 ) symbol += ",";
-                symbol += GetBinarySymbol(($node)usage->targs[i]);
+                if( i != 0 ) buf += ",";
+                WriteBinarySymbol(($node)usage->targs[i], buf);
             }
-            symbol += ">";
+            buf += ">";
         }
 
-        /** 处理方法原型和运算符原型 */
-        if( auto met = dynamic_cast<metprototype*>(&*src); met ) {
-            string prefix = "method";
-            if( met->cons ) prefix += ".const";
-            if( met->meta ) prefix += ".meta";
-            symbol = prefix + ":" + symbol;
-        } else if( auto op = dynamic_cast<opprototype*>(&*src); op ) {
-            string prefix = "operator";
-            if( op->cons ) prefix += ".const";
-            if( op->modifier and !op->modifier.is(VT::DEFAULT) ) prefix += "." + (string)op->modifier;
-            symbol = "operator:" + symbol;
-            if( op->subtitle ) symbol += "." + (string)op->subtitle;
+        /** 处理运算符的副标题 */
+        if( auto op = dynamic_cast<opprototype*>(&*src); op and op->subtitle ) {
+            buf += ".";
+            AppendToken(buf, op->subtitle);
         }
 
-        /** 处理可调用的情况 */
-        auto call = ($callable_type)src;
-        if( auto cal = dynamic_cast<callable*>(&*src); cal ) call = cal->getType();
-        if( call ) {
-            symbol += "(";
+        /** 处理可调用的情况，直接遍历参数而不构造可调用类型 */
+        if( auto cal = dynamic_cast<callable*>(&*src); cal ) {
+            buf += "(";
+            for( int i = 0; i < cal->arguments.size(); i++ ) {
+                if( i != 0 ) buf += ",";
+                WriteBinarySymbol(($node)cal->arguments[i]->proto, buf);
+            }
+            if( cal->va_arg ) {
+                buf += "...";
+                if( cal->va_arg.is(VT::L::LABEL) ) AppendToken(buf, cal->va_arg);
+            }
+            if( cal->ret_proto ) {
+                buf += "=>";
+                WriteBinarySymbol(($node)cal->ret_proto, buf);
+            }
+            buf += ")";
+        } else if( auto call = ($callable_type)src; call ) {
+            buf += "(";
             for( int i = 0; i < call->arg_protos.size(); i++ ) {
-                if( i != 0 ) symbol += ",";
-                symbol += GetBinarySymbol(($node)call->arg_protos[i]);
+                if( i != 0 ) buf += ",";
+                WriteBinarySymbol(($node)call->arg_protos[i], buf);
             }
             if( call->va_arg ) {
-                symbol += "...";
-                if( call->va_arg.is(VT::L::LABEL) ) symbol += call->va_arg;
+                buf += "...";
+                if( call->va_arg.is(VT::L::LABEL) ) AppendToken(buf, call->va_arg);
             }
-            if( call->ret_proto ) symbol += "=>" + GetBinarySymbol(($node)call->ret_proto);
-            symbol += ")";
-            // symbol += GetBinarySymbol(($node)call->ret_proto);
+            if( call->ret_proto ) {
+                buf += "=>";
+                WriteBinarySymbol(($node)call->ret_proto, buf);
+            }
+            buf += ")";
         }
     }
 
-    if( mod ) mod->sctx.symbol_cache[s] = symbol;
-    return symbol;
+    if( mod ) {
+        auto id = mod->sctx.internSymbol(buf.substr(start));
+        auto guard = lock_guard<mutex>(mod->sctx.cache_lock);
+        mod->sctx.symbol_cache[(node*)s] = {s,id};
+    }
+}
+
+void SemanticContext::WriteInterface( $definition def, string& buf ) {
+    if( !def ) return;
+    WriteBinarySymbol(($node)def, buf);
+    if( def->visibility ) AppendToken(buf, def->visibility);
+    for( auto i : def->premise ) buf += "?" + to_string(i);
+
+    if( auto cdef = ($classdef)def; cdef ) {
+        if( cdef->abstract ) buf += ".abstract";
+        for( auto& targ : cdef->targf ) {
+            buf += "<";
+            AppendToken(buf, targ);
+        }
+        /** 泛型模板类的内容不能被归约，否则其用例将继承归约失败的结果 */
+        if( cdef->targf.size() and cdef->targs.size() == 0 ) return;
+        for( auto super : cdef->supers ) {
+            buf += ":";
+            WriteBinarySymbol(($node)ReachClass(super, SearchOption::ALL|SearchOption::ANY, super->getScope()), buf);
+        }
+        buf += "{";
+        for( auto sub : cdef->defs ) {
+            WriteInterface(sub, buf);
+            buf += ";";
+        }
+        buf += "}";
+    } else if( auto edef = ($enumdef)def; edef ) {
+        for( auto item : edef->items ) {
+            buf += ",";
+            AppendToken(buf, item->name);
+            if( item->value ) {
+                buf += "=";
+                AppendToken(buf, item->value);
+            }
+        }
+    } else if( auto adef = ($attrdef)def; adef ) {
+        if( adef->meta ) buf += ".meta";
+        buf += ":";
+        WriteBinarySymbol(($node)adef->proto, buf);
+        for( auto n : adef->arr ) buf += "[" + to_string(n) + "]";
+    } else if( auto idef = ($aliasdef)def; idef ) {
+        buf += "=";
+        for( auto res : Reach(idef->target, SearchOption::ALL|SearchOption::ANY, idef->getScope()) )
+            WriteBinarySymbol(($node)res, buf);
+    }
 }
 
 $definition SemanticContext::GetDefinition( $implementation impl ) {
@@ -812,6 +1054,8 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
     auto& semantic = module->sctx;
     auto& diagnostics = semantic.diagnostics;
     everything results;
+    if( recording ) recording->refs.emplace(module, -1);
+    Profiler::Count(Profiler::LOOKUPS);
 
     if( auto sc = ($module)scope; sc ) {
         /** 尝试匹配自身 */
@@ -828,6 +1072,7 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
             if( !dep->alias.is(VT::L::THIS) ) continue;
             auto mod = semantic.getModule(dep);
             if( !mod ) return internal_error, nothing;
+            if( recording ) recording->refs.emplace(mod, -1);
             for( auto def : mod->trans->defs )
                 if( def->name == name->name ) results << (anything)def;
         }
@@ -841,6 +1086,7 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
             if( !found ) continue;
             auto mod = semantic.getModule(dep);
             if( !mod ) return internal_error, nothing;
+            if( recording ) recording->refs.emplace(mod, -1);
             results << (anything)mod->trans;
         }
     } else if( auto sc = ($classdef)scope; sc ) {
@@ -894,7 +1140,7 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
 
         /** 检查别名循环 */
         for( auto layer : semantic.alias_searching_layers ) if( layer == alias ) {
-            diagnostics[alias->getDocUri()]("87", alias->phrase);
+            diagnostics[alias->getDocPrefix()]("87", alias->phrase);
             return nothing;
         }
 
@@ -909,9 +1155,9 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
 
     /** 处理模板类用例的情况 */
     if( name->targs.size() and results.size() ) {
-        if( results.size() != 1 ) return diagnostics[name->getDocUri()]("90", name->name), nothing;
+        if( results.size() != 1 ) return diagnostics[name->getDocPrefix()]("90", name->name), nothing;
         auto def = ($classdef)results[0];
-        if( !def ) return diagnostics[name->getDocUri()]("90", name->name), nothing;
+        if( !def ) return diagnostics[name->getDocPrefix()]("90", name->name), nothing;
         auto usage = GetTemplateUsage( def, name->targs );
         if( !usage ) return nothing;
         results[0] = usage;
@@ -920,11 +1166,11 @@ everything SemanticContext::Reach( $nameexpr name, SearchOptions opts, $scope sc
     if( results.size() != 0 and name->next ) {
         /** 处理作用域深入的情况 */
         if( results.size() != 1 )
-            return diagnostics[name->getDocUri()]("88", name->name), nothing;
+            return diagnostics[name->getDocPrefix()]("88", name->name), nothing;
         /** 处理目标并非作用域的情况 */
         auto sc = ($node)results[0];
         if( !sc or !sc->isscope() )
-            return diagnostics[name->getDocUri()]("89", name->name), nothing;
+            return diagnostics[name->getDocPrefix()]("89", name->name), nothing;
         /** 深入作用域搜索 */
         return Reach( name->next, SearchOption::ANY, sc );
     } else if( results.size() == 0 ) {
@@ -980,7 +1226,7 @@ $eprototype SemanticContext::ReductPrototype( $eprototype proto ) {
 
     if( proto->etype == eprototype::obj and proto->dtype->is_type(StructType) and !CanBeInstanced(($classdef)proto->dtype->sub) ) {
         auto& diagnostics = proto->getModule()->sctx.diagnostics;
-        diagnostics[proto->getDocUri()]("115", proto->dtype->phrase);
+        diagnostics[proto->getDocPrefix()]("115", proto->dtype->phrase);
         return nullptr;
     }
 
@@ -996,7 +1242,7 @@ $typeexpr SemanticContext::ReductTypeexpr( $typeexpr type, $eprototype proto ) {
     if( type->is_type(NamedType) ) {
         auto res = $(($nameexpr)type->sub);
         if( res.size() != 1 ) {
-            diagnostics[type->getDocUri()];
+            diagnostics[type->getDocPrefix()];
             if( res.size() == 0 ) diagnostics("97", type->phrase);
             else diagnostics("93", type->phrase);
             type->id = UnsolvableType;
@@ -1019,14 +1265,14 @@ $typeexpr SemanticContext::ReductTypeexpr( $typeexpr type, $eprototype proto ) {
                 type->sub = t->sub;
             }
         } else {
-            diagnostics[type->getDocUri()]("94", type->phrase);
+            diagnostics[type->getDocPrefix()]("94", type->phrase);
             return nullptr;
         }
     } else if( type->is_type(ThisClassType) ) {
         auto def = GetThisClassDef(($node)type);
         if( !def ) {
             type->id = UnsolvableType;
-            diagnostics[type->getDocUri()]("95", type->phrase);
+            diagnostics[type->getDocPrefix()]("95", type->phrase);
 
             return nullptr;
         } else {
@@ -1063,6 +1309,7 @@ $classdef SemanticContext::GetTemplateUsage( $classdef def, eprototypes targs )
     auto module = def->getModule();
     auto& context = module->sctx;
     auto& diagnostics = context.diagnostics;
+    if( recording ) recording->usages.insert(module);
 
     /** 检查各种类型的内部错误 */
     if( def->targf.size() == 0 ) return internal_error, nullptr;
@@ -1071,17 +1318,18 @@ $classdef SemanticContext::GetTemplateUsage( $classdef def, eprototypes targs )
 
     /** 检查模板参数列表 */
     if( targs.size() != def->targf.size() ) {
-        return diagnostics[targs[-1]->getDocUri()]("104", targs[-1]->phrase), nullptr;
+        return diagnostics[targs[-1]->getDocPrefix()]("104", targs[-1]->phrase), nullptr;
     } else {
         bool success = true;
         for( auto targ : targs ) if( !$(targ) ) {
             success = false;
-            diagnostics[targ->getDocUri()]("110", targ->phrase);
+            diagnostics[targ->getDocPrefix()]("110", targ->phrase);
         }
         if( !success ) return nullptr;
     }
 
-    /** 检查已经存在的模板用例 */
+    /** 检查已经存在的模板用例，用例的检索与产生需要互斥进行 */
+    auto guard = lock_guard<recursive_mutex>(context.usage_lock);
     for( auto usage : def->usages ) {
         bool same = true;
         for( auto i = 0; i < targs.size(); i++ ) {
@@ -1094,6 +1342,8 @@ $classdef SemanticContext::GetTemplateUsage( $classdef def, eprototypes targs )
     }
 
     /** 产生模板用例 */
+    Profiler::Count(Profiler::INSTANCES);
+    auto timing = Profiler::scope(context.profiler, "instantiation", module->sig->name.tx + "." + def->name.tx);
     auto usage = ($classdef)def->clone(def->getScope());
     usage->targs = targs;
 
@@ -1129,7 +1379,7 @@ $classdef SemanticContext::GetTemplateUsage( $classdef def, eprototypes targs )
         if( verdict ) premise.insert(i);
     }
     if( def->preds.size() and premise.empty() )
-        return diagnostics[targs[0]->getDocUri()]("109", targs[0]->phrase, targs[-1]->phrase), nullptr;
+        return diagnostics[targs[0]->getDocPrefix()]("109", targs[0]->phrase, targs[-1]->phrase), nullptr;
 
     /** 根据谓词删除前提不成立的定义 */
     for( auto i = 0; i < usage->defs.size(); i++ ) {
@@ -1181,6 +1431,17 @@ bool SemanticContext::IsIdentical( $typeexpr a, $typeexpr b, bool u ) {
     }
 }
 
+bool SemanticContext::IsOverriding( $metdef derived, $metdef base ) {
+    if( !derived or !base or derived == base ) return false;
+    if( derived->meta or base->meta ) return false;
+    if( derived->name.tostr() != base->name.tostr() ) return false;
+    if( (bool)derived->cons xor (bool)base->cons ) return false;
+    if( derived->arguments.size() != base->arguments.size() ) return false;
+    for( auto i = 0; i < derived->arguments.size(); i++ )
+        if( !IsIdentical(derived->arguments[i]->proto, base->arguments[i]->proto, true) ) return false;
+    return true;
+}
+
 classdefs SemanticContext::GetInheritTable( $classdef def, classdefs paddings ) {
     classdefs table;
     
@@ -1328,6 +1589,45 @@ elements SemanticContext::MinimalCall( callable* call, bool order ) {
     return ret;
 }
 
+SemanticContext::definition_table::definition_table( SemanticContext& _context, bool _operators ):
+    context(_context),operators(_operators) {
+
+}
+
+bool SemanticContext::definition_table::insert( $definition def ) {
+    auto& diagnostics = context.diagnostics;
+    auto& b = buckets[(string)def->name];
+    auto e = entry{count++, def};
+
+    /** 方法之间，以及未被删除的运算符之间，只有符号相同才构成冲突，其余同名定义总是冲突 */
+    int kind = 0;
+    if( def->is(node::METHODDEF) ) kind = 1;
+    else if( operators and def->is(node::OPERATORDEF) and !(($opdef)def)->modifier.is(VT::DELETE) ) kind = 2;
+    int sym = kind ? GetSymbolId(($node)def) : -1;
+
+    vector<entry> conflicts = b.keyless;
+    for( auto& [k,all] : b.kinds ) if( k != kind ) conflicts.insert(conflicts.end(), all.begin(), all.end());
+    if( auto it = b.keyed.find({kind,sym}); kind and it != b.keyed.end() )
+        conflicts.insert(conflicts.end(), it->second.begin(), it->second.end());
+
+    if( conflicts.size() ) {
+        /** 按照书写顺序报告冲突 */
+        sort(conflicts.begin(), conflicts.end(), []( const entry& a, const entry& b ){ return a.index < b.index; });
+        auto dname = sym >= 0 ? context.getSymbol(sym) : GetBinarySymbol(($node)def);
+        for( auto& prv : conflicts )
+            diagnostics[def->getDocPrefix()]("98", def->name, dname)
+            [-1](prv.def->getDocPrefix(), "45", prv.def->name);
+    }
+
+    if( kind ) {
+        b.kinds[kind].push_back(e);
+        b.keyed[{kind,sym}].push_back(e);
+    } else {
+        b.keyless.push_back(e);
+    }
+    return conflicts.empty();
+}
+
 SemanticContext::searching_layer::searching_layer( $scope scope, $nameexpr name ):layers(nullptr) {
     if( !scope ) return;
     auto module = scope->getModule();
@@ -1338,7 +1638,7 @@ SemanticContext::searching_layer::searching_layer( $scope scope, $nameexpr name
         found += 1;
     }
     if( found >= 8) {
-        diagnostics[name->getDocUri()]("111", name->name);
+        diagnostics[name->getDocPrefix()]("111", name->name);
         return;
     }
     context.searching_layers.push(scope);
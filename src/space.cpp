@@ -11,6 +11,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <set>
 #include "ptree.hpp"
 
 namespace alioth {
@@ -30,6 +31,8 @@ const string SpaceEngine::default_work_path = "./";
 const string SpaceEngine::default_root_path = "/usr/lib/alioth/";
 const string PackageLocator::THIS_PLATFORM = "linux";
 #endif
+const int SpaceEngine::content_window = 64;
+shared_mutex SpaceEngine::buffers_lock;
 
 const srcdesc srcdesc::error = {flags:0};
 const Uri Uri::Bad = {port:-1};
@@ -543,7 +546,7 @@ chainz<fulldesc> SpaceEngine::enumerateContents( const srcdesc& desc ) {
                 ret.name = fname;
                 modifier( ret, item.dir );
             }
-            return descs;
+            return overlayBuffers(desc, descs), descs;
         }
     } while( false );
     auto path = getPath(desc);
@@ -570,7 +573,7 @@ chainz<fulldesc> SpaceEngine::enumerateContents( const srcdesc& desc ) {
         modifier( ret, S_ISDIR(stat.st_mode) );
     }
 
-    return descs;
+    return overlayBuffers(desc, descs), descs;
 }
 
 chainz<string> SpaceEngine::enumeratePublishers() {
@@ -620,6 +623,11 @@ uistream SpaceEngine::openDocumentForRead( const srcdesc& desc ) {
     if( !desc.isDocument() )
         throw runtime_error("SpaceEngine::openDocumentForRead( const srcdesc& desc ): descriptor doesn't describe a document.");
     auto uri = getUri(desc);
+    {
+        shared_lock guard(buffers_lock);
+        if( auto it = mbuffers.find((string)uri); it != mbuffers.end() )
+            return std::make_unique<stringstream>(it->second.text.content());
+    }
     do if( interactive ) {
         auto seq = msock->requestContent(uri);
         auto package = msock->receiveRespond(seq);
@@ -634,6 +642,73 @@ uistream SpaceEngine::openDocumentForRead( const srcdesc& desc ) {
     return OpenStreamForRead( uri );
 }
 
+vector<uistream> SpaceEngine::openDocumentsForRead( const chainz<srcdesc>& descs ) {
+    using namespace protocol;
+    vector<uistream> streams(descs.size());
+    if( !interactive ) {
+        for( int i = 0; i < descs.size(); i++ ) streams[i] = openDocumentForRead(descs[i]);
+        return streams;
+    }
+
+    /** 响应按序列号归集，可以按照发出的顺序依次等待，不必关心响应到达的顺序 */
+    chainz<tuple<int,long>> inflight;
+    for( int next = 0; next < descs.size() or inflight.size(); ) {
+        while( next < descs.size() and inflight.size() < content_window ) {
+            if( !descs[next].isDocument() )
+                throw runtime_error("SpaceEngine::openDocumentsForRead( const chainz<srcdesc>& descs ): descriptor doesn't describe a document.");
+            shared_lock guard(buffers_lock);
+            if( auto it = mbuffers.find((string)getUri(descs[next])); it != mbuffers.end() )
+                streams[next] = std::make_unique<stringstream>(it->second.text.content());
+            else
+                inflight << tuple<int,long>{next, msock->requestContent(getUri(descs[next]))};
+            next += 1;
+        }
+        if( inflight.size() == 0 ) continue;
+        auto [i,seq] = inflight[0];
+        inflight.remove(0);
+        if( auto package = msock->receiveRespond(seq); package ) {
+            if( auto ext = package->respond(); ext->status == Status::SUCCESS ) {
+                auto stream = std::make_unique<stringstream>();
+                stream->str(ext->content()->data);
+                streams[i] = std::move(stream);
+                continue;
+            }
+        }
+        streams[i] = OpenStreamForRead(getUri(descs[i]));
+    }
+    return streams;
+}
+
+bool SpaceEngine::updateDocument( Uri uri, const chainz<protocol::Parameter::Request::Update::edit>& edits ) {
+    unique_lock guard(buffers_lock);
+    auto it = mbuffers.find((string)uri);
+    if( it == mbuffers.end() ) {
+        if( edits.size() == 0 or edits[0].offset >= 0 or edits[0].line > 0 ) return false;
+        it = mbuffers.emplace((string)uri, Buffer{}).first;
+    }
+
+    auto& buffer = it->second;
+    for( auto& edit : edits ) {
+        size_t offset = edit.offset;
+        if( edit.offset < 0 and edit.line <= 0 ) {
+            buffer.text.assign(edit.text);
+            continue;
+        } else if( edit.offset < 0 and !buffer.text.locate(edit.line, max(edit.column,1L), offset) ) {
+            return mbuffers.erase(it), false;
+        }
+        if( edit.length < 0 or !buffer.text.replace(offset, edit.length, edit.text) )
+            return mbuffers.erase(it), false;
+    }
+
+    buffer.mtime = max(time(nullptr), buffer.mtime + 1);
+    return true;
+}
+
+bool SpaceEngine::releaseDocument( Uri uri ) {
+    unique_lock guard(buffers_lock);
+    return mbuffers.erase((string)uri) > 0;
+}
+
 uostream SpaceEngine::openDocumentForWrite( const srcdesc& desc ) {
     return OpenStreamForWrite(getUri(desc));
 }
@@ -772,6 +847,34 @@ bool SpaceEngine::enableInteractiveMode( int input, int output ) {
     return a and b;
 }
 
+void SpaceEngine::overlayBuffers( const srcdesc& space, chainz<fulldesc>& descs ) {
+    shared_lock guard(buffers_lock);
+    if( mbuffers.empty() ) return;
+    set<string> listed;
+    for( auto& desc : descs ) {
+        if( !desc.isDocument() ) continue;
+        if( auto it = mbuffers.find((string)getUri(desc)); it != mbuffers.end() ) {
+            desc.size = it->second.text.size();
+            desc.mtime = it->second.mtime;
+        }
+        listed.insert(desc.name);
+    }
+
+    /** 只存在于缓冲中的新文档直接位于空间中，URI以空间的URI为前缀且其后没有路径分隔符 */
+    auto prefix = (string)getUri(space);
+    if( prefix.empty() or prefix.back() != dirdvc ) prefix += dirdvs;
+    for( auto it = mbuffers.lower_bound(prefix); it != mbuffers.end() and it->first.compare(0, prefix.size(), prefix) == 0; it++ ) {
+        auto name = it->first.substr(prefix.size());
+        if( name.empty() or name.find(dirdvc) != string::npos or listed.count(name) ) continue;
+        fulldesc& ret = descs.construct(-1);
+        ret.flags = space.flags | DOCUMENT;
+        ret.package = space.package;
+        ret.name = name;
+        ret.size = it->second.text.size();
+        ret.mtime = it->second.mtime;
+    }
+}
+
 uistream SpaceEngine::OpenStreamForRead( int i ) {
     return make_unique<fdistream>(i);
 }
@@ -3,6 +3,7 @@
 
 #include "syntax.hpp"
 #include "context.hpp"
+#include "profiler.hpp"
 
 namespace alioth {
 
@@ -49,7 +50,7 @@ namespace alioth {
     ret->etype = etype;
 
 node::node( $scope sc ):mscope(sc) {
-
+    Profiler::Count(Profiler::NODES);
 }
 
 bool node::isscope() const {
@@ -70,6 +71,10 @@ Uri node::getDocUri() {
     return mscope?mscope->getDocUri():Uri::Bad;
 }
 
+istring node::getDocPrefix() {
+    return mscope?mscope->getDocPrefix():istring(Uri::Bad);
+}
+
 $fragment node::getFragment() {
     return mscope?mscope->getFragment():nullptr;
 }
@@ -216,6 +221,10 @@ Uri depdesc::getDocUri() {
     return getCompilerContext().getSpaceEngine().getUri(doc);
 }
 
+istring depdesc::getDocPrefix() {
+    return getDocUri();
+}
+
 bool fragment::is( type t ) const {
     return t == FRAGMENT;
 }
@@ -228,6 +237,10 @@ Uri fragment::getDocUri() {
     return getCompilerContext().getSpaceEngine().getUri(doc);
 }
 
+istring fragment::getDocPrefix() {
+    return prefix;
+}
+
 $fragment fragment::getFragment() {
     return this;
 }
@@ -671,6 +684,7 @@ SyntaxContext::state::operator int&() {
 void SyntaxContext::movi(int s,int c) {
     states << state(s,c);
     it += c;
+    supply();
 }
 
 void SyntaxContext::movo(int c ) {
@@ -684,6 +698,16 @@ void SyntaxContext::movo(int c ) {
 void SyntaxContext::stay(int c ) {
     states[-1].c += c;
     it += c;
+    supply();
+}
+
+void SyntaxContext::supply() {
+    if( cache ) while( it.pos >= source.size() and fed < cache->source.size() ) {
+        auto& t = cache->source[fed++];
+        if( !t.is(VT::U::SPACE,VT::U::C::BLOCK,VT::U::C::LINE) ) source.construct(-1, t);
+    } else while( it.pos >= source.size() and fed < rest.size() ) {
+        source.construct(-1, std::move(rest[fed++]));
+    }
 }
 void SyntaxContext::redu(int c, int n ) {
     token node = token(n);
@@ -707,17 +731,37 @@ void SyntaxContext::redu(int c, int n ) {
         }
     }
 
+    /** 逆序收集被归约的单词文本，最后一次拼接，避免长短语的文本被反复前插 */
+    vector<string> parts;
     while( c-- > 0 ) {
         while( states[-1].c-- > 0 ) {
             //node.insert( std::move(*(--it)), 0 );
             node.bl = (it-1)->bl;
             node.bc = (it-1)->bc;
-            if( isalnum(node.tx[0]) and isalnum((it-1)->tx.back()) ) node.tx = (it-1)->tx + " " + node.tx;
-            else node.tx = (it-1)->tx + node.tx;
+            parts.push_back(std::move((it-1)->tx));
             (--it).r.remove(it.pos);
         }
         states.remove(-1);
     }
+
+    /** 两个相邻的文本若在连接处都是字母或数字，则以空格隔开 */
+    if( parts.size() ) {
+        vector<bool> gaps(parts.size());
+        size_t total = node.tx.size() + parts.size();
+        char head = node.tx.size() ? node.tx[0] : 0;
+        for( size_t i = 0; i < parts.size(); i++ ) {
+            total += parts[i].size();
+            gaps[i] = isalnum(head) and parts[i].size() and isalnum(parts[i].back());
+            if( parts[i].size() ) head = parts[i][0];
+        }
+        string text;
+        text.reserve(total);
+        for( size_t i = parts.size(); i-- > 0; ) {
+            text += parts[i];
+            if( gaps[i] ) text += ' ';
+        }
+        node.tx = std::move(text += node.tx);
+    }
     
     it.r.insert(std::move(node),it.pos);
 }
@@ -741,14 +785,84 @@ bool SyntaxContext::working() {
     else return movo(sub), ws.pop(), false;
 }
 
-SyntaxContext::SyntaxContext( srcdesc dc, tokens& src, Diagnostics& ds ): doc(dc),source(src),diagnostics(ds),it(src.begin()) {
+SyntaxContext::SyntaxContext( srcdesc dc, tokens& src, Diagnostics& ds, SyntaxCache* ce ): doc(dc),source(src),diagnostics(ds),it(src.begin()),fed(0),cache(ce) {
 }
 
-$signature SyntaxContext::extractSignature( bool diagnostic ) {
-    for( auto i = source.begin(); i != source.end(); i++ )
-        if( i->is(VT::U::SPACE,VT::U::C::BLOCK,VT::U::C::LINE) )
-            i.r.remove(i--.pos);
+void SyntaxContext::strip() {
+    tokens kept;
+    for( auto& t : source )
+        if( !t.is(VT::U::SPACE,VT::U::C::BLOCK,VT::U::C::LINE) ) kept.construct(-1, std::move(t));
+    source = std::move(kept);
+}
 
+void SyntaxContext::split() {
+    auto& all = cache->source;
+    int depth = 0;
+    for( int i = 0; i < all.size(); i++ ) {
+        auto& t = all[i];
+        if( t.is(VT::U::SPACE,VT::U::C::BLOCK,VT::U::C::LINE) ) {
+            continue;
+        } else if( t.is(VT::O::SC::O::A,VT::O::SC::O::L,VT::O::SC::O::S) ) {
+            depth += 1;
+        } else if( t.is(VT::O::SC::C::A,VT::O::SC::C::L,VT::O::SC::C::S) ) {
+            if( depth > 0 ) depth -= 1;
+        } else if( depth == 0 and t.is(VT::LET,VT::CLASS,VT::ENUM,VT::OPERATOR,VT::METHOD,VT::R::END) ) {
+            if( chunks.size() ) chunks.back().end = i;
+            if( t.is(VT::R::END) ) break;
+            chunks.push_back({i, i, -1, 0, 0xcbf29ce484222325ull});
+        }
+
+        /** 以FNV-1a累积记号的种类、位置和文本 */
+        if( chunks.empty() or chunks.back().end >= 0 ) continue;
+        auto& c = chunks.back();
+        auto mix = [&c]( const void* data, size_t size ) {
+            for( size_t j = 0; j < size; j++ ) c.key = (c.key ^ ((const uint8_t*)data)[j]) * 0x100000001b3ull; };
+        int head[] = {t.id, t.bl, t.bc, t.el, t.ec, (int)t.tx.size()};
+        mix(head, sizeof(head));
+        mix(t.tx.data(), t.tx.size());
+        c.last = i;
+        c.count += 1;
+    }
+}
+
+$definition SyntaxContext::reuse( $scope scope, int& index ) {
+    if( !cache or it.pos + 1 != source.size() ) return nullptr;
+    auto c = std::lower_bound(chunks.begin(), chunks.end(), fed - 1, []( const chunk& c, int pos ){ return c.begin < pos; });
+    if( c == chunks.end() or c->begin != fed - 1 ) return nullptr;
+    index = c - chunks.begin();
+
+    auto e = cache->entries.find(c->key);
+    if( e == cache->entries.end() ) return nullptr;
+    auto& [phrase, count, def] = e->second;
+    auto& last = cache->source[c->last];
+    if( count != c->count or phrase.bl != it->bl or phrase.bc != it->bc or phrase.el != last.el or phrase.ec != last.ec )
+        return nullptr;
+
+    *it = phrase;
+    fed = c->end;
+    return ($definition)def->clone(scope);
+}
+
+bool SyntaxContext::Reusable( $definition def ) {
+    auto plain = []( const callable& call ) {
+        for( auto arg : call.arguments ) if( arg->init and arg->init->is(node::LAMBDAEXPR) ) return false;
+        return true; };
+
+    if( auto cls = ($classdef)def; cls ) {
+        if( cls->supers.size() or cls->targf.size() or cls->preds.size() ) return false;
+        for( auto sub : cls->defs ) if( !Reusable(sub) ) return false;
+        return true;
+    } else if( auto met = ($metdef)def; met ) {
+        return plain(*met);
+    } else if( auto op = ($opdef)def; op ) {
+        return plain(*op);
+    } else {
+        return def->is(node::ALIASDEF) or def->is(node::ATTRIBUTEDEF);
+    }
+}
+
+$signature SyntaxContext::extractSignature( bool diagnostic ) {
+    strip();
     return movi(1), constructModuleSignature(diagnostic);
 }
 
@@ -756,11 +870,16 @@ $fragment SyntaxContext::constructFragment() {
     $fragment frag = new fragment;
     $definition def_padding;
     $implementation impl_padding;
+    std::map<uint64_t,SyntaxCache::entry> kept;
+    int index = -1;
 
-    for( auto i = source.begin(); i != source.end(); i++ )
-        if( i->is(VT::U::SPACE,VT::U::C::BLOCK,VT::U::C::LINE) )
-            i.r.remove(i--.pos);
-
+    if( cache ) {
+        split();
+    } else {
+        strip();
+        rest = std::move(source);
+        source = tokens();
+    }
     enter();
     movi(1,0);
     while( working() ) switch( states[-1] ) {
@@ -779,7 +898,11 @@ $fragment SyntaxContext::constructFragment() {
                 return nullptr;
             } break;
         case 3:
-            if( it->is(VT::LET) ) {
+            if( auto def = reuse(frag, index); def ) {
+                def_padding = def;
+                kept[chunks[index].key] = cache->entries[chunks[index].key];
+                index = -1;
+            } else if( it->is(VT::LET) ) {
                 def_padding = constructAliasDefinition(frag);
                 if( !def_padding ) return nullptr;
             } else if( it->is(VT::CLASS) ) {
@@ -795,9 +918,16 @@ $fragment SyntaxContext::constructFragment() {
                 impl_padding = constructMethodImplementation(frag);
                 if( !impl_padding ) return nullptr;
             } else if( it->is(VN::CLASSDEF,VN::ALIASDEF,VN::ENUMDEF) ) {
+                if( index >= 0 and Reusable(def_padding) ) {
+                    auto& c = chunks[index];
+                    if( it->el == cache->source[c.last].el and it->ec == cache->source[c.last].ec )
+                        kept[c.key] = {*it, c.count, ($definition)def_padding->clone(nullptr)};
+                }
+                index = -1;
                 frag->defs << def_padding;
                 stay();
             } else if( it->is(VN::METIMPL,VN::OPIMPL) ) {
+                index = -1;
                 frag->impls << impl_padding;
                 stay();
             } else if( it->is(VT::R::END) ) {
@@ -809,6 +939,7 @@ $fragment SyntaxContext::constructFragment() {
             return internal_error, nullptr;
     }
 
+    if( cache ) cache->entries = std::move(kept);
     frag->phrase = *it;
     return frag;
 }
@@ -0,0 +1,154 @@
+#ifndef __test_aipBatchedContent_cpp__
+#define __test_aipBatchedContent_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#include "../src/compiler.cpp"
+
+/**
+ * 以全交互模式驱动编译器诊断一个有许多模块的工作空间，检查文档内容请求的流水线：
+ *  IDE暂存收到的内容请求，直到通道空闲一段时间后才一并回答，每次一并回答算作一次往返
+ *  逐个等待响应的编译器每次往返只能发出一个请求，流水线化的编译器一次往返可以发出多个请求
+ * 同时在途的请求数必须大于一且不超过content_window，所有文档都被读取并且诊断没有错误
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    int count = argc > 2 ? stoi(argv[2]) : 150;
+    char work[] = "/tmp/alioth-batched-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    for( int i = 0; i < count; i++ ) {
+        auto os = ofstream(string(work) + "/src/m" + to_string(i) + ".alioth");
+        os << "module M" << i << (i ? " : M" + to_string(i-1) : string()) << "\nclass C" << i << " {\n    obj v int32\n}\n";
+    }
+
+    int c2i[2], i2c[2];
+    if( pipe(c2i) or pipe(i2c) ) return cerr << "cannot create pipes" << endl, 1;
+    auto channel = to_string(i2c[0]) + "/" + to_string(c2i[1]);
+    auto compiler = thread([&]{
+        const char* args[] = {"alioth", "--root", root, "--work", work, "v:", "2", "---", channel.data()};
+        BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args).execute();
+    });
+
+    auto ibuf = __gnu_cxx::stdio_filebuf<char>(c2i[0], ios::in);
+    auto is = istream(&ibuf);
+    auto send = [&]( json pack ) {
+        auto text = pack.toJsonString() + "\n";
+        return write(i2c[1], text.data(), text.size()) == (ssize_t)text.size();
+    };
+
+    /** 代替IDE回答编译器对工作空间的请求，内容请求被暂存到通道空闲时再一并回答 */
+    chainz<json> pending;
+    int contents = 0, trips = 0, widest = 0;
+    auto flush = [&] {
+        if( pending.size() == 0 ) return;
+        trips += 1;
+        widest = max(widest, pending.size());
+        for( auto& res : pending ) send(res);
+        pending.clear();
+    };
+    auto await = [&]( long seq ) -> json {
+        for( string line;; ) {
+            struct pollfd pfd = {c2i[0], POLLIN, 0};
+            if( ibuf.in_avail() <= 0 and poll(&pfd, 1, 5) == 0 ) {
+                flush();
+                continue;
+            }
+            if( !getline(is, line) ) break;
+            auto ls = istringstream(line);
+            auto pack = json::FromJsonStream(ls);
+            if( (string)pack["action"] == "respond" ) {
+                if( (long)pack["seq"] == seq and !pack.count("partial", json::boolean) ) return pack;
+                continue;
+            }
+            auto path = "/" + Uri::FromString((string)pack["uri"]).path;
+            json res = json::object;
+            res["seq"] = pack["seq"];
+            res["timestamp"] = 0L;
+            res["action"] = string("respond");
+            res["title"] = pack["title"];
+            res["status"] = 0L;
+            if( (string)pack["title"] == "content" ) {
+                auto fs = ifstream(path);
+                auto os = ostringstream();
+                if( fs ) os << fs.rdbuf(), res["data"] = os.str();
+                else res["status"] = 1L;
+                contents += 1;
+                pending << res;
+                continue;
+            }
+            json data = json::object;
+            if( auto dir = opendir(path.data()); dir ) {
+                while( auto ent = readdir(dir) ) {
+                    struct stat st;
+                    string name = ent->d_name;
+                    if( name == "." or name == ".." or stat((path + "/" + name).data(), &st) ) continue;
+                    json item = json::object;
+                    item["size"] = (long)st.st_size;
+                    item["mtime"] = (long)st.st_mtime;
+                    item["dir"] = (bool)S_ISDIR(st.st_mode);
+                    data[name] = item;
+                }
+                closedir(dir);
+            }
+            res["data"] = data;
+            send(res);
+        }
+        return json();
+    };
+    auto request = [&]( long seq, const string& title ) {
+        json pack = json::object;
+        pack["seq"] = seq;
+        pack["timestamp"] = 0L;
+        pack["action"] = string("request");
+        pack["title"] = title;
+        return pack;
+    };
+
+    auto start = chrono::steady_clock::now();
+    auto pack = request(1, "diagnostics");
+    pack["targets"] = json(json::array);
+    send(pack);
+    auto res = await(1);
+    auto ms = chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+    auto diagnostics = res.count("diagnostics", json::array) ? (long)res["diagnostics"].count() : -1L;
+    send(request(2, "exit"));
+    compiler.join();
+
+    cout << "diagnostics: " << diagnostics << " in " << ms << " ms" << endl;
+    cout << "content requests: " << contents << " in " << trips << " round trips, at most " << widest << " in flight" << endl;
+    return diagnostics == 0 and contents >= count and widest > 1 and widest <= SpaceEngine::content_window ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __test_aipFraming_cpp__
+#define __test_aipFraming_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ext/stdio_filebuf.h>
+#define private public // 直接驱动交互器的发送和接收过程
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#undef private
+
+/**
+ * 在管道上以交互器比较交互协议的两种分帧方式：
+ *  text: 每个包是一行Json文本，接收端逐字符解析以找到包的边界
+ *  binary: 每个包是一个0xA1加四字节大端序长度的帧头和MessagePack载荷，帧头和载荷以writev写出
+ * 发送端是Socket::sendPackage，接收端是哨兵线程使用的Socket::ReceiveFrame和Json文本解析
+ * 负载是编译器最常发送和接收的两种大包：携带大量诊断信息的响应和携带整个文档的内容响应
+ * 两种方式接收到的包必须与发送的包一致
+ * 最后检查畸形输入：超过上限的帧被跳过且流停在下一个帧上，嵌套过深的载荷被拒绝
+ */
+using namespace alioth;
+
+json diagnostics( int count ) {
+    json list = json::array;
+    for( int i = 0; i < count; i++ ) {
+        json item = json::object;
+        item["begin_line"] = (long)i;
+        item["begin_column"] = (long)(i % 80 + 1);
+        item["end_line"] = (long)i;
+        item["end_column"] = (long)(i % 80 + 6);
+        item["error_code"] = to_string(i % 120);
+        item["message"] = string("illegal token, expecting a definition here");
+        item["prefix"] = string("file:///work/src/module" + to_string(i % 50) + ".alioth");
+        item["severity"] = (long)1;
+        item["informations"] = json(json::array);
+        list[i] = item;
+    }
+    json pack = json::object;
+    pack["seq"] = 42L;
+    pack["action"] = string("respond");
+    pack["title"] = string("diagnostics");
+    pack["status"] = 0L;
+    pack["diagnostics"] = list;
+    return pack;
+}
+
+json content( int lines ) {
+    string data;
+    for( int i = 0; i < lines; i++ )
+        data += "    obj member" + to_string(i) + " int32 = \"" + to_string(i * 7 % 1000) + "\"\n";
+    json pack = json::object;
+    pack["seq"] = 43L;
+    pack["action"] = string("respond");
+    pack["title"] = string("content");
+    pack["status"] = 0L;
+    pack["data"] = data;
+    return pack;
+}
+
+/** 建立管道，发送端的交互器写入管道，返回读取管道的输入流 */
+Socket::$InputStream connect( Socket& tx ) {
+    int fds[2];
+    if( pipe(fds) != 0 ) return nullptr;
+    tx.out = new Socket::OutputStream(SpaceEngine::OpenStreamForWrite({scheme:"fd",host:to_string(fds[1]),port:0}));
+    tx.out->fd = fds[1];
+    Socket::$InputStream s = new Socket::InputStream(SpaceEngine::OpenStreamForRead({scheme:"fd",host:to_string(fds[0]),port:0}));
+    s->guard = nullptr;
+    return s;
+}
+
+/** 以哨兵线程的方式接收一个包 */
+json receive( Socket::$InputStream s ) {
+    while( isspace(s->is->peek()) ) s->is->get();
+    return s->is->peek() == (uint8_t)Socket::frame_magic ? Socket::ReceiveFrame(s) : json::FromJsonStream(*s->is);
+}
+
+/** 发送count个包，接收并解析，返回每秒处理的包数 */
+double transfer( const json& pack, int count, protocol::Framing framing, bool& consistent ) {
+    Socket tx;
+    auto s = connect(tx);
+    if( !s ) return 0;
+    Socket::SetFraming(framing);
+
+    auto writer = thread([&] {
+        for( int i = 0; i < count; i++ ) {
+            auto copy = pack;
+            tx.sendPackage(copy);
+        }
+        tx.out = nullptr;
+    });
+
+    auto start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ ) {
+        auto recv = receive(s);
+        if( i > 0 ) continue;
+        auto expect = pack;
+        expect["timestamp"] = recv["timestamp"];
+        consistent = consistent and recv.count("timestamp", json::integer) and recv.toJsonString() == expect.toJsonString();
+    }
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    writer.join();
+    return count / seconds;
+}
+
+/** 发送一个声明的载荷超过上限的帧，随后发送一个正常的包，前者被跳过，后者被完整接收 */
+bool oversized() {
+    Socket tx;
+    auto s = connect(tx);
+    if( !s ) return false;
+    Socket::SetFraming(protocol::BINARY);
+
+    auto writer = thread([&] {
+        size_t size = Socket::frame_limit + 1;
+        char head[5] = {Socket::frame_magic};
+        for( int i = 1; i < 5; i++ ) head[i] = (char)(size >> (4-i)*8);
+        auto chunk = string(1 << 16, '\xc0');
+        tx.out->os->write(head, sizeof(head));
+        for( size_t sent = 0; sent < size; sent += chunk.size() )
+            tx.out->os->write(chunk.data(), min(chunk.size(), size - sent));
+        auto pack = content(10);
+        tx.sendPackage(pack);
+        tx.out = nullptr;
+    });
+
+    bool skipped = false;
+    try { receive(s); } catch( exception& e ) { skipped = true; }
+    auto frame = s->frame.size();
+    json recv;
+    try { recv = receive(s); } catch( exception& e ) {}
+    writer.join();
+    return skipped and frame == 0 and recv.count("data", json::string) and (string)recv["data"] == (string)content(10)["data"];
+}
+
+/** 以depth层只有一个元素的数组包裹一个空值，返回能否解码 */
+bool nested( int depth ) {
+    auto payload = string(depth, '\x91') + '\xc0';
+    const char* begin = payload.data();
+    try { json::FromMsgPack(begin, begin + payload.size()); } catch( exception& e ) { return false; }
+    return true;
+}
+
+int main( int argc, char** argv ) {
+    int count = argc > 1 ? stoi(argv[1]) : 20;
+    bool consistent = true;
+    for( auto& [name,pack] : {pair<string,json>{"diagnostics", diagnostics(5000)}, pair<string,json>{"content", content(10000)}} ) {
+        string payload;
+        pack.toMsgPack(payload);
+        size_t text_size = pack.toJsonString().size() + 1, binary_size = payload.size() + 5;
+        auto text = transfer(pack, count, protocol::TEXT, consistent);
+        auto binary = transfer(pack, count, protocol::BINARY, consistent);
+        cout << name << ": text " << text_size << " bytes, " << text * text_size / (1<<20) << " MiB/s, " << text << " packets/s; "
+            << "binary " << binary_size << " bytes, " << binary * binary_size / (1<<20) << " MiB/s, " << binary << " packets/s" << endl;
+    }
+
+    bool skipped = oversized();
+    bool bounded = nested(64) and !nested(65) and !nested(100000);
+    cout << (consistent ? "consistent" : "inconsistent") << ", " << (skipped ? "oversized frame skipped" : "oversized frame accepted")
+        << ", " << (bounded ? "nesting bounded" : "nesting unbounded") << endl;
+    return consistent and skipped and bounded ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef __test_aipSharedDiagnostics_cpp__
+#define __test_aipSharedDiagnostics_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#include "../src/compiler.cpp"
+
+/**
+ * 以全交互模式驱动编译器，检查目标相同的诊断请求共享一次分析，以及取消请求的处理：
+ *  shared: 连续发送三个目标相同的诊断请求，只执行一次分析，三个请求都得到相同的最终响应
+ *  stray: 取消一个尚未发送的请求，取消被忽略，随后以该序列号发送的请求正常执行
+ *  cancel: 两个请求共享一次分析，取消其中一个，被取消的以CANCELED响应，另一个得到诊断信息
+ * 分析在同步模块时等待IDE回答枚举请求，因此在回答之前发送的请求总是与之共享或者排在其后
+ * 分析次数取自编译器结束时以Json报告的detect阶段的度量次数
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    char work[] = "/tmp/alioth-shared-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    ofstream(string(work) + "/src/a.alioth") << "module A\nclass Base {\n    obj v int32\n}\n";
+    ofstream(string(work) + "/src/b.alioth") << "module B : A\nclass User {\n    obj b A::Missing\n}\n";
+    auto report = string(work) + "/report.json";
+    auto ruri = "file://" + report;
+
+    int c2i[2], i2c[2];
+    if( pipe(c2i) or pipe(i2c) ) return cerr << "cannot create pipes" << endl, 1;
+    auto channel = to_string(i2c[0]) + "/" + to_string(c2i[1]);
+    auto compiler = thread([&]{
+        const char* args[] = {"alioth", "--root", root, "--work", work,
+            "--time-report-method", "json", "--time-report-to", ruri.data(), "v:", "2", "---", channel.data()};
+        BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args).execute();
+    });
+
+    auto ibuf = __gnu_cxx::stdio_filebuf<char>(c2i[0], ios::in);
+    auto is = istream(&ibuf);
+    auto send = [&]( json pack ) {
+        auto text = pack.toJsonString() + "\n";
+        return write(i2c[1], text.data(), text.size()) == (ssize_t)text.size();
+    };
+
+    /** 代替IDE回答编译器对工作空间的请求，直到收到序号为seq的最终响应，其他请求的最终响应被保存下来 */
+    map<long,json> finals;
+    auto await = [&]( long seq ) -> json {
+        for( string line; !finals.count(seq) and getline(is, line); ) {
+            auto ls = istringstream(line);
+            auto pack = json::FromJsonStream(ls);
+            if( (string)pack["action"] == "respond" ) {
+                if( !pack.count("partial", json::boolean) ) finals[(long)pack["seq"]] = pack;
+                continue;
+            }
+            auto path = "/" + Uri::FromString((string)pack["uri"]).path;
+            json res = json::object;
+            res["seq"] = pack["seq"];
+            res["timestamp"] = 0L;
+            res["action"] = string("respond");
+            res["title"] = pack["title"];
+            res["status"] = 0L;
+            if( (string)pack["title"] == "content" ) {
+                auto fs = ifstream(path);
+                auto os = ostringstream();
+                if( fs ) os << fs.rdbuf(), res["data"] = os.str();
+                else res["status"] = 1L;
+            } else {
+                json data = json::object;
+                if( auto dir = opendir(path.data()); dir ) {
+                    while( auto ent = readdir(dir) ) {
+                        struct stat st;
+                        string name = ent->d_name;
+                        if( name == "." or name == ".." or stat((path + "/" + name).data(), &st) ) continue;
+                        json item = json::object;
+                        item["size"] = (long)st.st_size;
+                        item["mtime"] = (long)st.st_mtime;
+                        item["dir"] = (bool)S_ISDIR(st.st_mode);
+                        data[name] = item;
+                    }
+                    closedir(dir);
+                }
+                res["data"] = data;
+            }
+            send(res);
+        }
+        return finals.count(seq) ? finals[seq] : json();
+    };
+    auto request = [&]( long seq, const string& title ) {
+        json pack = json::object;
+        pack["seq"] = seq;
+        pack["timestamp"] = 0L;
+        pack["action"] = string("request");
+        pack["title"] = title;
+        return pack;
+    };
+    auto diagnose = [&]( long seq ) {
+        auto pack = request(seq, "diagnostics");
+        pack["targets"] = json(json::array);
+        return send(pack);
+    };
+    auto cancel = [&]( long seq, long target ) {
+        auto pack = request(seq, "cancel");
+        pack["target"] = target;
+        return send(pack);
+    };
+    /** 最终响应的状态和诊断信息数量 */
+    auto result = [&]( long seq ) {
+        auto res = await(seq);
+        auto count = res.count("diagnostics", json::array) ? (long)res["diagnostics"].count() : -1L;
+        return pair<long,long>{res.count("status", json::integer) ? (long)res["status"] : -1L, count};
+    };
+
+    diagnose(1), diagnose(2), diagnose(3);
+    auto r1 = result(1), r2 = result(2), r3 = result(3);
+    bool shared = r1.first == 0 and r1.second > 0 and r2 == r1 and r3 == r1;
+
+    cancel(4, 5);
+    diagnose(5);
+    auto r5 = result(5);
+    bool stray = r5 == r1;
+
+    diagnose(6), diagnose(7), cancel(8, 6);
+    auto r6 = result(6), r7 = result(7);
+    bool canceled = r6.first == protocol::CANCELED and r7 == r1;
+
+    send(request(9, "exit"));
+    compiler.join();
+
+    long passes = -1;
+    auto rs = ifstream(report);
+    auto times = json::FromJsonStream(rs);
+    if( times.count("phases", json::array) ) for( const auto& phase : times["phases"] )
+        if( (string)phase["phase"] == "detect" ) passes = (long)phase["calls"];
+
+    cout << "shared: " << r1.second << "/" << r2.second << "/" << r3.second << " diagnostics, "
+        << "stray cancel: status " << r5.first << ", canceled: status " << r6.first << "/" << r7.first << endl;
+    cout << "analysis passes: " << passes << endl;
+    return shared and stray and canceled and passes == 3 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef __test_binarySymbol_cpp__
+#define __test_binarySymbol_cpp__
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <set>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+
+/**
+ * 度量二进制符号的构造，模块中的一个类拥有一万个重载的方法：
+ *  cold: 清空符号缓冲后为每个方法构造符号，作用域和参数原型都被重新书写
+ *  warm: 符号已被缓冲，按编号获取符号
+ * 所有方法的符号必须互不相同，运算符定义的名称必须写作单词形式
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    using namespace std::chrono;
+    int methods = argc > 1 ? stoi(argv[1]) : 10000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 10;
+
+    Diagnostics diagnostics;
+    SpaceEngine spaceEngine;
+    CompilerContext context(spaceEngine, diagnostics);
+    SemanticContext semantic(context, diagnostics);
+
+    /** 记号序列过长时词法和语法分析很慢，每五百个方法单独分析，再合并到第一个片段的类中
+     *  其余片段依然持有参数原型的作用域，它们也被挂载到模块上 */
+    const char* types[] = {"int8","int16","int32","int64","uint8","uint16","uint32","uint64","float32","float64"};
+    chainz<$fragment> parts;
+    $classdef cls;
+    for( int base = 0; base < methods; base += 500 ) {
+        auto source = string("module Bench\nclass Overloads {\n");
+        if( base == 0 ) source += "    operator <<( obj o int32 ) int32\n";
+        for( int i = base; i < methods and i < base + 500; i++ ) {
+            source += "    method put(";
+            for( int k = i, n = 0; n < 4; k /= 10, n++ ) source += (n ? ", obj a" : " obj a") + to_string(n) + " " + types[k % 10];
+            source += " ) int32\n";
+        }
+        source += "}\n";
+
+        auto is = istringstream(source);
+        auto lc = LexicalContext(is, false);
+        auto tokens = lc.perform();
+        auto sc = SyntaxContext({}, tokens, diagnostics);
+        auto part = sc.constructFragment();
+        if( !part ) return cerr << "syntax error" << endl, 1;
+        auto pc = ($classdef)part->defs[0];
+        parts << part;
+        if( !cls ) {
+            cls = pc;
+        } else {
+            for( auto def : pc->defs ) def->setScope(nullptr), def->setScope(cls);
+            cls->defs += pc->defs;
+        }
+    }
+
+    $signature sig = new signature;
+    sig->name = token("Bench");
+    sig->context = &context;
+    sig->docs[{}].fg = parts[0];
+    if( !semantic.associateModule(sig) ) return cerr << "cannot associate module" << endl, 1;
+    auto mod = semantic.getModule(sig);
+    for( auto& part : parts ) part->setScope(mod);
+
+    auto defs = cls->defs;
+
+    set<string> symbols;
+    auto cold = steady_clock::duration{};
+    for( int r = 0; r < rounds; r++ ) {
+        mod->sctx.clearCache();
+        auto start = steady_clock::now();
+        for( auto& def : defs ) SemanticContext::GetSymbolId(($node)def);
+        cold += steady_clock::now() - start;
+    }
+
+    auto warm = steady_clock::duration{};
+    for( int r = 0; r < rounds; r++ ) {
+        auto start = steady_clock::now();
+        for( auto& def : defs ) SemanticContext::GetSymbolId(($node)def);
+        warm += steady_clock::now() - start;
+    }
+
+    for( auto& def : defs ) symbols.insert(SemanticContext::GetBinarySymbol(($node)def));
+    auto op = SemanticContext::GetBinarySymbol(($node)defs[0]);
+
+    auto per = [&]( steady_clock::duration d ) { return duration_cast<nanoseconds>(d).count() / (double)rounds / defs.size(); };
+    cout << "cold: " << per(cold) << " ns per symbol" << endl;
+    cout << "warm: " << per(warm) << " ns per symbol" << endl;
+    cout << symbols.size() << " distinct symbols, " << op << endl;
+    return (int)symbols.size() == defs.size() and op == "operator:Bench::Overloads::shl(obj:int32=>obj:int32)" ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef __test_depgraphOrder_cpp__
+#define __test_depgraphOrder_cpp__
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+
+/**
+ * 构造依赖关系图，检查调度所依据的顺序：
+ *  order: 随机的无环图中，每条边的被依赖者在拓扑序中都排在依赖者之前，每个节点各出现一次
+ *  cycle: 图中的环路恰好构成一个强连通分量，提取的环路从分量的首个节点出发并回到首个节点
+ *  none: 无环图中的每个分量都只有一个节点，从中提取不到环路
+ * 最后度量大图计算拓扑序的用时
+ */
+using namespace alioth;
+
+$signature named( const string& name ) {
+    $signature sig = new signature;
+    sig->name = token(name);
+    return sig;
+}
+
+$depdesc dependency( $signature to ) {
+    $depdesc dep = new depdesc;
+    dep->name = to->name;
+    return dep;
+}
+
+/** 以n个节点构造随机的无环图，边总是由序号大的节点指向序号小的节点，节点按照打乱的顺序插入 */
+DependencyGraph acyclic( int n, int degree, signatures& sigs, mt19937& rng ) {
+    DependencyGraph graph;
+    sigs = signatures();
+    for( int i = 0; i < n; i++ ) sigs << named("M" + to_string(i));
+    vector<int> order(n);
+    for( int i = 0; i < n; i++ ) order[i] = i;
+    shuffle(order.begin(), order.end(), rng);
+    for( auto i : order ) {
+        graph.insert(sigs[i]);
+        for( int d = 0; i > 0 and d < degree; d++ ) {
+            auto j = (int)(rng() % i);
+            graph.connect(sigs[i], dependency(sigs[j]), sigs[j]);
+        }
+    }
+    return graph;
+}
+
+/** 检查每条边的被依赖者都排在依赖者之前 */
+bool ordered( const DependencyGraph& graph, const signatures& sigs ) {
+    map<$signature,int> index;
+    for( auto sig : graph.topological() ) if( !index.emplace(sig, index.size()).second ) return false;
+    if( index.size() != sigs.size() ) return false;
+    for( auto sig : sigs ) for( auto& e : graph.dependencies(sig) )
+        if( index[e.to] >= index[e.from] ) return false;
+    return true;
+}
+
+int main( int argc, char** argv ) {
+    auto rng = mt19937(2024);
+    signatures sigs;
+
+    bool order = true, none = true;
+    for( int round = 0; round < 50; round++ ) {
+        auto graph = acyclic(40, 3, sigs, rng);
+        order = order and ordered(graph, sigs);
+        for( auto& c : graph.components() ) none = none and c.size() == 1 and graph.cycle(c).size() == 0;
+    }
+
+    /** A依赖B，B依赖C和D，C依赖A，D不在环路上 */
+    DependencyGraph graph;
+    auto a = named("A"), b = named("B"), c = named("C"), d = named("D");
+    graph.connect(a, dependency(b), b);
+    graph.connect(b, dependency(c), c);
+    graph.connect(b, dependency(d), d);
+    graph.connect(c, dependency(a), a);
+    bool cycle = false;
+    int loops = 0;
+    for( auto& comp : graph.components() ) {
+        if( comp.size() == 1 ) continue;
+        loops += 1;
+        auto edges = graph.cycle(comp);
+        cycle = comp.size() == 3 and edges.size() == 3 and edges[0].from == comp[0] and edges[-1].to == comp[0];
+        for( int i = 1; i < edges.size(); i++ ) cycle = cycle and edges[i].from == edges[i-1].to;
+    }
+    auto topo = graph.topological();
+    cycle = cycle and loops == 1 and topo.size() == 4 and topo[0] == d;
+
+    int n = argc > 1 ? stoi(argv[1]) : 20000;
+    auto large = acyclic(n, 4, sigs, rng);
+    auto start = chrono::steady_clock::now();
+    auto sorted = large.topological();
+    auto ms = chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+    order = order and ordered(large, sigs);
+
+    cout << "topological: " << n << " modules in " << ms << " ms" << endl;
+    cout << (order ? "ordered" : "misordered") << ", " << (cycle ? "cycle extracted" : "cycle missed") << ", "
+        << (none ? "no false cycles" : "false cycles") << endl;
+    return order and cycle and none ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __test_diagnosticAlloc_cpp__
+#define __test_diagnosticAlloc_cpp__
+
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <new>
+
+/**
+ * 统计诊断信息在错误密集的编译中各个阶段的内存分配次数：
+ *  switch: 没有错误时，检查每个文档之前切换诊断前缀
+ *  report: 并行检查的每个任务在自己的容器中生成诊断信息
+ *  merge: 任务结束后按固定顺序将诊断信息合并到编译器的容器
+ *  print: 以字符串和Json两种方式一次性打印全部诊断信息
+ *  stream: 以字符串和Json Lines两种方式逐条格式化到同一个缓冲，编译器流式输出诊断信息时的做法
+ */
+using namespace alioth;
+
+static std::atomic<long> allocations = 0;
+
+void* operator new( size_t size ) {
+    allocations += 1;
+    if( auto p = malloc(size) ) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept {
+    free(p);
+}
+
+void operator delete( void* p, size_t ) noexcept {
+    free(p);
+}
+
+int main( int argc, char** argv ) {
+    string json_path = argc > 1 ? argv[1] : "doc/diagnostic.json";
+    int documents = argc > 2 ? stoi(argv[2]) : 200;
+    int errors = argc > 3 ? stoi(argv[3]) : 25;
+
+    auto is = ifstream(json_path);
+    DiagnosticEngine engine;
+    if( !engine.configure(json::FromJsonStream(is)) ) return cerr << "bad configuration" << endl, 1;
+
+    vector<string> uris;
+    for( int i = 0; i < documents; i++ ) uris.push_back("file:///work/project/src/module" + to_string(i) + ".alioth");
+    auto measure = [&]( const char* name, auto&& work ) {
+        auto before = allocations.load();
+        work();
+        cout << name << ": " << allocations.load() - before << " allocations" << endl;
+    };
+
+    Diagnostics diagnostics;
+    measure("switch", [&] {
+        for( int round = 0; round < 100; round++ )
+            for( auto& uri : uris ) diagnostics[uri];
+    });
+
+    vector<Diagnostics> tasks(documents);
+    measure("report", [&] {
+        for( int i = 0; i < documents; i++ )
+            for( int k = 0; k < errors; k++ ) tasks[i][uris[i]]("97", token("Nope" + to_string(k)));
+    });
+
+    measure("merge", [&] {
+        for( auto& task : tasks ) diagnostics += task;
+    });
+
+    size_t bytes = 0;
+    measure("print", [&] {
+        for( auto& line : engine.printToString(diagnostics) ) bytes += line.size();
+        bytes += engine.printToJson(diagnostics).toJsonString().size();
+    });
+
+    string buffer;
+    size_t streamed = 0;
+    measure("stream", [&] {
+        for( const auto& d : diagnostics ) {
+            buffer.clear();
+            engine.printToString(d, buffer);
+            buffer += '\n';
+            engine.printToJson(d).toJsonString(buffer);
+            buffer += '\n';
+            streamed += buffer.size();
+        }
+    });
+
+    cout << diagnostics.size() << " diagnostics, " << bytes << " bytes printed, " << streamed << " bytes streamed" << endl;
+    return diagnostics.size() == documents * errors ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef __test_diagnosticCatalog_cpp__
+#define __test_diagnosticCatalog_cpp__
+
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+
+/**
+ * 比较诊断引擎启动时的两种配置方式：
+ *  json: 读取diagnostic.json，解析Json并逐条构造诊断模板
+ *  catalog: 检查diagnostic.json的修改时间和尺寸，映射预编译的诊断目录，打印时二分查找映射的模板表
+ * 两种方式对配置文件中的每一个诊断代码打印的诊断信息必须一致，多个线程同时打印时结果也必须一致
+ * 修改时间或尺寸不符的目录必须被拒绝
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    using namespace std::chrono;
+    string json_path = argc > 1 ? argv[1] : "doc/diagnostic.json";
+    string catalog_path = argc > 2 ? argv[2] : "/tmp/alioth-diagnostic.cat";
+    int rounds = argc > 3 ? stoi(argv[3]) : 200;
+
+    auto read = [&] {
+        auto is = ifstream(json_path, ios::binary);
+        auto os = ostringstream();
+        os << is.rdbuf();
+        return os.str();
+    };
+    auto source = read();
+    if( source.empty() ) return cerr << "cannot read " << json_path << endl, 1;
+    auto stamp = [&]( struct stat& st ) { return stat(json_path.data(), &st) == 0; };
+    struct stat st;
+    if( !stamp(st) ) return cerr << "cannot stat " << json_path << endl, 1;
+    auto ss = istringstream(source);
+    auto config = json::FromJsonStream(ss);
+
+    DiagnosticEngine compiled;
+    if( !compiled.configure(config) ) return cerr << "bad configuration" << endl, 1;
+    if( !compiled.saveCatalog(catalog_path, st.st_mtime, st.st_size) ) return cerr << "cannot write " << catalog_path << endl, 1;
+
+    auto start = steady_clock::now();
+    for( int i = 0; i < rounds; i++ ) {
+        DiagnosticEngine engine;
+        auto is = istringstream(read());
+        engine.configure(json::FromJsonStream(is));
+    }
+    auto json_us = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0 / rounds;
+
+    start = steady_clock::now();
+    for( int i = 0; i < rounds; i++ ) {
+        DiagnosticEngine engine;
+        struct stat now;
+        if( !stamp(now) or !engine.loadCatalog(catalog_path, now.st_mtime, now.st_size) ) return cerr << "catalog rejected" << endl, 1;
+    }
+    auto catalog_us = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0 / rounds;
+
+    DiagnosticEngine from_json, from_catalog;
+    from_json.configure(config);
+    DiagnosticEngine stale;
+    bool rejected = !stale.loadCatalog(catalog_path, st.st_mtime + 1, st.st_size) and !stale.loadCatalog(catalog_path, st.st_mtime, st.st_size + 1);
+    if( !from_catalog.loadCatalog(catalog_path, st.st_mtime, st.st_size) ) return cerr << "catalog rejected" << endl, 1;
+    int checked = 0;
+    bool consistent = from_json.enumerateLanguages().size() == from_catalog.enumerateLanguages().size();
+    config["languages"].for_each([&]( const string& lang, const json& conf ) -> bool {
+        from_json.selectLanguage(lang);
+        from_catalog.selectLanguage(lang);
+        conf["templates"].for_each([&]( const string& code, const json& ) -> bool {
+            Diagnostic d("prefix", code, "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8", "a9");
+            consistent = consistent and from_json.printToString(d) == from_catalog.printToString(d);
+            consistent = consistent and from_json.printToJson(d).toJsonString() == from_catalog.printToJson(d).toJsonString();
+            checked += 1;
+            return true;
+        });
+
+        /** 多个线程同时查找映射的模板表 */
+        vector<string> expected;
+        conf["templates"].for_each([&]( const string& code, const json& ) -> bool {
+            expected.push_back(from_json.printToString(Diagnostic("prefix", code, "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8", "a9")));
+            return true;
+        });
+        vector<thread> printers;
+        vector<char> agreed(8, 1);
+        for( int t = 0; t < 8; t++ ) printers.emplace_back([&, t]{
+            for( int r = 0; r < 20; r++ ) {
+                size_t i = 0;
+                conf["templates"].for_each([&]( const string& code, const json& ) -> bool {
+                    Diagnostic d("prefix", code, "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7", "a8", "a9");
+                    agreed[t] = agreed[t] and from_catalog.printToString(d) == expected[i++];
+                    return true;
+                });
+            }
+        });
+        for( auto& t : printers ) t.join();
+        for( auto a : agreed ) consistent = consistent and a;
+        return true;
+    });
+
+    cout << "json: " << json_us << " us; catalog: " << catalog_us << " us; "
+        << checked << " templates checked, " << (consistent ? "consistent" : "inconsistent") << ", "
+        << (rejected ? "stale catalog rejected" : "stale catalog accepted") << endl;
+    return consistent and rejected ? 0 : 1;
+}
+
+#endif
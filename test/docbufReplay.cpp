@@ -0,0 +1,299 @@
+#ifndef __test_docbufReplay_cpp__
+#define __test_docbufReplay_cpp__
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+
+/**
+ * 重放编辑会话，度量全交互模式下逐键编辑和随后的模块同步：
+ *  update: 空间引擎将UPDATE请求中的编辑操作应用于文档缓冲
+ *  resync: 诊断请求开始时同步模块，文档因缓冲的修改时间变化而被重新读取
+ *  flat: 整个文档存储在一个字符串中，定位行列时从头扫描，作为对照和参考结果
+ *  syntax: 每次编辑后增量扫描文档并复用未改变的顶层定义构建片段
+ *  full: 完整地扫描和分析文档，每隔若干次编辑执行一次，作为对照和参考结果
+ *  members: 编辑成员定义，文档始终合法，没有被编辑也没有移动的顶层定义被复用
+ * 会话文件的每一行是一个UPDATE请求包，可以直接截取IDE发给编译器的输入
+ * 没有给出会话文件时，在一万行的文档上模拟随机位置的连续输入、退格和换行，每四十次编辑同步一次
+ * 第一个整体替换的文本作为磁盘上的文档，同步后模块记录的文档大小必须与参考结果一致
+ * 增量分析的词法序列必须与完整分析的一致，两者构建的片段必须有相同的短语和顶层结构
+ * 只存在于缓冲中的新文档必须出现在空间的枚举结果中
+ * 最后释放缓冲，再次同步后文档必须回到磁盘上的内容
+ */
+using namespace alioth;
+using edit = protocol::Parameter::Request::Update::edit;
+
+/** 从会话文件读取所有UPDATE请求中的编辑操作 */
+vector<edit> load( const char* path ) {
+    vector<edit> edits;
+    auto is = ifstream(path);
+    for( string line; getline(is, line); ) {
+        if( line.empty() ) continue;
+        auto ls = istringstream(line);
+        auto pack = json::FromJsonStream(ls);
+        if( !pack.is(json::object) or !pack.count("edits", json::array) ) continue;
+        if( pack.count("title", json::string) and (string)pack["title"] != "update" ) continue;
+        for( const auto& item : pack["edits"] ) {
+            auto& e = edits.emplace_back();
+            if( item.count("offset", json::integer) ) e.offset = (long)item["offset"];
+            if( item.count("line", json::integer) ) e.line = (long)item["line"];
+            if( item.count("column", json::integer) ) e.column = (long)item["column"];
+            if( item.count("length", json::integer) ) e.length = (long)item["length"];
+            if( item.count("text", json::string) ) e.text = (string)item["text"];
+        }
+    }
+    return edits;
+}
+
+/** 模拟在lines行、每个类定义二十个成员的文档中输入：每次跳转到随机行，以行列定位，随后以偏移连续编辑，模块签名所在的行不被编辑 */
+vector<edit> simulate( int lines, int keystrokes ) {
+    vector<edit> edits;
+    string doc = "module Replay\n";
+    for( int i = 0; i < lines; i++ ) {
+        if( i % 20 == 0 ) doc += "class Members" + to_string(i / 20) + " {\n";
+        doc += "    obj member" + to_string(i) + " int" + to_string(8 << i % 4) + "\n";
+        if( i % 20 == 19 or i + 1 == lines ) doc += "}\n";
+    }
+    edits.push_back({-1, 0, 0, 0, doc});
+
+    auto rng = mt19937(20191019);
+    auto alphabet = string("abcdefghijklmnopqrstuvwxyz0123456789 +-*/=()");
+    long cursor = 0;
+    for( int k = 0; k < keystrokes; k++ ) {
+        if( k % 40 == 0 ) {
+            long line = rng() % lines + 3;
+            long column = rng() % 8 + 1;
+            cursor = 0;
+            for( long l = 1; l < line; l++ ) cursor = doc.find('\n', cursor) + 1;
+            cursor += column - 1;
+            edits.push_back({-1, line, column, 0, string(1, alphabet[rng() % alphabet.size()])});
+        } else if( rng() % 10 == 0 and cursor > 0 and doc[cursor-1] != '\n' ) {
+            cursor -= 1;
+            edits.push_back({cursor, 0, 0, 1, ""});
+        } else {
+            auto c = rng() % 25 == 0 ? string("\n") : string(1, alphabet[rng() % alphabet.size()]);
+            edits.push_back({cursor, 0, 0, 0, c});
+        }
+        auto& e = edits.back();
+        auto at = e.offset >= 0 ? e.offset : cursor;
+        doc.replace(at, e.length, e.text);
+        cursor = at + e.text.size();
+    }
+    return edits;
+}
+
+/** 模拟编辑成员定义：每十次编辑在随机的成员定义之前插入一行新的成员定义，其余编辑在随机的成员名之后输入一个字母，文档始终合法 */
+vector<edit> members( string doc, int count ) {
+    vector<edit> edits = {{-1, 0, 0, 0, doc}};
+    auto rng = mt19937(20191020);
+    for( int k = 0; k < count; k++ ) {
+        auto at = doc.find("\n    obj ", rng() % doc.size());
+        if( at == string::npos ) at = doc.find("\n    obj ");
+        if( at == string::npos ) break;
+        if( k % 10 == 0 ) edits.push_back({(long)at + 1, 0, 0, 0, "    obj added" + to_string(k) + " int32\n"});
+        else edits.push_back({(long)doc.find(' ', at + 9), 0, 0, 0, "x"});
+        doc.insert(edits.back().offset, edits.back().text);
+    }
+    return edits;
+}
+
+/** 将编辑操作应用于整个存储在一个字符串中的文档，定位行列时从头扫描 */
+bool patch( string& flat, const edit& e ) {
+    size_t offset = e.offset;
+    if( e.offset < 0 and e.line <= 0 ) return flat = e.text, true;
+    if( e.offset < 0 ) {
+        offset = 0;
+        for( long l = 1; l < e.line; l++ ) offset = flat.find('\n', offset) + 1;
+        offset += max(e.column, 1L) - 1;
+    }
+    if( offset > flat.size() or (size_t)e.length > flat.size() - offset ) return false;
+    flat.replace(offset, e.length, e.text);
+    return true;
+}
+
+/** 比较两个词法序列的种类、文本和位置 */
+bool same( tokens& a, tokens& b ) {
+    if( a.size() != b.size() ) return false;
+    for( int i = 0; i < a.size(); i++ ) {
+        auto &x = a[i], &y = b[i];
+        if( x.id != y.id or x.tx != y.tx or x.bl != y.bl or x.bc != y.bc or x.el != y.el or x.ec != y.ec ) return false;
+    }
+    return true;
+}
+
+/** 比较两个片段的短语以及每个顶层定义和实现的短语 */
+bool same( $fragment a, $fragment b ) {
+    if( !a or !b ) return !a and !b;
+    auto phrase = []( const token& x, const token& y ) {
+        return x.id == y.id and x.tx == y.tx and x.bl == y.bl and x.bc == y.bc and x.el == y.el and x.ec == y.ec; };
+    if( !phrase(a->phrase, b->phrase) or a->defs.size() != b->defs.size() or a->impls.size() != b->impls.size() ) return false;
+    for( int i = 0; i < a->defs.size(); i++ )
+        if( !phrase(a->defs[i]->phrase, b->defs[i]->phrase) or a->defs[i]->getScope() != (fragment*)a ) return false;
+    for( int i = 0; i < a->impls.size(); i++ )
+        if( !phrase(a->impls[i]->phrase, b->impls[i]->phrase) ) return false;
+    return true;
+}
+
+/**
+ * 逐键重新分析文档的语法，与编译器在全交互模式下的做法相同：
+ * 增量扫描文档，以语法缓存构建片段，复用未改变的顶层定义
+ * 每interval次编辑完整地分析一次作为对照，返回增量分析的结果是否始终与完整分析一致
+ */
+bool reparse( const vector<edit>& edits, size_t count, int interval, vector<double>& syntax_us, vector<double>& full_us ) {
+    using namespace std::chrono;
+    auto desc = srcdesc{flags:WORK|SRC|DOCUMENT, name:"replay.alioth"};
+    string flat;
+    SyntaxCache cache;
+    bool consistent = true;
+    for( size_t i = 0; i < edits.size() and i < count; i++ ) {
+        if( !patch(flat, edits[i]) ) return false;
+
+        auto start = steady_clock::now();
+        LexicalContext::Relex(cache.text, cache.source, flat);
+        tokens source;
+        Diagnostics ds;
+        auto fg = SyntaxContext(desc, source, ds[string("replay")], &cache).constructFragment();
+        syntax_us.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+
+        if( i % interval == 0 or i + 1 == edits.size() or i + 1 == count ) {
+            start = steady_clock::now();
+            auto is = istringstream(flat);
+            auto tokens = LexicalContext(is).perform();
+            auto lexed = tokens;
+            Diagnostics fds;
+            auto ref = SyntaxContext(desc, tokens, fds[string("replay")]).constructFragment();
+            full_us.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+            consistent = consistent and same(cache.source, lexed) and same(fg, ref);
+        }
+    }
+    return consistent;
+}
+
+/** 统计每个操作的延迟，单位为微秒 */
+void report( const char* name, vector<double>& us ) {
+    sort(us.begin(), us.end());
+    double sum = 0;
+    for( auto t : us ) sum += t;
+    cout << name << ": " << us.size() << " ops, avg " << sum / us.size()
+        << " us, p50 " << us[us.size() / 2] << " us, p99 " << us[us.size() * 99 / 100]
+        << " us, max " << us.back() << " us" << endl;
+}
+
+int main( int argc, char** argv ) {
+    using namespace std::chrono;
+
+    auto edits = argc > 1 ? load(argv[1]) : simulate(10000, 20000);
+    int interval = argc > 2 ? stoi(argv[2]) : 40;
+    size_t keystrokes = argc > 3 ? stoul(argv[3]) : 1000;
+    if( edits.empty() or edits[0].offset >= 0 or edits[0].line > 0 ) return cerr << "no initial text" << endl, 1;
+
+    char work[] = "/tmp/alioth-replay-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    ofstream(string(work) + "/src/replay.alioth") << edits[0].text;
+
+    Diagnostics diagnostics;
+    SpaceEngine spaceEngine;
+    CompilerContext context(spaceEngine, diagnostics);
+    if( !spaceEngine.setMainSpaceMapping(WORK, work) ) return cerr << "cannot map workspace" << endl, 1;
+    context.loadModules({flags:WORK});
+    auto desc = srcdesc{flags:WORK|SRC|DOCUMENT, name:"replay.alioth"};
+    auto uri = spaceEngine.getUri(desc);
+
+    /** 同步后模块记录的文档大小 */
+    auto synced = [&]() -> long {
+        for( auto sig : context.getModules({flags:WORK}) )
+            for( auto& [doc,_] : sig->docs ) if( doc.name == desc.name ) return doc.size;
+        return -1;
+    };
+
+    vector<double> update_us, resync_us;
+    for( size_t i = 0; i < edits.size(); i++ ) {
+        chainz<edit> request;
+        request << edits[i];
+        auto start = steady_clock::now();
+        if( !spaceEngine.updateDocument(uri, request) ) return cerr << "update: bad edit" << endl, 1;
+        update_us.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+
+        if( i % interval == 0 or i + 1 == edits.size() ) {
+            start = steady_clock::now();
+            context.syncModules({flags:WORK});
+            resync_us.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+        }
+    }
+
+    string flat;
+    vector<double> flat_us;
+    for( auto& e : edits ) {
+        auto start = steady_clock::now();
+        if( !patch(flat, e) ) return cerr << "flat: bad edit" << endl, 1;
+        flat_us.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1000.0);
+    }
+
+    vector<double> syntax_us, full_us, members_us, reference_us;
+    bool consistent = reparse(edits, keystrokes, interval, syntax_us, full_us)
+        and reparse(members(edits[0].text, keystrokes / 4), keystrokes, interval, members_us, reference_us);
+
+    /** 只存在于缓冲中的新文档出现在空间的枚举结果中 */
+    auto fresh = srcdesc{flags:WORK|SRC|DOCUMENT, name:"fresh.alioth"};
+    edit whole = {-1, 0, 0, 0, "module Fresh\n"};
+    chainz<edit> create;
+    create << whole;
+    bool listed = false;
+    if( spaceEngine.updateDocument(spaceEngine.getUri(fresh), create) )
+        for( auto& desc : spaceEngine.enumerateContents({flags:WORK|SRC}) )
+            if( desc.name == fresh.name and desc.isDocument() and desc.size == create[0].text.size() ) listed = true;
+    spaceEngine.releaseDocument(spaceEngine.getUri(fresh));
+
+    auto os = ostringstream();
+    os << spaceEngine.openDocumentForRead(desc)->rdbuf();
+    bool edited = os.str() == flat and synced() == (long)flat.size();
+
+    /** 释放缓冲后，文档回到磁盘上的内容 */
+    spaceEngine.releaseDocument(uri);
+    context.syncModules({flags:WORK});
+    os = ostringstream();
+    os << spaceEngine.openDocumentForRead(desc)->rdbuf();
+    bool released = os.str() == edits[0].text and synced() == (long)edits[0].text.size();
+
+    report("update", update_us);
+    report("resync", resync_us);
+    report("flat", flat_us);
+    report("syntax", syntax_us);
+    report("full", full_us);
+    report("members", members_us);
+    report("reference", reference_us);
+    cout << "document: " << flat.size() << " bytes, " << count(flat.begin(), flat.end(), '\n') << " lines, "
+        << (edited ? "synced" : "out of sync") << ", " << (released ? "released" : "still buffered") << ", "
+        << (consistent ? "incremental syntax consistent" : "incremental syntax inconsistent") << ", "
+        << (listed ? "new buffer listed" : "new buffer missing") << endl;
+
+    remove((string(work) + "/src/replay.alioth").data());
+    rmdir((string(work) + "/src").data());
+    rmdir(work);
+    return edited and released and consistent and listed ? 0 : 1;
+}
+
+#endif
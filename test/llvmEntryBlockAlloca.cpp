@@ -0,0 +1,101 @@
+#ifndef __test_llvmEntryBlockAlloca_cpp__
+#define __test_llvmEntryBlockAlloca_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Verifier.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#define protected public // 读取编译器收集的诊断信息
+#include "../src/compiler.cpp"
+#undef protected
+
+/**
+ * 经由编译器翻译一个模块，检查方法实现中局部元素的两种处理方式：
+ *  slot: 被修改的参数存入栈空间，栈空间分配在入口块中，可以被mem2reg提升
+ *  ssa: 未被修改且未被取地址的参数和局部元素直接作为SSA值使用
+ * 被赋值的参数b和局部元素d拥有栈空间，d在b被存储之后才声明，它的栈空间仍然位于入口块的开头
+ * 方法必须被完整地翻译：没有诊断信息，函数能通过校验，并且入口块中所有栈空间分配都在其他指令之前
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    char work[] = "/tmp/alioth-entry-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    mkdir((string(work) + "/obj").data(), 0755);
+    ofstream(string(work) + "/src/a.alioth") <<
+        "module A\n"
+        "class C {\n"
+        "    method f( obj a int32, obj b int32 ) int32\n"
+        "}\n"
+        "method C::f( obj a int32, obj b int32 ) int32 {\n"
+        "    obj c int32 = a\n"
+        "    obj d int32 = c\n"
+        "    b = c\n"
+        "    d = b\n"
+        "    return d\n"
+        "}\n";
+
+    const char* args[] = {"alioth", "--root", root, "--work", work, "i:", "out", "A"};
+    auto saved = dup(1); // 诊断流关闭时会关闭标准输出
+    auto compiler = BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args);
+    auto ret = compiler.execute();
+    auto diagnostics = compiler.diagnostics.size();
+    dup2(saved, 1);
+    if( ret != 0 or diagnostics ) return cerr << "translation failed with " << diagnostics << " diagnostics" << endl, 1;
+
+    auto context = llvm::LLVMContext();
+    auto error = llvm::SMDiagnostic();
+    auto module = llvm::parseIRFile(string(work) + "/obj/A.ll", error, context);
+    if( !module ) return error.print("A.ll", llvm::errs()), 1;
+    auto fp = module->getFunction("method:A::C::f(obj:int32,obj:int32=>obj:int32)");
+    if( !fp ) return cerr << "method not translated" << endl, 1;
+    string ir;
+    auto os = llvm::raw_string_ostream(ir);
+    fp->print(os);
+    cout << os.str();
+
+    set<string> slots;
+    bool misplaced = false;
+    for( auto& bb : *fp ) {
+        bool leading = &bb == &fp->getEntryBlock();
+        for( auto& inst : bb ) if( auto alloca = llvm::dyn_cast<llvm::AllocaInst>(&inst); alloca ) {
+            if( !leading ) misplaced = true;
+            slots.insert(alloca->getName().str());
+        } else leading = false;
+    }
+    bool verified = !llvm::verifyFunction(*fp, &llvm::errs());
+    return verified and !misplaced and slots == set<string>{"b.addr","d.addr"} ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __test_llvmFingerprintSkip_cpp__
+#define __test_llvmFingerprintSkip_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#include "../src/compiler.cpp"
+
+/**
+ * 经由编译器反复产生模块A和依赖A的模块B的目标文件，检查目标文件指纹对代码生成的裁剪：
+ *  again: 源代码没有改变，没有目标文件被重新产生
+ *  spacing: 只改变A中的空白，记号序列的摘要不变，没有目标文件被重新产生
+ *  body: 改变A的方法实现，A的接口不变，只有A.o被重新产生
+ *  interface: 为A的类增加方法，A的接口改变，A.o和依赖A的B.o都被重新产生
+ * alioth.o只在首次编译时产生，此后每一步都复用它
+ */
+using namespace alioth;
+
+const char* head = "module A\nclass C {\n    method f( obj a int32 ) int32\n";
+const char* impl = "method C::f( obj a int32 ) int32 {\n    return a\n}\n";
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    char work[] = "/tmp/alioth-fingerprint-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    mkdir((string(work) + "/obj").data(), 0755);
+    auto src = string(work) + "/src/";
+    auto obj = string(work) + "/obj/";
+    ofstream(src + "a.alioth") << head << "}\n" << impl;
+    ofstream(src + "b.alioth") << "module B : A\nclass D {\n    obj c A::C\n}\n";
+
+    /** 以修改时间识别重新产生的目标文件 */
+    auto stamp = [&]( const string& name ) -> long {
+        struct stat st;
+        if( stat((obj + name).data(), &st) ) return -1;
+        return st.st_mtim.tv_sec * 1000000000L + st.st_mtim.tv_nsec;
+    };
+    auto compile = [&]() -> string {
+        auto stamps = map<string,long>{{"A.o", stamp("A.o")}, {"B.o", stamp("B.o")}, {"alioth.o", stamp("alioth.o")}};
+        usleep(20000);
+        const char* args[] = {"alioth", "--root", root, "--work", work, "s:", "lib", "A", "B"};
+        auto saved = dup(1); // 诊断流关闭时会关闭标准输出
+        auto ret = BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args).execute();
+        dup2(saved, 1);
+        close(saved);
+        if( ret != 0 ) return "failed";
+        string rebuilt;
+        for( auto& [name,time] : stamps ) if( auto now = stamp(name); now < 0 or now != time ) rebuilt += (rebuilt.size() ? "," : "") + name;
+        return rebuilt.size() ? rebuilt : "none";
+    };
+
+    auto first = compile();
+    auto again = compile();
+    ofstream(src + "a.alioth") << head << "}\n\n" << "method C::f(obj a int32) int32 {\n        return a\n}\n";
+    auto spacing = compile();
+    ofstream(src + "a.alioth") << head << "}\n" << "method C::f( obj a int32 ) int32 {\n    return 1\n}\n";
+    auto body = compile();
+    ofstream(src + "a.alioth") << head << "    method g() int32\n}\n" << impl << "method C::g() int32 {\n    return 2\n}\n";
+    auto interface = compile();
+
+    cout << "rebuilt: first " << first << "; again " << again << "; spacing " << spacing
+        << "; body " << body << "; interface " << interface << endl;
+    return first == "A.o,B.o,alioth.o" and again == "none" and spacing == "none"
+        and body == "A.o" and interface == "A.o,B.o" ? 0 : 1;
+}
+
+#endif
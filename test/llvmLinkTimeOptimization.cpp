@@ -0,0 +1,106 @@
+#ifndef __test_llvmLinkTimeOptimization_cpp__
+#define __test_llvmLinkTimeOptimization_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include <llvm/Object/ObjectFile.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#include "../src/compiler.cpp"
+
+/**
+ * 经由编译器以链接时优化产生静态库和可执行文件的目标文件，模拟链接器解析符号：
+ *  library: 产生lib.lto.o和alioth.o，类型标识由alioth.o定义并保持全局可见，lib.lto.o不重复定义它们
+ *  link: 两个目标文件中的全局符号没有重复定义，lib.lto.o引用的符号都能被解析
+ *  program: 产生可执行文件时alioth模块已经链接进app.lto.o，不再单独产生alioth.o
+ */
+using namespace alioth;
+
+/** 读取目标文件中的全局符号，分为定义的和引用的 */
+bool symbols( const string& path, set<string>& defined, set<string>& undefined ) {
+    auto file = llvm::object::ObjectFile::createObjectFile(path);
+    if( !file ) return llvm::consumeError(file.takeError()), false;
+    for( auto& sym : file->getBinary()->symbols() ) {
+        auto flags = sym.getFlags();
+        auto name = sym.getName();
+        if( !flags or !name ) return llvm::consumeError(flags.takeError()), llvm::consumeError(name.takeError()), false;
+        if( !(*flags & llvm::object::SymbolRef::SF_Global) or name->empty() ) continue;
+        if( *flags & llvm::object::SymbolRef::SF_Undefined ) undefined.insert(name->str());
+        else defined.insert(name->str());
+    }
+    return true;
+}
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    char work[] = "/tmp/alioth-lto-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    mkdir((string(work) + "/obj").data(), 0755);
+    ofstream(string(work) + "/src/a.alioth") <<
+        "module A\n"
+        "class C {\n"
+        "    method f( obj a int32 ) int32\n"
+        "}\n"
+        "method C::f( obj a int32 ) int32 {\n"
+        "    return a\n"
+        "}\n";
+
+    auto compile = [&]( const char* indicator, const char* name ) {
+        const char* args[] = {"alioth", "--root", root, "--work", work, "--lto", indicator, name, "A"};
+        auto saved = dup(1); // 诊断流关闭时会关闭标准输出
+        auto ret = BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args).execute();
+        dup2(saved, 1);
+        close(saved);
+        return ret;
+    };
+    auto obj = string(work) + "/obj/";
+
+    if( compile("s:", "lib") != 0 ) return cerr << "library not compiled" << endl, 1;
+    set<string> libdefs, librefs, rtdefs, rtrefs;
+    if( !symbols(obj + "lib.lto.o", libdefs, librefs) ) return cerr << "lib.lto.o missing" << endl, 1;
+    if( !symbols(obj + "alioth.o", rtdefs, rtrefs) ) return cerr << "alioth.o missing" << endl, 1;
+
+    bool exported = libdefs.count("method:A::C::f(obj:int32=>obj:int32)") and rtdefs.count("int32") and rtdefs.count("float64");
+    bool linked = true;
+    for( auto& name : libdefs ) if( rtdefs.count(name) ) cerr << "duplicate symbol: " << name << endl, linked = false;
+    for( auto& name : librefs ) if( !rtdefs.count(name) ) cerr << "unresolved symbol: " << name << endl, linked = false;
+
+    unlink((obj + "alioth.o").data());
+    unlink((obj + "alioth.o.fingerprint").data());
+    if( compile("x:", "app") != 0 ) return cerr << "program not compiled" << endl, 1;
+    bool program = access((obj + "app.lto.o").data(), F_OK) == 0 and access((obj + "alioth.o").data(), F_OK) != 0;
+
+    cout << "library: " << libdefs.size() << " symbols defined, " << librefs.size() << " referenced, "
+        << rtdefs.size() << " type ids in alioth.o" << endl;
+    cout << (exported ? "exported" : "not exported") << ", " << (linked ? "linked" : "link failed") << ", "
+        << (program ? "program self-contained" : "program incomplete") << endl;
+    return exported and linked and program ? 0 : 1;
+}
+
+#endif
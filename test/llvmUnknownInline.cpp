@@ -0,0 +1,161 @@
+#ifndef __test_llvmUnknownInline_cpp__
+#define __test_llvmUnknownInline_cpp__
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+#include <iostream>
+#include <chrono>
+
+/**
+ * 对var元素进行累加的三种翻译方式：
+ *  heap: unknown结构的载荷指向堆上的值，每次运算都要检查类型标识并间接读写
+ *  inline: 不超过指针宽度的基础类型直接存储在载荷中，仍然检查类型标识，但不再间接读写
+ *  unboxed: 元素的类型已被推断，直接使用SSA值运算
+ * 三个函数不经过优化，以反映翻译器产生的代码本身的开销，结果必须一致
+ */
+int main( int argc, char** argv ) {
+    using namespace llvm;
+    using namespace std;
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    auto context = make_unique<LLVMContext>();
+    auto module = make_unique<Module>("unknown", *context);
+    auto& ctx = *context;
+    auto i8p = Type::getInt8PtrTy(ctx);
+    auto i64 = Type::getInt64Ty(ctx);
+    auto unknown = StructType::create(ctx, {i8p, i8p, Type::getInt32Ty(ctx)}, "unknown");
+    auto ft = FunctionType::get(i64, {i64}, false);
+    auto tid = new GlobalVariable(*module, ArrayType::get(Type::getInt8Ty(ctx), 6), true,
+        GlobalValue::ExternalLinkage, ConstantDataArray::getString(ctx, "int64"), "int64");
+    auto malloc = module->getOrInsertFunction("malloc", FunctionType::get(i8p, {i64}, false));
+
+    /** 产生以n为上界的累加循环，body在类型检查通过后执行一次累加 */
+    auto generate = [&]( const char* name, auto init, auto body, auto result ) {
+        auto fp = Function::Create(ft, Function::ExternalLinkage, name, module.get());
+        auto entry = BasicBlock::Create(ctx, "entry", fp);
+        auto loop = BasicBlock::Create(ctx, "loop", fp);
+        auto step = BasicBlock::Create(ctx, "step", fp);
+        auto fail = BasicBlock::Create(ctx, "fail", fp);
+        auto done = BasicBlock::Create(ctx, "done", fp);
+        auto builder = IRBuilder<>(entry);
+        auto n = fp->arg_begin();
+        auto box = builder.CreateAlloca(unknown, nullptr, "x.addr");
+        auto i = builder.CreateAlloca(i64, nullptr, "i.addr");
+        builder.CreateStore(builder.getInt64(0), i);
+        init(builder, box);
+        builder.CreateBr(loop);
+
+        builder.SetInsertPoint(loop);
+        auto iv = builder.CreateLoad(i64, i);
+        builder.CreateCondBr(builder.CreateICmpSLT(iv, n), step, done);
+
+        builder.SetInsertPoint(step);
+        body(builder, box, iv, fail);
+        builder.CreateStore(builder.CreateAdd(iv, builder.getInt64(1)), i);
+        builder.CreateBr(loop);
+
+        builder.SetInsertPoint(fail);
+        builder.CreateRet(builder.getInt64(-1));
+
+        builder.SetInsertPoint(done);
+        builder.CreateRet(result(builder, box));
+    };
+
+    /** 类型标识不符时转入fail，否则在next块中继续 */
+    auto check = [&]( IRBuilder<>& builder, Value* box, BasicBlock* fail ) {
+        auto fp = builder.GetInsertBlock()->getParent();
+        auto next = BasicBlock::Create(ctx, "next", fp);
+        auto id = builder.CreateLoad(i8p, builder.CreateStructGEP(unknown, box, 1));
+        builder.CreateCondBr(builder.CreateICmpEQ(id, builder.CreateBitCast(tid, i8p)), next, fail);
+        builder.SetInsertPoint(next);
+    };
+    auto tag = [&]( IRBuilder<>& builder, Value* box ) {
+        builder.CreateStore(builder.CreateBitCast(tid, i8p), builder.CreateStructGEP(unknown, box, 1));
+        builder.CreateStore(builder.getInt32(0), builder.CreateStructGEP(unknown, box, 2));
+    };
+    auto payload = [&]( IRBuilder<>& builder, Value* box ) {
+        return builder.CreateStructGEP(unknown, box, 0);
+    };
+
+    generate("heap",
+        [&]( IRBuilder<>& builder, Value* box ) {
+            auto heap = builder.CreateCall(malloc, {builder.getInt64(8)});
+            builder.CreateStore(builder.getInt64(0), builder.CreateBitCast(heap, i64->getPointerTo()));
+            builder.CreateStore(heap, payload(builder, box));
+            tag(builder, box);
+        },
+        [&]( IRBuilder<>& builder, Value* box, Value* iv, BasicBlock* fail ) {
+            check(builder, box, fail);
+            auto heap = builder.CreateBitCast(builder.CreateLoad(i8p, payload(builder, box)), i64->getPointerTo());
+            builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64, heap), iv), heap);
+        },
+        [&]( IRBuilder<>& builder, Value* box ) {
+            auto heap = builder.CreateBitCast(builder.CreateLoad(i8p, payload(builder, box)), i64->getPointerTo());
+            return builder.CreateLoad(i64, heap);
+        });
+
+    generate("inline",
+        [&]( IRBuilder<>& builder, Value* box ) {
+            builder.CreateStore(builder.CreateIntToPtr(builder.getInt64(0), i8p), payload(builder, box));
+            tag(builder, box);
+        },
+        [&]( IRBuilder<>& builder, Value* box, Value* iv, BasicBlock* fail ) {
+            check(builder, box, fail);
+            auto x = builder.CreatePtrToInt(builder.CreateLoad(i8p, payload(builder, box)), i64);
+            builder.CreateStore(builder.CreateIntToPtr(builder.CreateAdd(x, iv), i8p), payload(builder, box));
+        },
+        [&]( IRBuilder<>& builder, Value* box ) {
+            return builder.CreatePtrToInt(builder.CreateLoad(i8p, payload(builder, box)), i64);
+        });
+
+    AllocaInst* x = nullptr;
+    generate("unboxed",
+        [&]( IRBuilder<>& builder, Value* box ) {
+            x = builder.CreateAlloca(i64, nullptr, "x");
+            builder.CreateStore(builder.getInt64(0), x);
+        },
+        [&]( IRBuilder<>& builder, Value* box, Value* iv, BasicBlock* fail ) {
+            builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64, x), iv), x);
+        },
+        [&]( IRBuilder<>& builder, Value* box ) {
+            return builder.CreateLoad(i64, x);
+        });
+
+    if( verifyModule(*module, &errs()) ) return 1;
+
+    string error;
+    auto engine = EngineBuilder(std::move(module))
+        .setErrorStr(&error)
+        .setEngineKind(EngineKind::JIT)
+        .setOptLevel(CodeGenOpt::None)
+        .create();
+    if( !engine ) return cerr << error << endl, 1;
+    engine->finalizeObject();
+
+    int64_t n = argc > 1 ? stoll(argv[1]) : 100000000;
+    int64_t expect = 0;
+    bool consistent = true;
+    for( auto name : {"heap", "inline", "unboxed"} ) {
+        auto fp = (int64_t(*)(int64_t))engine->getFunctionAddress(name);
+        auto start = chrono::steady_clock::now();
+        auto result = fp(n);
+        auto ms = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count() / 1000.0;
+        cout << name << ": " << result << " in " << ms << " ms" << endl;
+        if( name[0] == 'h' ) expect = result;
+        else consistent = consistent and result == expect;
+    }
+
+    delete engine;
+    return consistent ? 0 : 1;
+}
+
+#endif
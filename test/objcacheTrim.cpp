@@ -0,0 +1,56 @@
+#ifndef __test_objcacheTrim_cpp__
+#define __test_objcacheTrim_cpp__
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "../src/objcache.cpp"
+
+/**
+ * 在临时目录中使用容量为三个条目的共享缓存，检查淘汰的时机和顺序：
+ *  store: 连续存入五个条目，存入本身不淘汰任何条目
+ *  trim: 构建结束后修剪一次，按最近使用时间淘汰最旧的条目，期间取出过的条目被保留
+ * 最后以大量条目度量存入的用时，存入的用时不应随缓存中的条目数增长
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    char dir[] = "/tmp/alioth-objcache-XXXXXX";
+    if( !mkdtemp(dir) ) return cerr << "cannot create cache directory" << endl, 1;
+    auto entry = string(1000, 'o');
+    auto cache = ObjectCache(dir, entry.size() * 3);
+    if( !cache.open() ) return cerr << "cannot open cache" << endl, 1;
+
+    string content;
+    for( int i = 0; i < 5; i++ ) {
+        cache.store("k" + to_string(i), entry);
+        this_thread::sleep_for(chrono::milliseconds(10));
+        if( i == 2 ) cache.fetch("k0", content);
+    }
+    bool deferred = cache.getStatistics().evictions == 0;
+    for( int i = 0; i < 5; i++ ) deferred = deferred and cache.fetch("k" + to_string(i), content);
+
+    auto trimmed = ObjectCache(dir, entry.size() * 3);
+    trimmed.open();
+    this_thread::sleep_for(chrono::milliseconds(10));
+    trimmed.fetch("k0", content);
+    trimmed.fetch("k3", content);
+    trimmed.fetch("k4", content);
+    trimmed.trim();
+    bool evicted = trimmed.getStatistics().evictions == 2
+        and !trimmed.fetch("k1", content) and !trimmed.fetch("k2", content)
+        and trimmed.fetch("k0", content) and trimmed.fetch("k3", content) and trimmed.fetch("k4", content);
+
+    int count = argc > 1 ? stoi(argv[1]) : 2000;
+    auto bulk = ObjectCache(dir, entry.size() * count * 2);
+    auto start = chrono::steady_clock::now();
+    for( int i = 0; i < count; i++ ) bulk.store("b" + to_string(i), entry);
+    auto us = chrono::duration<double,micro>(chrono::steady_clock::now() - start).count() / count;
+    bulk.trim();
+
+    cout << "store: " << count << " entries, avg " << us << " us" << endl;
+    cout << (deferred ? "eviction deferred" : "evicted on store") << ", " << (evicted ? "least recently used evicted" : "wrong entries evicted") << endl;
+    return deferred and evicted ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __test_profilerTrace_cpp__
+#define __test_profilerTrace_cpp__
+
+#include "../src/jsonz.cpp"
+#include "../src/profiler.cpp"
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+/**
+ * 比较剖析器三种状态下每个作用域的开销，多个线程同时度量，模拟并行的语义检查：
+ *  off: 剖析器未开启，作用域不做任何事
+ *  report: 累积用时和计数，供--time-report使用
+ *  trace: 同时在每个线程的轨道上记录跟踪事件，供--trace使用
+ * 每个线程记录的事件超过轨道容量，轨道必须只保留最新的事件，输出的跟踪必须是合法的Json
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    using namespace std::chrono;
+    int threads = argc > 1 ? stoi(argv[1]) : 4;
+    int scopes = argc > 2 ? stoi(argv[2]) : 100000;
+    int modules = argc > 3 ? stoi(argv[3]) : 200;
+
+    vector<string> names;
+    for( int i = 0; i < modules; i++ ) names.push_back("M" + to_string(i));
+
+    auto measure = [&]( const char* name, Profiler& profiler ) {
+        auto start = steady_clock::now();
+        vector<thread> workers;
+        for( int t = 0; t < threads; t++ ) workers.emplace_back([&, t] {
+            for( int i = t; i < scopes; i += threads ) {
+                auto timing = profiler.measure("implementation", names[i % modules]);
+                auto nested = Profiler::scope("instantiation");
+                Profiler::Count(Profiler::LOOKUPS);
+            }
+        });
+        for( auto& w : workers ) w.join();
+        auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count() / (double)scopes / 2;
+        cout << name << ": " << ns << " ns per scope" << endl;
+    };
+
+    Profiler off, report, trace;
+    report.enable();
+    trace.enableTracing();
+    measure("off", off);
+    measure("report", report);
+    measure("trace", trace);
+
+    auto os = ostringstream();
+    trace.writeTrace(os);
+    auto is = istringstream(os.str());
+    auto doc = json::FromJsonStream(is);
+    auto events = doc["traceEvents"].count();
+    auto dropped = (long)doc["otherData"]["dropped"];
+    auto expected = min((size_t)scopes * 2 / threads, Profiler::TrackCapacity) * threads + threads;
+
+    auto lookups = report.toJson()["phases"][1]["counters"]["lookups"];
+    cout << events << " events written, " << dropped << " dropped, " << os.str().size() << " bytes" << endl;
+    return (size_t)events == expected and (long)lookups == scopes and dropped + events - threads == scopes * 2 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef __test_semanticInterfaceRevision_cpp__
+#define __test_semanticInterfaceRevision_cpp__
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <ext/stdio_filebuf.h>
+#include "../src/jsonz.cpp"
+#include "../src/vt.cpp"
+#include "../src/token.cpp"
+#include "../src/diagnostic.cpp"
+#include "../src/profiler.cpp"
+#include "../src/lexical.cpp"
+#include "../src/syntax.cpp"
+#include "../src/type.cpp"
+#include "../src/asock.cpp"
+#include "../src/docbuf.cpp"
+#include "../src/space.cpp"
+#include "../src/context.cpp"
+#include "../src/depgraph.cpp"
+#include "../src/scheduler.cpp"
+#include "../src/semantic.cpp"
+#include "../src/objcache.cpp"
+#include "../src/air_context.cpp"
+#include "../src/compiler.cpp"
+
+/**
+ * 以全交互模式驱动编译器，在三次诊断请求之间编辑模块A，检查定义检查的复用：
+ *  first: 首次请求检查所有模块，A、B、C各检查一次
+ *  body: 只改变A的格式而不改变接口，A被重新检查，依赖A的B复用此前的结论
+ *  rename: 重命名B所引用的类，A的接口改变，B被登记为陈旧模块，重新构造语法树后再次检查并报告错误
+ *  append: 在A的末尾重新定义B所引用的类，没有改变的类定义从语法缓存中克隆，B再次检查后不再报告错误
+ * 不依赖A的C始终只检查一次，每次请求都得到响应即说明重新构造语法树的循环终止了
+ * 检查次数取自编译器结束时以Json报告的definition阶段中各模块的度量次数
+ */
+using namespace alioth;
+
+int main( int argc, char** argv ) {
+    char root[PATH_MAX];
+    if( !realpath(argc > 1 ? argv[1] : ".", root) ) return cerr << "bad root" << endl, 1;
+    char work[] = "/tmp/alioth-revision-XXXXXX";
+    if( !mkdtemp(work) ) return cerr << "cannot create workspace" << endl, 1;
+    mkdir((string(work) + "/src").data(), 0755);
+    ofstream(string(work) + "/src/a.alioth") << "module A\nclass Base {\n    obj v int32\n}\n";
+    ofstream(string(work) + "/src/b.alioth") << "module B : A\nclass User {\n    obj b A::Base\n}\n";
+    ofstream(string(work) + "/src/c.alioth") << "module C\nclass Other {\n    obj x int32\n}\n";
+    auto report = string(work) + "/report.json";
+    auto ruri = "file://" + report;
+    auto auri = "file://" + string(work) + "/src/a.alioth";
+
+    int c2i[2], i2c[2];
+    if( pipe(c2i) or pipe(i2c) ) return cerr << "cannot create pipes" << endl, 1;
+    auto channel = to_string(i2c[0]) + "/" + to_string(c2i[1]);
+    auto compiler = thread([&]{
+        const char* args[] = {"alioth", "--root", root, "--work", work,
+            "--time-report-method", "json", "--time-report-to", ruri.data(), "v:", "2", "---", channel.data()};
+        BasicCompiler((int)(sizeof(args) / sizeof(*args)), (char**)args).execute();
+    });
+
+    auto ibuf = __gnu_cxx::stdio_filebuf<char>(c2i[0], ios::in);
+    auto is = istream(&ibuf);
+    auto send = [&]( json pack ) {
+        auto text = pack.toJsonString() + "\n";
+        return write(i2c[1], text.data(), text.size()) == (ssize_t)text.size();
+    };
+
+    /** 代替IDE回答编译器对工作空间的请求，直到收到序号为seq的最终响应 */
+    auto await = [&]( long seq ) -> json {
+        for( string line; getline(is, line); ) {
+            auto ls = istringstream(line);
+            auto pack = json::FromJsonStream(ls);
+            if( (string)pack["action"] == "respond" ) {
+                if( (long)pack["seq"] == seq and !pack.count("partial", json::boolean) ) return pack;
+                continue;
+            }
+            auto path = "/" + Uri::FromString((string)pack["uri"]).path;
+            json res = json::object;
+            res["seq"] = pack["seq"];
+            res["timestamp"] = 0L;
+            res["action"] = string("respond");
+            res["title"] = pack["title"];
+            res["status"] = 0L;
+            if( (string)pack["title"] == "content" ) {
+                auto fs = ifstream(path);
+                auto os = ostringstream();
+                if( fs ) os << fs.rdbuf(), res["data"] = os.str();
+                else res["status"] = 1L;
+            } else {
+                json data = json::object;
+                if( auto dir = opendir(path.data()); dir ) {
+                    while( auto ent = readdir(dir) ) {
+                        struct stat st;
+                        string name = ent->d_name;
+                        if( name == "." or name == ".." or stat((path + "/" + name).data(), &st) ) continue;
+                        json item = json::object;
+                        item["size"] = (long)st.st_size;
+                        item["mtime"] = (long)st.st_mtime;
+                        item["dir"] = (bool)S_ISDIR(st.st_mode);
+                        data[name] = item;
+                    }
+                    closedir(dir);
+                }
+                res["data"] = data;
+            }
+            send(res);
+        }
+        return json();
+    };
+    auto request = [&]( long seq, const string& title ) {
+        json pack = json::object;
+        pack["seq"] = seq;
+        pack["timestamp"] = 0L;
+        pack["action"] = string("request");
+        pack["title"] = title;
+        return pack;
+    };
+    auto diagnose = [&]( long seq ) {
+        auto pack = request(seq, "diagnostics");
+        pack["targets"] = json(json::array);
+        if( !send(pack) ) return -1;
+        auto res = await(seq);
+        return res.count("diagnostics", json::array) ? res["diagnostics"].count() : -1;
+    };
+    auto update = [&]( long seq, const string& text ) {
+        auto pack = request(seq, "update");
+        json edit = json::object;
+        edit["text"] = text;
+        json edits = json::array;
+        edits[0] = edit;
+        pack["uri"] = auri;
+        pack["edits"] = edits;
+        return send(pack) and (long)await(seq)["status"] == 0;
+    };
+
+    auto first = diagnose(1);
+    auto body = update(2, "module A\n\nclass Base {\n    obj v   int32\n}\n") ? diagnose(3) : -1;
+    auto rename = update(4, "module A\nclass Root {\n    obj v int32\n}\n") ? diagnose(5) : -1;
+    auto append = update(6, "module A\nclass Root {\n    obj v int32\n}\nclass Base {\n    obj r Root\n}\n") ? diagnose(7) : -1;
+    send(request(8, "exit"));
+    compiler.join();
+
+    map<string,long> calls;
+    auto rs = ifstream(report);
+    auto times = json::FromJsonStream(rs);
+    if( times.count("phases", json::array) ) for( const auto& phase : times["phases"] )
+        if( (string)phase["phase"] == "definition" ) for( const auto& mod : phase["modules"] )
+            calls[(string)mod["module"]] = (long)mod["calls"];
+
+    cout << "diagnostics: first " << first << ", body " << body << ", rename " << rename << ", append " << append << endl;
+    cout << "definition checks: A " << calls["A"] << ", B " << calls["B"] << ", C " << calls["C"] << endl;
+    return first == 0 and body == 0 and rename > 0 and append == 0 and calls["A"] == 4 and calls["B"] == 3 and calls["C"] == 1 ? 0 : 1;
+}
+
+#endif